@@ -0,0 +1,414 @@
+#include "DSHapDecoder.h"
+
+#include <ddraw.h>
+#include <dvdmedia.h>
+
+// texture format the HAP subtype decodes to
+static bool getTextureFormat(const GUID & subtype, DXTTextureFormat & format) {
+	if (subtype == MEDIASUBTYPE_Hap1) format = TextureFormat_RGB_DXT1;
+	else if (subtype == MEDIASUBTYPE_Hap5) format = TextureFormat_RGBA_DXT5;
+	else if (subtype == MEDIASUBTYPE_HapY) format = TextureFormat_YCoCg_DXT5;
+	else return false;
+	return true;
+}
+
+// splitters hand out either VIDEOINFOHEADER or VIDEOINFOHEADER2
+static const BITMAPINFOHEADER * getBitmapHeader(const CMediaType * pmt, REFERENCE_TIME * pAvgTimePerFrame) {
+	if (pmt->Format() == NULL) return NULL;
+
+	if (*pmt->FormatType() == FORMAT_VideoInfo && pmt->FormatLength() >= sizeof(VIDEOINFOHEADER)) {
+		const VIDEOINFOHEADER * pvi = (const VIDEOINFOHEADER*)pmt->Format();
+		if (pAvgTimePerFrame) *pAvgTimePerFrame = pvi->AvgTimePerFrame;
+		return &pvi->bmiHeader;
+	}
+	if (*pmt->FormatType() == FORMAT_VideoInfo2 && pmt->FormatLength() >= sizeof(VIDEOINFOHEADER2)) {
+		const VIDEOINFOHEADER2 * pvi = (const VIDEOINFOHEADER2*)pmt->Format();
+		if (pAvgTimePerFrame) *pAvgTimePerFrame = pvi->AvgTimePerFrame;
+		return &pvi->bmiHeader;
+	}
+	return NULL;
+}
+
+/////////////////////// instantiation //////////////////////////
+
+DSHapDecoder::DSHapDecoder(IUnknown * pOuter, HRESULT * phr)
+	: CVideoTransformFilter(HAPDECODER_FILTERNAME, (IUnknown*)pOuter, CLSID_DSHapDecoder),
+	m_Pipeline(m_Engine) {
+	m_TextureFormat = TextureFormat_RGB_DXT1;
+	m_DecodeAhead = 1;
+	m_DecodeAheadBudget = 0;
+	m_DownstreamBuffers = 1;
+	m_OutputBuffers = 1;
+}
+
+DSHapDecoder::~DSHapDecoder() {
+	DiscardPipeline();
+}
+
+CUnknown *WINAPI DSHapDecoder::CreateInstance(LPUNKNOWN punk, HRESULT *phr) {
+	HRESULT hr;
+	if (!phr) phr = &hr;
+	DSHapDecoder *pNewObject = new DSHapDecoder(punk, phr);
+	if (pNewObject == NULL) *phr = E_OUTOFMEMORY;
+	return pNewObject;
+}
+
+/////////////////////// input pin //////////////////////////
+
+DSHapDecoderInputPin::DSHapDecoderInputPin(DSHapDecoder * pDecoder, HRESULT * phr)
+	: CTransformInputPin(NAME("Hap Decoder input pin"), pDecoder, phr, L"In") {
+	m_pDecoder = pDecoder;
+}
+
+STDMETHODIMP DSHapDecoderInputPin::GetAllocatorRequirements(ALLOCATOR_PROPERTIES * pProps) {
+	CheckPointer(pProps, E_POINTER);
+	if (m_pDecoder->m_DecodeAhead <= 1) return E_NOTIMPL;
+
+	// every frame in flight holds its input sample, upstream needs one more to read into
+	pProps->cBuffers = m_pDecoder->m_DecodeAhead + 1;
+	pProps->cbBuffer = 0; // upstream knows the frame size
+	pProps->cbAlign = 1;
+	pProps->cbPrefix = 0;
+	return S_OK;
+}
+
+HRESULT DSHapDecoderInputPin::GetAllocatorProperties(ALLOCATOR_PROPERTIES * pProps) {
+	if (!m_pAllocator) return E_UNEXPECTED;
+	return m_pAllocator->GetProperties(pProps);
+}
+
+CBasePin * DSHapDecoder::GetPin(int n) {
+	HRESULT hr = S_OK;
+
+	// same as CTransformFilter::GetPin, but with our own input pin
+	if (m_pInput == NULL) {
+		m_pInput = new DSHapDecoderInputPin(this, &hr);
+		if (m_pInput == NULL) return NULL;
+
+		m_pOutput = new CTransformOutputPin(NAME("Hap Decoder output pin"), this, &hr, L"Out");
+		if (m_pOutput == NULL) {
+			delete m_pInput;
+			m_pInput = NULL;
+		}
+	}
+
+	if (n == 0) return m_pInput;
+	if (n == 1) return m_pOutput;
+	return NULL;
+}
+
+/////////////////////// CVideoTransformFilter //////////////////////////
+
+HRESULT DSHapDecoder::CheckInputType(const CMediaType *pmt)
+{
+	if (*pmt->Type() != MEDIATYPE_Video) {
+		NOTE("Major type not MEDIATYPE_Video");
+		return E_INVALIDARG;
+	}
+
+	DXTTextureFormat format;
+	if (!getTextureFormat(*pmt->Subtype(), format)) {
+		NOTE("Subtype not Hap1, Hap5 or HapY");
+		return E_INVALIDARG;
+	}
+
+	const BITMAPINFOHEADER * pbmi = getBitmapHeader(pmt, NULL);
+	if (pbmi == NULL || pbmi->biWidth <= 0 || pbmi->biHeight == 0) {
+		NOTE("No usable VIDEOINFOHEADER or VIDEOINFOHEADER2");
+		return E_INVALIDARG;
+	}
+
+	return S_OK;
+}
+
+HRESULT DSHapDecoder::CheckTransform(const CMediaType * mtIn, const CMediaType * mtOut)
+{
+	DXTTextureFormat format;
+	if (!getTextureFormat(*mtIn->Subtype(), format)) return E_INVALIDARG;
+
+	if (*mtOut->Type() != MEDIATYPE_Video || *mtOut->FormatType() != FORMAT_VideoInfo) return E_INVALIDARG;
+
+	const GUID * pSubType = mtOut->Subtype();
+	if (format == TextureFormat_RGB_DXT1 && *pSubType == MEDIASUBTYPE_DXT1) return S_OK;
+	if (format == TextureFormat_RGBA_DXT5 && *pSubType == MEDIASUBTYPE_DXT5) return S_OK;
+	if (format == TextureFormat_YCoCg_DXT5 && *pSubType == MEDIASUBTYPE_DXTY) return S_OK;
+	return E_INVALIDARG;
+}
+
+HRESULT DSHapDecoder::SetMediaType(PIN_DIRECTION direction, const CMediaType * pmt)
+{
+	if (direction == PINDIR_INPUT) {
+		if (!getTextureFormat(*pmt->Subtype(), m_TextureFormat)) return E_INVALIDARG;
+	}
+	return CVideoTransformFilter::SetMediaType(direction, pmt);
+}
+
+HRESULT DSHapDecoder::GetMediaType(int iPosition, CMediaType *pMediaType)
+{
+	// Is the input pin connected
+	if (m_pInput->IsConnected() == FALSE) {
+		return E_UNEXPECTED;
+	}
+
+	// This should never happen
+	if (iPosition < 0) return E_INVALIDARG;
+
+	// Do we have more items to offer
+	if (iPosition > 0) return VFW_S_NO_MORE_ITEMS;
+
+	REFERENCE_TIME avgTimePerFrame = 0;
+	const BITMAPINFOHEADER * pbmiIn = getBitmapHeader(&m_pInput->CurrentMediaType(), &avgTimePerFrame);
+	if (pbmiIn == NULL) return E_UNEXPECTED;
+
+	VIDEOINFOHEADER * pvi = (VIDEOINFOHEADER*)pMediaType->AllocFormatBuffer(sizeof(VIDEOINFOHEADER));
+	if (pvi == NULL) return E_OUTOFMEMORY;
+	ZeroMemory(pvi, sizeof(VIDEOINFOHEADER));
+
+	const GUID * pSubType;
+	switch (m_TextureFormat) {
+	case TextureFormat_RGB_DXT1:
+		pSubType = &MEDIASUBTYPE_DXT1;
+		pvi->bmiHeader.biCompression = FOURCC_DXT1;
+		pvi->bmiHeader.biBitCount = 4;
+		break;
+	case TextureFormat_RGBA_DXT5:
+		pSubType = &MEDIASUBTYPE_DXT5;
+		pvi->bmiHeader.biCompression = FOURCC_DXT5;
+		pvi->bmiHeader.biBitCount = 8;
+		break;
+	default:
+		pSubType = &MEDIASUBTYPE_DXTY;
+		pvi->bmiHeader.biCompression = FOURCC_DXTY;
+		pvi->bmiHeader.biBitCount = 8;
+		break;
+	}
+
+	pvi->AvgTimePerFrame = avgTimePerFrame;
+	pvi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	pvi->bmiHeader.biWidth = pbmiIn->biWidth;
+	pvi->bmiHeader.biHeight = pbmiIn->biHeight;
+	pvi->bmiHeader.biPlanes = 1;
+	pvi->bmiHeader.biSizeImage = DXTCompressedSize(m_TextureFormat, pbmiIn->biWidth, abs(pbmiIn->biHeight));
+
+	pMediaType->SetType(&MEDIATYPE_Video);
+	pMediaType->SetSubtype(pSubType);
+	pMediaType->SetFormatType(&FORMAT_VideoInfo);
+	pMediaType->SetTemporalCompression(FALSE);
+	pMediaType->SetSampleSize(pvi->bmiHeader.biSizeImage);
+
+	return S_OK;
+}
+
+HRESULT DSHapDecoder::DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pProperties)
+{
+	if (m_pInput->IsConnected() == FALSE) return E_UNEXPECTED;
+
+	ASSERT(pAlloc);
+	ASSERT(pProperties);
+
+	VIDEOINFOHEADER * pvi = (VIDEOINFOHEADER*)m_pOutput->CurrentMediaType().Format();
+	if (pvi == NULL) return E_UNEXPECTED;
+
+	// keep the buffer count downstream asked for, it may hold on to samples,
+	// plus one for every frame decoding ahead
+	m_DownstreamBuffers = pProperties->cBuffers < 1 ? 1 : pProperties->cBuffers;
+	pProperties->cBuffers = m_DownstreamBuffers + (m_DecodeAhead > 1 ? m_DecodeAhead : 0);
+	if (pProperties->cbAlign < 1) pProperties->cbAlign = 1;
+	pProperties->cbBuffer = pvi->bmiHeader.biSizeImage;
+
+	ALLOCATOR_PROPERTIES Actual;
+	HRESULT hr = pAlloc->SetProperties(pProperties, &Actual);
+	if (FAILED(hr)) return hr;
+
+	// fewer buffers than requested is fine, downstream checks what it got and StartStreaming limits the depth
+	ASSERT(Actual.cBuffers >= 1);
+	if (pProperties->cbBuffer > Actual.cbBuffer) {
+		return E_FAIL;
+	}
+	m_OutputBuffers = Actual.cBuffers;
+
+	return S_OK;
+}
+
+HRESULT DSHapDecoder::Transform(IMediaSample * pIn, IMediaSample * pOut)
+{
+	BYTE * pSrc = NULL;
+	BYTE * pDst = NULL;
+	HRESULT hr = pIn->GetPointer(&pSrc);
+	if (FAILED(hr)) return hr;
+	hr = pOut->GetPointer(&pDst);
+	if (FAILED(hr)) return hr;
+
+	HapResult result = m_Engine.decode(pSrc, pIn->GetActualDataLength(), pDst, pOut->GetSize(), m_FrameInfo);
+	if (result == HapResult_OK && m_FrameInfo.textureFormat != m_TextureFormat) result = HapResult_UnsupportedFormat;
+	if (result != HapResult_OK) {
+		// S_FALSE makes CVideoTransformFilter skip the frame instead of stopping the graph
+		DbgLog((LOG_ERROR, 1, TEXT("Hap Decoder: %hs"), HapDecoder::getResultString(result)));
+		return S_FALSE;
+	}
+
+	pOut->SetActualDataLength((long)m_FrameInfo.outputSize);
+	pOut->SetSyncPoint(TRUE);
+	return S_OK;
+}
+
+void DSHapDecoder::SetDecodePriority(DXTTaskPriority priority) {
+	m_Engine.setPriority(priority);
+}
+
+DXTTaskPriority DSHapDecoder::GetDecodePriority() {
+	return m_Engine.getPriority();
+}
+
+HapDecodeStats DSHapDecoder::GetDecodeStats() {
+	return m_Engine.getStats();
+}
+
+DXTTaskClientStats DSHapDecoder::GetSchedulingStats() {
+	return m_Engine.getSchedulingStats();
+}
+
+/////////////////////// decode ahead //////////////////////////
+
+HRESULT DSHapDecoder::StartStreaming()
+{
+	int depth = m_DecodeAhead;
+
+	if (depth > 1) {
+		// frames in flight hold an input and an output sample each, never wait on our own buffers
+		ALLOCATOR_PROPERTIES inProps;
+		ZeroMemory(&inProps, sizeof(inProps));
+		((DSHapDecoderInputPin*)m_pInput)->GetAllocatorProperties(&inProps);
+		depth = min(depth, (int)inProps.cBuffers - 1);
+		depth = min(depth, (int)(m_OutputBuffers - m_DownstreamBuffers));
+
+		VIDEOINFOHEADER * pvi = (VIDEOINFOHEADER*)m_pOutput->CurrentMediaType().Format();
+		size_t frameBytes = (size_t)inProps.cbBuffer + (pvi ? pvi->bmiHeader.biSizeImage : 0);
+		if (m_DecodeAheadBudget > 0 && frameBytes > 0) {
+			depth = min(depth, (int)(m_DecodeAheadBudget / frameBytes));
+		}
+
+		if (depth < m_DecodeAhead) {
+			DbgLog((LOG_TRACE, 1, TEXT("Hap Decoder: decoding %d instead of %d frames ahead"), max(depth, 1), m_DecodeAhead));
+		}
+	}
+
+	m_Pipeline.setDepth(depth);
+	m_Pipeline.resetStats();
+	return CVideoTransformFilter::StartStreaming();
+}
+
+HRESULT DSHapDecoder::StopStreaming()
+{
+	// called with m_csReceive held
+	DiscardPipeline();
+	return CVideoTransformFilter::StopStreaming();
+}
+
+HRESULT DSHapDecoder::Receive(IMediaSample * pSample)
+{
+	if (m_Pipeline.getDepth() <= 1) return CVideoTransformFilter::Receive(pSample);
+
+	// same as CTransformFilter::Receive for anything that is not media data
+	AM_SAMPLE2_PROPERTIES * const pProps = m_pInput->SampleProps();
+	if (pProps->dwStreamId != AM_STREAM_MEDIA) {
+		return m_pOutput->Deliver(pSample);
+	}
+
+	// make room first, every queued frame holds one of our output buffers
+	HRESULT hr = S_OK;
+	while (hr == S_OK && m_Pipeline.isFull()) {
+		hr = DeliverOldest(true);
+	}
+	if (hr != S_OK) return hr;
+
+	IMediaSample * pOut = NULL;
+	hr = InitializeOutputSample(pSample, &pOut);
+	if (FAILED(hr)) return hr;
+
+	BYTE * pSrc = NULL;
+	BYTE * pDst = NULL;
+	pSample->GetPointer(&pSrc);
+	pOut->GetPointer(&pDst);
+
+	// both samples stay ours until the frame has been delivered
+	pSample->AddRef();
+	m_Pipeline.push(pSrc, pSample->GetActualDataLength(), pDst, pOut->GetSize(), pSample, pOut);
+
+	// pass on whatever finished meanwhile, in stream order
+	while (hr == S_OK && m_Pipeline.peekCompleted()) {
+		hr = DeliverOldest(false);
+	}
+	return hr;
+}
+
+HRESULT DSHapDecoder::DeliverOldest(bool bWait)
+{
+	HapPipelineFrame * frame = bWait ? m_Pipeline.waitOldest() : m_Pipeline.peekCompleted();
+	if (!frame) return S_OK;
+
+	IMediaSample * pIn = (IMediaSample*)frame->srcOwner;
+	IMediaSample * pOut = (IMediaSample*)frame->dstOwner;
+	HapResult result = frame->request.result;
+	if (result == HapResult_OK && frame->request.info.textureFormat != m_TextureFormat) result = HapResult_UnsupportedFormat;
+
+	HRESULT hr = S_OK;
+	if (result == HapResult_OK) {
+		pOut->SetActualDataLength((long)frame->request.info.outputSize);
+		pOut->SetSyncPoint(TRUE);
+		hr = m_pOutput->Deliver(pOut);
+		m_bSampleSkipped = FALSE;
+	}
+	else {
+		// skipped like a S_FALSE from Transform
+		DbgLog((LOG_ERROR, 1, TEXT("Hap Decoder: %hs"), HapDecoder::getResultString(result)));
+		m_bSampleSkipped = TRUE;
+	}
+
+	m_Pipeline.pop();
+	pOut->Release();
+	pIn->Release();
+	return hr;
+}
+
+void DSHapDecoder::DiscardPipeline()
+{
+	while (!m_Pipeline.isEmpty()) {
+		HapPipelineFrame * frame = m_Pipeline.waitOldest();
+		IMediaSample * pIn = (IMediaSample*)frame->srcOwner;
+		IMediaSample * pOut = (IMediaSample*)frame->dstOwner;
+		m_Pipeline.pop();
+		pOut->Release();
+		pIn->Release();
+	}
+}
+
+HRESULT DSHapDecoder::EndOfStream()
+{
+	// called with m_csReceive held, the queued frames go out before the end of stream
+	HRESULT hr = S_OK;
+	while (hr == S_OK && !m_Pipeline.isEmpty()) {
+		hr = DeliverOldest(true);
+	}
+	DiscardPipeline();
+	return CVideoTransformFilter::EndOfStream();
+}
+
+HRESULT DSHapDecoder::EndFlush()
+{
+	{
+		// wait for a Receive still in progress, then drop what it queued
+		CAutoLock lock(&m_csReceive);
+		DiscardPipeline();
+	}
+	return CVideoTransformFilter::EndFlush();
+}
+
+void DSHapDecoder::SetDecodeAhead(int frames, size_t memoryBudget) {
+	m_DecodeAhead = frames > 1 ? frames : 1;
+	m_DecodeAheadBudget = memoryBudget;
+}
+
+HapPipelineStats DSHapDecoder::GetPipelineStats() {
+	return m_Pipeline.getStats();
+}
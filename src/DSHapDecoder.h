@@ -0,0 +1,85 @@
+#pragma once
+
+#include "DSShared.h"
+#include <streams.h>
+#include "uids.h"
+#include "DXTShared.h"
+#include "HapDecoder.h"
+#include "HapDecodeEngine.h"
+#include "HapDecodePipeline.h"
+
+#define HAPDECODER_FILTERNAME L"Hap Decoder"
+
+class DSHapDecoder;
+
+// input pin that asks upstream for a buffer per frame decoding ahead
+class DSHapDecoderInputPin : public CTransformInputPin {
+
+public:
+
+	DSHapDecoderInputPin(DSHapDecoder * pDecoder, HRESULT * phr);
+
+	STDMETHODIMP GetAllocatorRequirements(ALLOCATOR_PROPERTIES * pProps);
+	HRESULT GetAllocatorProperties(ALLOCATOR_PROPERTIES * pProps);
+
+private:
+
+	DSHapDecoder * m_pDecoder;
+};
+
+// CVideoTransformFilter around HapDecoder, turns Hap1/Hap5/HapY samples into DXT1/DXT5/DXTY samples
+class DSHapDecoder : public CVideoTransformFilter {
+
+private:
+
+	DXTTextureFormat m_TextureFormat;
+	HapFrameInfo m_FrameInfo;
+	HapDecodeEngine m_Engine;
+	HapDecodePipeline m_Pipeline;
+	int m_DecodeAhead;				// requested frames in flight
+	size_t m_DecodeAheadBudget;		// bytes those frames may hold, 0 = no limit
+	long m_DownstreamBuffers;		// output buffers downstream asked for
+	long m_OutputBuffers;			// output buffers the allocator actually has
+
+	friend class DSHapDecoderInputPin;
+
+	HRESULT DeliverOldest(bool bWait);
+	void DiscardPipeline();
+
+public:
+
+	DSHapDecoder(IUnknown * pOuter, HRESULT * phr);
+	~DSHapDecoder();
+
+	static CUnknown *WINAPI CreateInstance(LPUNKNOWN punk, HRESULT *phr);
+
+	// IUnknown
+	DECLARE_IUNKNOWN;
+
+	// virtual CVideoTransformFilter methods
+	HRESULT Transform(IMediaSample * pIn, IMediaSample * pOut);
+	HRESULT CheckInputType(const CMediaType * pmt);
+	HRESULT CheckTransform(const CMediaType * mtIn, const CMediaType * mtOut);
+	HRESULT SetMediaType(PIN_DIRECTION direction, const CMediaType * pmt);
+	HRESULT DecideBufferSize(IMemAllocator * pAlloc, ALLOCATOR_PROPERTIES * pProperties);
+	HRESULT GetMediaType(int iPosition, CMediaType * pMediaType);
+	CBasePin * GetPin(int n);
+
+	// decode ahead
+	HRESULT Receive(IMediaSample * pSample);
+	HRESULT EndOfStream();
+	HRESULT EndFlush();
+	HRESULT StartStreaming();
+	HRESULT StopStreaming();
+
+	// priority of our frames on the shared decode workers
+	void SetDecodePriority(DXTTaskPriority priority);
+	DXTTaskPriority GetDecodePriority();
+	HapDecodeStats GetDecodeStats();
+	DXTTaskClientStats GetSchedulingStats();
+
+	// frames decoded ahead on the workers, bounded by the allocators and the memory budget,
+	// has to be called before the pins get connected
+	void SetDecodeAhead(int frames, size_t memoryBudget);
+	HapPipelineStats GetPipelineStats();
+};
@@ -0,0 +1,406 @@
+#include "DSHapSource.h"
+#include <math.h>
+#include <string.h>
+#include "DXTThreadPool.h"
+#include "HapIndexCache.h"
+
+static const GUID * getSubtype(uint32_t codec) {
+	switch (codec) {
+	case HAP_CODEC_HAP1: return &MEDIASUBTYPE_Hap1;
+	case HAP_CODEC_HAP5: return &MEDIASUBTYPE_Hap5;
+	case HAP_CODEC_HAPY: return &MEDIASUBTYPE_HapY;
+	}
+	return NULL;
+}
+
+/////////////////////// DSHapSource //////////////////////////
+
+DSHapSource::DSHapSource(IUnknown * pOuter, HRESULT * phr)
+	: CSource(HAPSOURCE_FILTERNAME, pOuter, CLSID_DSHapSource, phr) {
+	m_pStream = NULL;
+}
+
+DSHapSource::~DSHapSource() {
+	// CSource deletes the pin
+}
+
+CUnknown *WINAPI DSHapSource::CreateInstance(LPUNKNOWN punk, HRESULT *phr) {
+	HRESULT hr;
+	if (!phr) phr = &hr;
+	DSHapSource *pNewObject = new DSHapSource(punk, phr);
+	if (pNewObject == NULL) *phr = E_OUTOFMEMORY;
+	return pNewObject;
+}
+
+HRESULT DSHapSource::Open(const std::string & path) {
+	CAutoLock lock(&m_cStateLock);
+	if (GetPinCount() > 0) return E_UNEXPECTED;
+
+	if (!m_File.open(path)) return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+	// from the sidecar when there's a current one, else from the container
+	HapDemuxResult result = HapIndexCache::loadOrBuild(m_File, m_Index, &DXTThreadPool::shared());
+	if (result != HapDemuxResult_OK) {
+		m_File.close();
+		return result == HapDemuxResult_ReadError ? E_FAIL : VFW_E_UNSUPPORTED_STREAM;
+	}
+
+	// the pin adds itself to the filter
+	HRESULT hr = S_OK;
+	DSHapSourceStream * pStream = new DSHapSourceStream(this, &hr);
+	if (pStream == NULL) return E_OUTOFMEMORY;
+	if (FAILED(hr)) {
+		delete pStream;
+		return hr;
+	}
+	m_pStream = pStream;
+
+	m_ReadAhead.setSource(&m_File, &m_Index, &DXTThreadPool::shared());
+	m_ReadAhead.setDepth(HAPSOURCE_READAHEAD_FRAMES);
+	return S_OK;
+}
+
+void DSHapSource::SetLoop(HapLoopMode mode, int inFrame, int outFrame) {
+	if (m_pStream) m_pStream->SetLoop(mode, inFrame, outFrame);
+}
+
+HRESULT DSHapSource::SetSpeed(double speed) {
+	if (speed == 0.0) return E_INVALIDARG;
+	if (m_pStream) m_pStream->SetSpeed(speed);
+	return S_OK;
+}
+
+void DSHapSource::SetRefreshInterval(REFERENCE_TIME interval) {
+	if (m_pStream) m_pStream->SetRefreshInterval(interval);
+}
+
+HapSourceStats DSHapSource::GetStats() {
+	if (m_pStream) return m_pStream->GetStats();
+	HapSourceStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+/////////////////////// DSHapSourceStream //////////////////////////
+
+DSHapSourceStream::DSHapSourceStream(DSHapSource * pSource, HRESULT * phr)
+	: CSourceStream(NAME("Hap Source output pin"), phr, pSource, L"Out"),
+	CSourceSeeking(NAME("Hap Source seeking"), (IPin*)this, phr, &m_SeekLock) {
+	m_pSource = pSource;
+	m_TimeFormat = TIME_FORMAT_MEDIA_TIME;
+	m_Playhead.setFrameCount(pSource->m_Index.getFrameCount());
+	m_iPendingFrame = -1;
+	m_bDiscontinuity = true;
+	m_dSpeed = 1.0;
+	m_lLoops = 0;
+	m_framesDelivered = 0;
+	m_framesSkipped = 0;
+
+	m_rtDuration = pSource->m_Index.duration;
+	m_rtStop = m_rtDuration;
+}
+
+STDMETHODIMP DSHapSourceStream::NonDelegatingQueryInterface(REFIID riid, void ** ppv) {
+	if (riid == IID_IMediaSeeking) {
+		return CSourceSeeking::NonDelegatingQueryInterface(riid, ppv);
+	}
+	return CSourceStream::NonDelegatingQueryInterface(riid, ppv);
+}
+
+HRESULT DSHapSourceStream::GetMediaType(CMediaType * pMediaType) {
+	CheckPointer(pMediaType, E_POINTER);
+	CAutoLock lock(m_pFilter->pStateLock());
+
+	const HapFrameIndex & index = m_pSource->m_Index;
+	const GUID * pSubtype = getSubtype(index.codec);
+	if (pSubtype == NULL) return E_UNEXPECTED;
+
+	VIDEOINFOHEADER * pvi = (VIDEOINFOHEADER*)pMediaType->AllocFormatBuffer(sizeof(VIDEOINFOHEADER));
+	if (pvi == NULL) return E_OUTOFMEMORY;
+	ZeroMemory(pvi, sizeof(VIDEOINFOHEADER));
+
+	pvi->AvgTimePerFrame = index.frameDuration;
+	pvi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	pvi->bmiHeader.biWidth = index.width;
+	pvi->bmiHeader.biHeight = index.height;
+	pvi->bmiHeader.biPlanes = 1;
+	pvi->bmiHeader.biBitCount = index.codec == HAP_CODEC_HAP1 ? 24 : 32;
+	pvi->bmiHeader.biCompression = index.codec;
+	pvi->bmiHeader.biSizeImage = index.getMaxFrameSize();
+
+	pMediaType->SetType(&MEDIATYPE_Video);
+	pMediaType->SetSubtype(pSubtype);
+	pMediaType->SetFormatType(&FORMAT_VideoInfo);
+	pMediaType->SetTemporalCompression(FALSE);
+	pMediaType->SetVariableSize();
+	return S_OK;
+}
+
+HRESULT DSHapSourceStream::DecideBufferSize(IMemAllocator * pAlloc, ALLOCATOR_PROPERTIES * pProperties) {
+	CheckPointer(pAlloc, E_POINTER);
+	CheckPointer(pProperties, E_POINTER);
+	CAutoLock lock(m_pFilter->pStateLock());
+
+	// the decoder asks for more buffers when it decodes ahead
+	if (pProperties->cBuffers < 2) pProperties->cBuffers = 2;
+	pProperties->cbBuffer = m_pSource->m_Index.getMaxFrameSize();
+	if (pProperties->cbAlign < 1) pProperties->cbAlign = 1;
+
+	ALLOCATOR_PROPERTIES Actual;
+	HRESULT hr = pAlloc->SetProperties(pProperties, &Actual);
+	if (FAILED(hr)) return hr;
+	if (Actual.cbBuffer < pProperties->cbBuffer) return E_FAIL;
+	return S_OK;
+}
+
+HRESULT DSHapSourceStream::FillBuffer(IMediaSample * pSample) {
+	CheckPointer(pSample, E_POINTER);
+	const HapFrameIndex & index = m_pSource->m_Index;
+
+	HapFrameStep step;
+	bool bDiscontinuity;
+	long lLooped = 0;
+	int upcoming[HAPSOURCE_READAHEAD_FRAMES];
+	int numUpcoming = 0;
+	{
+		CAutoLock lock(&m_SeekLock);
+		// sample times count from the start of the segment, scaled by its rate and the speed. Every
+		// frame starts where the one before stopped, across loops, turns and speed changes too
+		m_Stepper.setRate((m_dRateSeeking > 0.0 ? m_dRateSeeking : 1.0) * fabs(m_dSpeed));
+		// the stop position ends a clip that plays forward without looping, a loop ends at its out frame
+		if (!m_Stepper.next(m_Playhead, index, step)) return S_FALSE;
+		if (m_Playhead.getLoopMode() == HapLoopMode_None && m_Playhead.getDirection() > 0 && index.getFrameTime(step.frame) >= m_rtStop) return S_FALSE;
+		if (step.bWrapped) lLooped = ++m_lLoops;
+		m_framesDelivered++;
+		m_framesSkipped += step.skipped;
+		bDiscontinuity = m_bDiscontinuity;
+		m_bDiscontinuity = false;
+
+		// the frames the stepper will deliver next, not the ones it will skip
+		HapPlayhead ahead = m_Playhead;
+		HapFrameStepper stepper = m_Stepper;
+		HapFrameStep next;
+		while (numUpcoming < HAPSOURCE_READAHEAD_FRAMES && stepper.next(ahead, index, next)) {
+			upcoming[numUpcoming++] = next.frame;
+		}
+	}
+	if (lLooped) m_pSource->NotifyEvent(EC_HAP_LOOPED, lLooped, 0);
+
+	BYTE * pData = NULL;
+	HRESULT hr = pSample->GetPointer(&pData);
+	if (FAILED(hr)) return hr;
+
+	// one read per frame, usually done ahead on the pool in the order of play
+	HapReadAhead & readAhead = m_pSource->m_ReadAhead;
+	if (!readAhead.read(step.frame, pData, pSample->GetSize())) return E_FAIL;
+	readAhead.schedule(upcoming, numUpcoming);
+
+	pSample->SetActualDataLength(index.getFrame(step.frame).size);
+	// the frame number, which keeps counting from 0 in every loop, passes the decoder with the sample
+	REFERENCE_TIME rtStart = step.start;
+	REFERENCE_TIME rtStop = step.stop;
+	LONGLONG mediaStart = step.frame;
+	LONGLONG mediaStop = step.frame + 1;
+	pSample->SetTime(&rtStart, &rtStop);
+	pSample->SetMediaTime(&mediaStart, &mediaStop);
+	pSample->SetSyncPoint(TRUE);
+	pSample->SetDiscontinuity(bDiscontinuity ? TRUE : FALSE);
+	return S_OK;
+}
+
+HRESULT DSHapSourceStream::OnThreadStartPlay() {
+	CAutoLock lock(&m_SeekLock);
+	m_bDiscontinuity = true;
+	return DeliverNewSegment(m_rtStart, m_rtStop, m_dRateSeeking);
+}
+
+/////////////////////// seeking //////////////////////////
+
+HRESULT DSHapSourceStream::ChangeStart() {
+	{
+		CAutoLock lock(&m_SeekLock);
+		// a seek to a frame number starts at that frame, no search of the times
+		m_Playhead.seek(m_iPendingFrame >= 0 ? m_iPendingFrame : m_pSource->m_Index.findFrame(m_rtStart));
+		m_iPendingFrame = -1;
+		m_Stepper.restart(m_rtStart);
+	}
+	UpdateFromSeek();
+	return S_OK;
+}
+
+HRESULT DSHapSourceStream::ChangeStop() {
+	// FillBuffer checks the stop time before every frame
+	return S_OK;
+}
+
+HRESULT DSHapSourceStream::ChangeRate() {
+	{
+		CAutoLock lock(&m_SeekLock);
+		if (m_dRateSeeking <= 0.0) {
+			m_dRateSeeking = 1.0;
+			return E_INVALIDARG;
+		}
+	}
+	UpdateFromSeek();
+	return S_OK;
+}
+
+// restart the streaming thread, the new segment starts at the new position
+void DSHapSourceStream::UpdateFromSeek() {
+	if (ThreadExists()) {
+		DeliverBeginFlush();
+		Stop();
+		DeliverEndFlush();
+		Run();
+	}
+}
+
+LONGLONG DSHapSourceStream::ToMediaTime(LONGLONG position, const GUID & format) {
+	if (format != TIME_FORMAT_FRAME) return position;
+	return m_pSource->m_Index.getFrameTime((int)position);
+}
+
+LONGLONG DSHapSourceStream::FromMediaTime(LONGLONG time, const GUID & format) {
+	if (format != TIME_FORMAT_FRAME) return time;
+	const HapFrameIndex & index = m_pSource->m_Index;
+	if (time >= index.duration) return index.getFrameCount();
+	return index.findFrame(time);
+}
+
+STDMETHODIMP DSHapSourceStream::IsFormatSupported(const GUID * pFormat) {
+	CheckPointer(pFormat, E_POINTER);
+	return (*pFormat == TIME_FORMAT_MEDIA_TIME || *pFormat == TIME_FORMAT_FRAME) ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP DSHapSourceStream::QueryPreferredFormat(GUID * pFormat) {
+	CheckPointer(pFormat, E_POINTER);
+	*pFormat = TIME_FORMAT_MEDIA_TIME;
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::SetTimeFormat(const GUID * pFormat) {
+	CheckPointer(pFormat, E_POINTER);
+	if (IsFormatSupported(pFormat) != S_OK) return E_INVALIDARG;
+	CAutoLock lock(&m_SeekLock);
+	m_TimeFormat = *pFormat;
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::IsUsingTimeFormat(const GUID * pFormat) {
+	CheckPointer(pFormat, E_POINTER);
+	CAutoLock lock(&m_SeekLock);
+	return *pFormat == m_TimeFormat ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP DSHapSourceStream::GetTimeFormat(GUID * pFormat) {
+	CheckPointer(pFormat, E_POINTER);
+	CAutoLock lock(&m_SeekLock);
+	*pFormat = m_TimeFormat;
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::GetDuration(LONGLONG * pDuration) {
+	CheckPointer(pDuration, E_POINTER);
+	CAutoLock lock(&m_SeekLock);
+	*pDuration = FromMediaTime(m_rtDuration, m_TimeFormat);
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::GetStopPosition(LONGLONG * pStop) {
+	CheckPointer(pStop, E_POINTER);
+	CAutoLock lock(&m_SeekLock);
+	*pStop = FromMediaTime(m_rtStop, m_TimeFormat);
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::GetCurrentPosition(LONGLONG * pCurrent) {
+	// the renderer knows, like with any other source
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP DSHapSourceStream::ConvertTimeFormat(LONGLONG * pTarget, const GUID * pTargetFormat, LONGLONG Source, const GUID * pSourceFormat) {
+	CheckPointer(pTarget, E_POINTER);
+	CAutoLock lock(&m_SeekLock);
+
+	// NULL is the current format
+	const GUID & targetFormat = pTargetFormat ? *pTargetFormat : m_TimeFormat;
+	const GUID & sourceFormat = pSourceFormat ? *pSourceFormat : m_TimeFormat;
+	if (IsFormatSupported(&targetFormat) != S_OK || IsFormatSupported(&sourceFormat) != S_OK) return E_INVALIDARG;
+
+	*pTarget = FromMediaTime(ToMediaTime(Source, sourceFormat), targetFormat);
+	return S_OK;
+}
+
+STDMETHODIMP DSHapSourceStream::SetPositions(LONGLONG * pCurrent, DWORD CurrentFlags, LONGLONG * pStop, DWORD StopFlags) {
+	GUID format;
+	{
+		CAutoLock lock(&m_SeekLock);
+		format = m_TimeFormat;
+	}
+	if (format == TIME_FORMAT_MEDIA_TIME) {
+		return CSourceSeeking::SetPositions(pCurrent, CurrentFlags, pStop, StopFlags);
+	}
+
+	// frames to media time, relative frame counts become relative times of the same length
+	LONGLONG current = 0;
+	LONGLONG stop = 0;
+	DWORD currentBits = CurrentFlags & AM_SEEKING_PositioningBitsMask;
+	DWORD stopBits = StopFlags & AM_SEEKING_PositioningBitsMask;
+	{
+		CAutoLock lock(&m_SeekLock);
+		const HapFrameIndex & index = m_pSource->m_Index;
+		if (currentBits && pCurrent) {
+			current = currentBits == AM_SEEKING_AbsolutePositioning ? ToMediaTime(*pCurrent, format) : *pCurrent * index.frameDuration;
+			if (currentBits == AM_SEEKING_AbsolutePositioning && *pCurrent >= 0 && *pCurrent < index.getFrameCount()) {
+				m_iPendingFrame = (int)*pCurrent;
+			}
+		}
+		if (stopBits && pStop) {
+			stop = stopBits == AM_SEEKING_AbsolutePositioning ? ToMediaTime(*pStop, format) : *pStop * index.frameDuration;
+		}
+	}
+
+	HRESULT hr = CSourceSeeking::SetPositions(pCurrent ? &current : NULL, CurrentFlags, pStop ? &stop : NULL, StopFlags);
+	{
+		CAutoLock lock(&m_SeekLock);
+		m_iPendingFrame = -1;
+		if (SUCCEEDED(hr)) {
+			if (pCurrent && (CurrentFlags & AM_SEEKING_ReturnTime)) *pCurrent = FromMediaTime(m_rtStart, format);
+			if (pStop && (StopFlags & AM_SEEKING_ReturnTime)) *pStop = FromMediaTime(m_rtStop, format);
+		}
+	}
+	return hr;
+}
+
+void DSHapSourceStream::SetLoop(HapLoopMode mode, int inFrame, int outFrame) {
+	CAutoLock lock(&m_SeekLock);
+	m_Playhead.setLoop(mode, inFrame, outFrame);
+}
+
+void DSHapSourceStream::SetSpeed(double speed) {
+	CAutoLock lock(&m_SeekLock);
+	// a change of sign reverses whichever way the playhead goes, a palindrome may be heading back
+	if ((speed < 0.0) != (m_dSpeed < 0.0)) m_Playhead.setDirection(-m_Playhead.getDirection());
+	m_dSpeed = speed;
+}
+
+void DSHapSourceStream::SetRefreshInterval(REFERENCE_TIME interval) {
+	CAutoLock lock(&m_SeekLock);
+	m_Stepper.setRefreshInterval(interval);
+}
+
+HapSourceStats DSHapSourceStream::GetStats() {
+	CAutoLock lock(&m_SeekLock);
+	HapSourceStats stats;
+	stats.framesDelivered = m_framesDelivered;
+	stats.framesSkipped = m_framesSkipped;
+	stats.refreshInterval = m_Stepper.getRefreshInterval();
+	return stats;
+}
+
+STDMETHODIMP DSHapSourceStream::GetPositions(LONGLONG * pCurrent, LONGLONG * pStop) {
+	CAutoLock lock(&m_SeekLock);
+	if (pCurrent) *pCurrent = FromMediaTime(m_rtStart, m_TimeFormat);
+	if (pStop) *pStop = FromMediaTime(m_rtStop, m_TimeFormat);
+	return S_OK;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "DSShared.h"
+#include <streams.h>
+#include <string>
+#include "uids.h"
+#include "HapDemuxer.h"
+#include "HapFrameStepper.h"
+#include "HapPlayhead.h"
+#include "HapReadAhead.h"
+
+#define HAPSOURCE_FILTERNAME L"Hap Source"
+
+// frames read from the file ahead of the one being delivered, in the order they'll play
+#define HAPSOURCE_READAHEAD_FRAMES 3
+
+// sent when a loop restarted or a palindrome turned, param1 = loops so far
+#define EC_HAP_LOOPED (EC_USER + 2)
+
+class DSHapSource;
+
+struct HapSourceStats {
+	uint64_t framesDelivered;	// read and sent on to the decoder
+	uint64_t framesSkipped;		// no display refresh would have shown them, never read or decoded
+	REFERENCE_TIME refreshInterval;	// stream time between display refreshes, 0 = every frame is delivered
+};
+
+// pushes the HAP frames straight from the frame index, seekable in media time and in frames
+class DSHapSourceStream : public CSourceStream, public CSourceSeeking {
+
+public:
+
+	DSHapSourceStream(DSHapSource * pSource, HRESULT * phr);
+
+	// both bases are CUnknowns, the pin is the owner
+	STDMETHODIMP QueryInterface(REFIID riid, void ** ppv) { return CSourceStream::GetOwner()->QueryInterface(riid, ppv); }
+	STDMETHODIMP_(ULONG) AddRef() { return CSourceStream::GetOwner()->AddRef(); }
+	STDMETHODIMP_(ULONG) Release() { return CSourceStream::GetOwner()->Release(); }
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, void ** ppv);
+
+	// CSourceStream
+	HRESULT GetMediaType(CMediaType * pMediaType);
+	HRESULT DecideBufferSize(IMemAllocator * pAlloc, ALLOCATOR_PROPERTIES * pProperties);
+	HRESULT FillBuffer(IMediaSample * pSample);
+	HRESULT OnThreadStartPlay();
+
+	// IMediaSeeking, TIME_FORMAT_FRAME on top of CSourceSeeking's media time
+	STDMETHODIMP IsFormatSupported(const GUID * pFormat);
+	STDMETHODIMP QueryPreferredFormat(GUID * pFormat);
+	STDMETHODIMP SetTimeFormat(const GUID * pFormat);
+	STDMETHODIMP IsUsingTimeFormat(const GUID * pFormat);
+	STDMETHODIMP GetTimeFormat(GUID * pFormat);
+	STDMETHODIMP GetDuration(LONGLONG * pDuration);
+	STDMETHODIMP GetStopPosition(LONGLONG * pStop);
+	STDMETHODIMP GetCurrentPosition(LONGLONG * pCurrent);
+	STDMETHODIMP ConvertTimeFormat(LONGLONG * pTarget, const GUID * pTargetFormat, LONGLONG Source, const GUID * pSourceFormat);
+	STDMETHODIMP SetPositions(LONGLONG * pCurrent, DWORD CurrentFlags, LONGLONG * pStop, DWORD StopFlags);
+	STDMETHODIMP GetPositions(LONGLONG * pCurrent, LONGLONG * pStop);
+
+	// take effect with the next frame, no seek
+	void SetLoop(HapLoopMode mode, int inFrame, int outFrame);
+	void SetSpeed(double speed);
+	void SetRefreshInterval(REFERENCE_TIME interval);
+
+	HapSourceStats GetStats();
+
+protected:
+
+	// CSourceSeeking
+	HRESULT ChangeStart();
+	HRESULT ChangeStop();
+	HRESULT ChangeRate();
+
+private:
+
+	void UpdateFromSeek();
+	LONGLONG ToMediaTime(LONGLONG position, const GUID & format);
+	LONGLONG FromMediaTime(LONGLONG time, const GUID & format);
+
+	DSHapSource * m_pSource;
+	CCritSec m_SeekLock;
+	GUID m_TimeFormat;
+	HapPlayhead m_Playhead;		// which frame to deliver next
+	HapFrameStepper m_Stepper;	// and when, skipping the ones that wouldn't be seen
+	int m_iPendingFrame;		// frame of a frame format seek in progress, -1 otherwise
+	bool m_bDiscontinuity;
+	double m_dSpeed;			// on top of the graph's rate, negative reverses the playhead
+	long m_lLoops;
+	uint64_t m_framesDelivered;
+	uint64_t m_framesSkipped;
+};
+
+// source filter for HAP movies, reads the frames with the in-project demuxers instead of a splitter
+class DSHapSource : public CSource {
+
+public:
+
+	DSHapSource(IUnknown * pOuter, HRESULT * phr);
+	~DSHapSource();
+
+	static CUnknown *WINAPI CreateInstance(LPUNKNOWN punk, HRESULT *phr);
+
+	// builds the frame index and the output pin, fails for files the demuxers can't read
+	HRESULT Open(const std::string & path);
+
+	const HapFrameIndex & GetIndex() { return m_Index; }
+
+	// loops (or turns) at the region ends without ending the stream, the sample times keep
+	// counting up so nothing downstream gets flushed or sees a new segment. outFrame < 0 = last frame
+	void SetLoop(HapLoopMode mode, int inFrame = 0, int outFrame = -1);
+
+	// negative plays backward. The frames are timed for the speed here instead of changing the
+	// graph's rate, so speed and direction change with the next frame without a flush
+	HRESULT SetSpeed(double speed);
+
+	// with the display's refresh interval set, frames that would be over before the next refresh
+	// are skipped without reading them, so fast forward costs about one frame per refresh at
+	// any speed. 0 = deliver every frame
+	void SetRefreshInterval(REFERENCE_TIME interval);
+
+	HapSourceStats GetStats();
+	HapReadAheadStats GetReadAheadStats() { return m_ReadAhead.getStats(); }
+
+private:
+
+	friend class DSHapSourceStream;
+
+	HapMediaFile m_File;
+	HapFrameIndex m_Index;
+	DSHapSourceStream * m_pStream;
+	HapReadAhead m_ReadAhead;		// before the file and index in destruction order, waits for its reads
+};
@@ -10,6 +10,9 @@
 DSRawSampleGrabber::DSRawSampleGrabber(IUnknown * pOuter, HRESULT * phr, BOOL ModifiesData)
 	: CVideoTransformFilter(FILTERNAME, (IUnknown*)pOuter, CLSID_RawSampleGrabber) {
 	callback = NULL;
+	pCallback = NULL;
+	m_InputBuffers = 0;
+	m_Lookahead = 0;
 }
 
 DSRawSampleGrabber::~DSRawSampleGrabber() {
@@ -24,6 +27,52 @@ CUnknown *WINAPI DSRawSampleGrabber::CreateInstance(LPUNKNOWN punk, HRESULT *phr
 	return pNewObject;
 }
 
+/////////////////////// input pin //////////////////////////
+
+DSRawSampleGrabberInputPin::DSRawSampleGrabberInputPin(DSRawSampleGrabber * pGrabber, HRESULT * phr)
+	: CTransformInputPin(NAME("Raw Sample Grabber input pin"), pGrabber, phr, L"In") {
+	m_pGrabber = pGrabber;
+}
+
+STDMETHODIMP DSRawSampleGrabberInputPin::GetAllocatorRequirements(ALLOCATOR_PROPERTIES * pProps) {
+	CheckPointer(pProps, E_POINTER);
+	if (m_pGrabber->m_InputBuffers <= 0) return E_NOTIMPL;
+
+	pProps->cBuffers = m_pGrabber->m_InputBuffers;
+	pProps->cbBuffer = 0; // upstream knows the frame size
+	pProps->cbAlign = 1;
+	pProps->cbPrefix = 0;
+	return S_OK;
+}
+
+long DSRawSampleGrabberInputPin::GetAllocatorBufferCount() {
+	if (!m_pAllocator) return 0;
+
+	ALLOCATOR_PROPERTIES props;
+	if (FAILED(m_pAllocator->GetProperties(&props))) return 0;
+	return props.cBuffers;
+}
+
+CBasePin * DSRawSampleGrabber::GetPin(int n) {
+	HRESULT hr = S_OK;
+
+	// same as CTransformFilter::GetPin, but with our own input pin
+	if (m_pInput == NULL) {
+		m_pInput = new DSRawSampleGrabberInputPin(this, &hr);
+		if (m_pInput == NULL) return NULL;
+
+		m_pOutput = new CTransformOutputPin(NAME("Raw Sample Grabber output pin"), this, &hr, L"Out");
+		if (m_pOutput == NULL) {
+			delete m_pInput;
+			m_pInput = NULL;
+		}
+	}
+
+	if (n == 0) return m_pInput;
+	if (n == 1) return m_pOutput;
+	return NULL;
+}
+
 /////////////////////// IUnknown //////////////////////////
 HRESULT DSRawSampleGrabber::NonDelegatingQueryInterface(const IID &riid, void **ppv) {
 	return CVideoTransformFilter::NonDelegatingQueryInterface(riid, ppv);
@@ -68,12 +117,20 @@ HRESULT DSRawSampleGrabber::CheckInputType(const CMediaType *pmt)
 HRESULT DSRawSampleGrabber::Transform(IMediaSample * pIn, IMediaSample *pOut){
 	if (!pCallback) return S_OK;
 
-	REFERENCE_TIME sampleTime;
-	REFERENCE_TIME totalDuration;
-	HRESULT hr = pIn->GetTime(&sampleTime, &totalDuration);
+	REFERENCE_TIME sampleTime = 0;
+	REFERENCE_TIME sampleStopTime = 0;
+	HRESULT hr = pIn->GetTime(&sampleTime, &sampleStopTime);
+
+	// send the input buffer thru, the callback can get the exact 64-bit times via GetMediaTime
+	pCallback->SampleCB(sampleTime / 10000000.0, pIn);
 
-	// send the input buffer thru
-	pCallback->SampleCB(long(sampleTime), pIn);
+	// the null renderer holds each sample until its time, so releasing it early lets the next frames in
+	REFERENCE_TIME lookahead = m_Lookahead.load();
+	if (lookahead > 0 && SUCCEEDED(hr)) {
+		sampleTime -= lookahead;
+		sampleStopTime -= lookahead;
+		pOut->SetTime(&sampleTime, hr == VFW_S_NO_STOP_TIME ? NULL : &sampleStopTime);
+	}
 
 	return S_OK;
 }
@@ -130,3 +187,55 @@ HRESULT STDMETHODCALLTYPE DSRawSampleGrabber::SetCallback(ISampleGrabberCB *pCal
 	this->pCallback = pCallback;
 	return S_OK;
 }
+
+// only valid on the streaming thread, i.e. from within SampleCB
+HRESULT DSRawSampleGrabber::GetMediaTime(IMediaSample * pSample, REFERENCE_TIME * pStart, REFERENCE_TIME * pStop) {
+	CheckPointer(pSample, E_POINTER);
+	CheckPointer(pStart, E_POINTER);
+	CheckPointer(pStop, E_POINTER);
+
+	REFERENCE_TIME tStart = 0;
+	REFERENCE_TIME tStop = 0;
+	HRESULT hr = pSample->GetTime(&tStart, &tStop);
+	if (FAILED(hr)) return hr;
+	if (hr == VFW_S_NO_STOP_TIME) tStop = tStart;
+
+	// sample times restart at zero with every segment (e.g. after a seek)
+	REFERENCE_TIME tSegmentStart = m_pInput->CurrentStartTime();
+	double dRate = m_pInput->CurrentRate();
+	if (dRate == 0.0) dRate = 1.0;
+
+	*pStart = tSegmentStart + (REFERENCE_TIME)(tStart * dRate);
+	*pStop = tSegmentStart + (REFERENCE_TIME)(tStop * dRate);
+	return hr;
+}
+
+HRESULT DSRawSampleGrabber::GetCurrentMediaTime(REFERENCE_TIME * pTime) {
+	CheckPointer(pTime, E_POINTER);
+	if (!m_pClock || m_State != State_Running) return VFW_E_NO_CLOCK;
+
+	REFERENCE_TIME now = 0;
+	HRESULT hr = m_pClock->GetTime(&now);
+	if (FAILED(hr)) return hr;
+
+	double dRate = m_pInput->CurrentRate();
+	if (dRate == 0.0) dRate = 1.0;
+
+	*pTime = m_pInput->CurrentStartTime() + (REFERENCE_TIME)((now - m_tStart) * dRate);
+	return S_OK;
+}
+
+void DSRawSampleGrabber::SetLookahead(REFERENCE_TIME lookahead) {
+	m_Lookahead.store(lookahead);
+}
+
+// has to be called before the input pin gets connected
+void DSRawSampleGrabber::SetInputBufferCount(long buffers) {
+	m_InputBuffers = buffers;
+}
+
+// number of buffers the upstream allocator actually committed to
+long DSRawSampleGrabber::GetInputBufferCount() {
+	if (!m_pInput || !m_pInput->IsConnected()) return 0;
+	return ((DSRawSampleGrabberInputPin*)m_pInput)->GetAllocatorBufferCount();
+}
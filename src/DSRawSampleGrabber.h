@@ -2,6 +2,7 @@
 
 #include "DSShared.h"
 #include <assert.h>
+#include <atomic>
 #include <streams.h>
 #include "uids.h"
 
@@ -9,6 +10,23 @@
 
 typedef HRESULT(CALLBACK *MANAGEDCALLBACKPROC)(double Time, IMediaSample *pSample);
 
+class DSRawSampleGrabber;
+
+// input pin that asks upstream for enough buffers, so samples we hold on to don't stall it
+class DSRawSampleGrabberInputPin : public CTransformInputPin {
+
+public:
+
+	DSRawSampleGrabberInputPin(DSRawSampleGrabber * pGrabber, HRESULT * phr);
+
+	STDMETHODIMP GetAllocatorRequirements(ALLOCATOR_PROPERTIES * pProps);
+	long GetAllocatorBufferCount();
+
+private:
+
+	DSRawSampleGrabber * m_pGrabber;
+};
+
 // CTransInPlaceFilter
 class DSRawSampleGrabber : public CVideoTransformFilter {
 
@@ -21,6 +39,10 @@ private:
 	long m_Height;
 	long m_SampleSize;
 	long m_Stride;
+	long m_InputBuffers;
+	std::atomic<REFERENCE_TIME> m_Lookahead;	// set by the render thread, read by the streaming thread
+
+	friend class DSRawSampleGrabberInputPin;
 
 public:
 
@@ -39,9 +61,23 @@ public:
 	HRESULT CheckTransform(const CMediaType* mtIn, const CMediaType* mtOut);
 	HRESULT DecideBufferSize(IMemAllocator * pAlloc, ALLOCATOR_PROPERTIES * pProperties);
 	HRESULT GetMediaType(int iPosition, CMediaType * pMediaType);
+	CBasePin * GetPin(int n);
 
 	// custom
 	HRESULT STDMETHODCALLTYPE SetCallback(ISampleGrabberCB *pCallback, long WhichMethodToCallback);
 
 	STDMETHODIMP RegisterCallback(MANAGEDCALLBACKPROC mdelegate);
+
+	// maps a received sample's stream times to media times of the current segment
+	HRESULT GetMediaTime(IMediaSample * pSample, REFERENCE_TIME * pStart, REFERENCE_TIME * pStop);
+
+	// current presentation time in media time of the current segment, fails unless running with a clock
+	HRESULT GetCurrentMediaTime(REFERENCE_TIME * pTime);
+
+	// let frames pass this much earlier than their presentation time, so they can be buffered ahead
+	void SetLookahead(REFERENCE_TIME lookahead);
+
+	// number of buffers requested from the upstream allocator, 0 = let upstream decide
+	void SetInputBufferCount(long buffers);
+	long GetInputBufferCount();
 };
\ No newline at end of file
@@ -24,7 +24,7 @@ ISampleGrabberCB : public IUnknown
 public:
 
 	virtual HRESULT STDMETHODCALLTYPE SampleCB(
-		long SampleTime,
+		double SampleTime,
 		IMediaSample *pSample) = 0;
 
 	virtual HRESULT STDMETHODCALLTYPE BufferCB(
@@ -0,0 +1,512 @@
+#include "DXTBlockDecoder.h"
+#include "DXTThreadPool.h"
+
+#include <string.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DXT_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DXT_TARGET_SSE2
+#define DXT_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define DXT_TARGET_SSE2 __attribute__((target("sse2")))
+#define DXT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// pixels are packed as R | G << 8 | B << 16 | A << 24, i.e. RGBA bytes in memory
+#define PACK_RGBA(r, g, b, a) ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+typedef void (*DXTColorProc)(const unsigned char * block, const uint32_t palette[4], uint32_t pixels[16]);
+typedef void (*DXTAlphaProc)(const unsigned char * block, uint32_t pixels[16]);
+typedef void (*DXTBlockProc)(const unsigned char * block, uint32_t pixels[16]);
+
+static std::atomic<int> s_instructionSet(-1);
+
+static inline uint32_t readLE32(const unsigned char * p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 48 bits of 3 bit alpha indices
+static inline uint64_t readAlphaIndices(const unsigned char * block) {
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++) indices |= (uint64_t)block[2 + i] << (8 * i);
+	return indices;
+}
+
+static inline uint8_t clampByte(int v) {
+	return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+//////////////////////////////// palettes ////////////////////////////////
+
+// BC1 color endpoints and the two interpolated colors. BC3 color blocks are always in four color
+// mode, BC1 blocks with c0 <= c1 have one interpolated color and transparent black.
+static void colorPalette(const unsigned char * block, bool bFourColors, uint32_t alpha, uint32_t palette[4]) {
+	unsigned int c0 = block[0] | (block[1] << 8);
+	unsigned int c1 = block[2] | (block[3] << 8);
+
+	int r0 = (c0 >> 11) & 31, g0 = (c0 >> 5) & 63, b0 = c0 & 31;
+	int r1 = (c1 >> 11) & 31, g1 = (c1 >> 5) & 63, b1 = c1 & 31;
+	r0 = (r0 << 3) | (r0 >> 2); g0 = (g0 << 2) | (g0 >> 4); b0 = (b0 << 3) | (b0 >> 2);
+	r1 = (r1 << 3) | (r1 >> 2); g1 = (g1 << 2) | (g1 >> 4); b1 = (b1 << 3) | (b1 >> 2);
+
+	palette[0] = PACK_RGBA(r0, g0, b0, 0) | alpha;
+	palette[1] = PACK_RGBA(r1, g1, b1, 0) | alpha;
+	if (bFourColors || c0 > c1) {
+		palette[2] = PACK_RGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 0) | alpha;
+		palette[3] = PACK_RGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 0) | alpha;
+	}
+	else {
+		palette[2] = PACK_RGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 0) | alpha;
+		palette[3] = 0;
+	}
+}
+
+// BC3 alpha endpoints and six interpolated values, or four plus 0 and 255
+static void alphaPalette(const unsigned char * block, uint8_t palette[8]) {
+	int a0 = block[0];
+	int a1 = block[1];
+	palette[0] = (uint8_t)a0;
+	palette[1] = (uint8_t)a1;
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1) / 7);
+	}
+	else {
+		for (int i = 1; i < 5; i++) palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// YCoCg-DXT5 stores Co, Cg (offset by 128), a scale s and Y in R, G, B and A. Same constants as
+// the player's shader: R = Y + (Co - Cg) / (s / 8 + 1), G = Y + Cg / (s / 8 + 1), B = Y - (Co + Cg) / (s / 8 + 1).
+// Co, Cg and s only come from the color endpoints, so the chroma of a block's four colors is
+// worked out once in fixed point (reciprocals of s + 8 with 14 fraction bits, rounded) and
+// every pixel just adds its Y, saturating
+#define YCOCG_RECIPROCAL_BITS 14
+
+struct YCoCgReciprocals {
+	int16_t r[256];
+	YCoCgReciprocals() {
+		for (int s = 0; s < 256; s++) {
+			r[s] = (int16_t)(((8 << YCOCG_RECIPROCAL_BITS) + (s + 8) / 2) / (s + 8));
+		}
+	}
+};
+static const YCoCgReciprocals s_ycocgReciprocals;
+
+// the scalar reference the SIMD versions have to match bit for bit
+static void chromaPalette(const uint32_t palette[4], int chroma[4][3]) {
+	const int round = 1 << (YCOCG_RECIPROCAL_BITS - 1);
+	for (int i = 0; i < 4; i++) {
+		int co = (int)(palette[i] & 0xFF) - 128;
+		int cg = (int)((palette[i] >> 8) & 0xFF) - 128;
+		int r = s_ycocgReciprocals.r[(palette[i] >> 16) & 0xFF];
+		chroma[i][0] = ((co - cg) * r + round) >> YCOCG_RECIPROCAL_BITS;
+		chroma[i][1] = (cg * r + round) >> YCOCG_RECIPROCAL_BITS;
+		chroma[i][2] = (-(co + cg) * r + round) >> YCOCG_RECIPROCAL_BITS;
+	}
+}
+
+//////////////////////////////// scalar ////////////////////////////////
+
+static void colorIndicesScalar(const unsigned char * block, const uint32_t palette[4], uint32_t pixels[16]) {
+	uint32_t indices = readLE32(block + 4);
+	for (int i = 0; i < 16; i++) {
+		pixels[i] = palette[(indices >> (2 * i)) & 3];
+	}
+}
+
+static void alphaIndicesScalar(const unsigned char * block, uint32_t pixels[16]) {
+	uint8_t palette[8];
+	alphaPalette(block, palette);
+	uint64_t indices = readAlphaIndices(block);
+	for (int i = 0; i < 16; i++) {
+		pixels[i] |= (uint32_t)palette[(indices >> (3 * i)) & 7] << 24;
+	}
+}
+
+static void decodeYCoCgScalar(const unsigned char * block, uint32_t pixels[16]) {
+	uint32_t palette[4];
+	int chroma[4][3];
+	uint8_t luma[8];
+	colorPalette(block + 8, true, 0, palette);
+	chromaPalette(palette, chroma);
+	alphaPalette(block, luma);
+
+	uint32_t colorIndices = readLE32(block + 12);
+	uint64_t lumaIndices = readAlphaIndices(block);
+	for (int i = 0; i < 16; i++) {
+		const int * c = chroma[(colorIndices >> (2 * i)) & 3];
+		int y = luma[(lumaIndices >> (3 * i)) & 7];
+		pixels[i] = PACK_RGBA(clampByte(y + c[0]), clampByte(y + c[1]), clampByte(y + c[2]), 255);
+	}
+}
+
+//////////////////////////////// SSE2 ////////////////////////////////
+
+#ifdef DXT_X86
+
+// no variable shifts in SSE2, so every lane compares its own 2 bits of the row's index byte
+DXT_TARGET_SSE2 static void colorIndicesSSE2(const unsigned char * block, const uint32_t palette[4], uint32_t pixels[16]) {
+	const __m128i mask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+	const __m128i one = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+	const __m128i two = _mm_slli_epi32(one, 1);
+	const __m128i p0 = _mm_set1_epi32((int)palette[0]);
+	const __m128i p1 = _mm_set1_epi32((int)palette[1]);
+	const __m128i p2 = _mm_set1_epi32((int)palette[2]);
+	const __m128i p3 = _mm_set1_epi32((int)palette[3]);
+
+	uint32_t indices = readLE32(block + 4);
+	for (int row = 0; row < 4; row++) {
+		__m128i idx = _mm_and_si128(_mm_set1_epi32((int)(indices >> (8 * row))), mask);
+		__m128i s0 = _mm_cmpeq_epi32(idx, _mm_setzero_si128());
+		__m128i s1 = _mm_cmpeq_epi32(idx, one);
+		__m128i s2 = _mm_cmpeq_epi32(idx, two);
+		__m128i s3 = _mm_cmpeq_epi32(idx, mask);
+		__m128i c = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(s0, p0), _mm_and_si128(s1, p1)),
+			_mm_or_si128(_mm_and_si128(s2, p2), _mm_and_si128(s3, p3)));
+		_mm_storeu_si128((__m128i*)(pixels + 4 * row), c);
+	}
+}
+
+// chroma of the four palette colors, split into the positive and the negative part of each
+// channel as RGB0 bytes, so a pixel is (Y + positive) - negative with unsigned saturation
+DXT_TARGET_SSE2 static void chromaPaletteSSE2(const uint32_t palette[4], __m128i & positive, __m128i & negative) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_set1_epi32(0x0000FFFF);
+	const __m128i high = _mm_set1_epi32((int)0xFFFF0000);
+	const __m128i round = _mm_set1_epi32(1 << (YCOCG_RECIPROCAL_BITS - 1));
+
+	// Co and Cg as signed 16 bit pairs, one pair per color
+	__m128i p = _mm_loadu_si128((const __m128i*)palette);
+	__m128i cocg = _mm_or_si128(_mm_and_si128(p, _mm_set1_epi32(0xFF)), _mm_and_si128(_mm_slli_epi32(p, 8), _mm_set1_epi32(0xFF0000)));
+	cocg = _mm_sub_epi16(cocg, _mm_set1_epi16(128));
+
+	__m128i r = _mm_setr_epi32(
+		s_ycocgReciprocals.r[(palette[0] >> 16) & 0xFF], s_ycocgReciprocals.r[(palette[1] >> 16) & 0xFF],
+		s_ycocgReciprocals.r[(palette[2] >> 16) & 0xFF], s_ycocgReciprocals.r[(palette[3] >> 16) & 0xFF]);
+	r = _mm_or_si128(r, _mm_slli_epi32(r, 16));
+	__m128i negR = _mm_sub_epi16(zero, r);
+
+	// Co * r - Cg * r, Cg * r and -Co * r - Cg * r
+	__m128i red = _mm_madd_epi16(cocg, _mm_or_si128(_mm_and_si128(r, low), _mm_and_si128(negR, high)));
+	__m128i green = _mm_madd_epi16(cocg, _mm_and_si128(r, high));
+	__m128i blue = _mm_madd_epi16(cocg, negR);
+	red = _mm_srai_epi32(_mm_add_epi32(red, round), YCOCG_RECIPROCAL_BITS);
+	green = _mm_srai_epi32(_mm_add_epi32(green, round), YCOCG_RECIPROCAL_BITS);
+	blue = _mm_srai_epi32(_mm_add_epi32(blue, round), YCOCG_RECIPROCAL_BITS);
+
+	// r0-r3 g0-g3 and b0-b3 0000 as 16 bit, then interleaved to r g b 0 bytes per color
+	__m128i rg = _mm_packs_epi32(red, green);
+	__m128i b0 = _mm_packs_epi32(blue, zero);
+	__m128i pos = _mm_packus_epi16(_mm_max_epi16(rg, zero), _mm_max_epi16(b0, zero));
+	__m128i neg = _mm_packus_epi16(_mm_max_epi16(_mm_sub_epi16(zero, rg), zero), _mm_max_epi16(_mm_sub_epi16(zero, b0), zero));
+	pos = _mm_unpacklo_epi8(pos, _mm_srli_si128(pos, 8));
+	neg = _mm_unpacklo_epi8(neg, _mm_srli_si128(neg, 8));
+	positive = _mm_unpacklo_epi8(pos, _mm_srli_si128(pos, 8));
+	negative = _mm_unpacklo_epi8(neg, _mm_srli_si128(neg, 8));
+}
+
+// lanes whose index is 0, 1, 2 or 3 get e0, e1, e2 or e3
+DXT_TARGET_SSE2 static inline __m128i selectSSE2(__m128i idx, __m128i one, __m128i two, __m128i three, __m128i entries) {
+	__m128i s0 = _mm_cmpeq_epi32(idx, _mm_setzero_si128());
+	__m128i s1 = _mm_cmpeq_epi32(idx, one);
+	__m128i s2 = _mm_cmpeq_epi32(idx, two);
+	__m128i s3 = _mm_cmpeq_epi32(idx, three);
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(s0, _mm_shuffle_epi32(entries, 0x00)), _mm_and_si128(s1, _mm_shuffle_epi32(entries, 0x55))),
+		_mm_or_si128(_mm_and_si128(s2, _mm_shuffle_epi32(entries, 0xAA)), _mm_and_si128(s3, _mm_shuffle_epi32(entries, 0xFF))));
+}
+
+DXT_TARGET_SSE2 static void decodeYCoCgSSE2(const unsigned char * block, uint32_t pixels[16]) {
+	const __m128i mask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+	const __m128i one = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+	const __m128i two = _mm_slli_epi32(one, 1);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+	uint32_t palette[4];
+	uint8_t luma[8];
+	__m128i positive, negative;
+	colorPalette(block + 8, true, 0, palette);
+	chromaPaletteSSE2(palette, positive, negative);
+	alphaPalette(block, luma);
+
+	uint32_t colorIndices = readLE32(block + 12);
+	uint64_t lumaIndices = readAlphaIndices(block);
+	for (int row = 0; row < 4; row++) {
+		__m128i idx = _mm_and_si128(_mm_set1_epi32((int)(colorIndices >> (8 * row))), mask);
+		uint32_t bits = (uint32_t)(lumaIndices >> (12 * row));
+		__m128i y = _mm_setr_epi32(luma[bits & 7], luma[(bits >> 3) & 7], luma[(bits >> 6) & 7], luma[(bits >> 9) & 7]);
+		y = _mm_or_si128(y, _mm_slli_epi32(y, 8));
+		y = _mm_or_si128(y, _mm_slli_epi32(y, 16));
+
+		__m128i c = _mm_adds_epu8(y, selectSSE2(idx, one, two, mask, positive));
+		c = _mm_subs_epu8(c, selectSSE2(idx, one, two, mask, negative));
+		_mm_storeu_si128((__m128i*)(pixels + 4 * row), _mm_or_si128(c, opaque));
+	}
+}
+
+//////////////////////////////// AVX2 ////////////////////////////////
+
+// the palette fits a register, so the indices pick the colors directly
+DXT_TARGET_AVX2 static void colorIndicesAVX2(const unsigned char * block, const uint32_t palette[4], uint32_t pixels[16]) {
+	const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i three = _mm256_set1_epi32(3);
+	__m256i pal = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)palette));
+
+	uint32_t indices = readLE32(block + 4);
+	__m256i lo = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)(indices & 0xFFFF)), shifts), three);
+	__m256i hi = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)(indices >> 16)), shifts), three);
+	_mm256_storeu_si256((__m256i*)pixels, _mm256_permutevar8x32_epi32(pal, lo));
+	_mm256_storeu_si256((__m256i*)(pixels + 8), _mm256_permutevar8x32_epi32(pal, hi));
+}
+
+DXT_TARGET_AVX2 static void alphaIndicesAVX2(const unsigned char * block, uint32_t pixels[16]) {
+	const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i seven = _mm256_set1_epi32(7);
+
+	uint8_t palette[8];
+	alphaPalette(block, palette);
+	__m256i pal = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)palette)), 24);
+
+	uint64_t indices = readAlphaIndices(block);
+	for (int half = 0; half < 2; half++) {
+		uint32_t bits = (uint32_t)(indices >> (24 * half)) & 0xFFFFFF;
+		__m256i idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)bits), shifts), seven);
+		__m256i * p = (__m256i*)(pixels + 8 * half);
+		_mm256_storeu_si256(p, _mm256_or_si256(_mm256_loadu_si256(p), _mm256_permutevar8x32_epi32(pal, idx)));
+	}
+}
+
+DXT_TARGET_AVX2 static void decodeYCoCgAVX2(const unsigned char * block, uint32_t pixels[16]) {
+	const __m256i colorShifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i lumaShifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i three = _mm256_set1_epi32(3);
+	const __m256i seven = _mm256_set1_epi32(7);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	// Y from the low byte of each lane into all four
+	const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12,
+		0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+
+	uint32_t palette[4];
+	uint8_t luma[8];
+	__m128i positive, negative;
+	colorPalette(block + 8, true, 0, palette);
+	chromaPaletteSSE2(palette, positive, negative);
+	alphaPalette(block, luma);
+
+	__m256i pos = _mm256_broadcastsi128_si256(positive);
+	__m256i neg = _mm256_broadcastsi128_si256(negative);
+	__m256i lumaPalette = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)luma));
+
+	uint32_t colorIndices = readLE32(block + 12);
+	uint64_t lumaIndices = readAlphaIndices(block);
+	for (int half = 0; half < 2; half++) {
+		uint32_t colorBits = (colorIndices >> (16 * half)) & 0xFFFF;
+		uint32_t lumaBits = (uint32_t)(lumaIndices >> (24 * half)) & 0xFFFFFF;
+		__m256i cidx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)colorBits), colorShifts), three);
+		__m256i lidx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)lumaBits), lumaShifts), seven);
+
+		__m256i y = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(lumaPalette, lidx), spread);
+		__m256i c = _mm256_adds_epu8(y, _mm256_permutevar8x32_epi32(pos, cidx));
+		c = _mm256_subs_epu8(c, _mm256_permutevar8x32_epi32(neg, cidx));
+		_mm256_storeu_si256((__m256i*)(pixels + 8 * half), _mm256_or_si256(c, opaque));
+	}
+}
+
+static void cpuid(int info[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+	__cpuidex(info, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = (int)a; info[1] = (int)b; info[2] = (int)c; info[3] = (int)d;
+#endif
+}
+
+static uint64_t xgetbv0() {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+#endif
+
+//////////////////////////////// dispatch ////////////////////////////////
+
+DXTInstructionSet DXTBlockDecoder::getSupportedInstructionSet() {
+#ifdef DXT_X86
+	int info[4];
+	cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+
+	cpuid(info, 1, 0);
+	bool bSSE2 = (info[3] & (1 << 26)) != 0;
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	bool bAVX = (info[2] & (1 << 28)) != 0;
+
+	// AVX2 also needs the OS to save the YMM registers
+	if (maxLeaf >= 7 && bOSXSave && bAVX && (xgetbv0() & 6) == 6) {
+		cpuid(info, 7, 0);
+		if (info[1] & (1 << 5)) return DXTInstructionSet_AVX2;
+	}
+	if (bSSE2) return DXTInstructionSet_SSE2;
+#endif
+	return DXTInstructionSet_Scalar;
+}
+
+DXTInstructionSet DXTBlockDecoder::getInstructionSet() {
+	int instructionSet = s_instructionSet.load();
+	if (instructionSet < 0) {
+		instructionSet = getSupportedInstructionSet();
+		s_instructionSet.store(instructionSet);
+	}
+	return (DXTInstructionSet)instructionSet;
+}
+
+void DXTBlockDecoder::setInstructionSet(DXTInstructionSet instructionSet) {
+	// never more than the CPU can do
+	DXTInstructionSet supported = getSupportedInstructionSet();
+	s_instructionSet.store(instructionSet < supported ? instructionSet : supported);
+}
+
+const char * DXTBlockDecoder::getInstructionSetName(DXTInstructionSet instructionSet) {
+	switch (instructionSet) {
+	case DXTInstructionSet_Scalar: return "scalar";
+	case DXTInstructionSet_SSE2: return "SSE2";
+	case DXTInstructionSet_AVX2: return "AVX2";
+	}
+	return "unknown";
+}
+
+int DXTBlockDecoder::getChannels(DXTTextureFormat format) {
+	return format == TextureFormat_RGBA_DXT5 ? 4 : 3;
+}
+
+//////////////////////////////// decoding ////////////////////////////////
+
+static void writeBlock(const uint32_t pixels[16], unsigned char * dst, size_t dstStride, int channels, int cols, int rows) {
+	for (int y = 0; y < rows; y++) {
+		const uint32_t * src = pixels + 4 * y;
+		if (channels == 4) {
+			memcpy(dst, src, cols * 4);
+		}
+		else {
+			for (int x = 0; x < cols; x++) {
+				memcpy(dst + x * 3, src + x, 3);
+			}
+		}
+		dst += dstStride;
+	}
+}
+
+void DXTBlockDecoder::decodeBlockRows(DXTTextureFormat format, const unsigned char * src, int width, int height,
+	unsigned char * dst, size_t dstStride, int channels, int firstBlockRow, int endBlockRow) {
+
+	DXTColorProc colorIndices = colorIndicesScalar;
+	DXTAlphaProc alphaIndices = alphaIndicesScalar;
+	DXTBlockProc decodeYCoCg = decodeYCoCgScalar;
+#ifdef DXT_X86
+	DXTInstructionSet instructionSet = getInstructionSet();
+	if (instructionSet == DXTInstructionSet_AVX2) {
+		colorIndices = colorIndicesAVX2;
+		alphaIndices = alphaIndicesAVX2;
+		decodeYCoCg = decodeYCoCgAVX2;
+	}
+	else if (instructionSet == DXTInstructionSet_SSE2) {
+		colorIndices = colorIndicesSSE2;
+		decodeYCoCg = decodeYCoCgSSE2;
+	}
+#endif
+
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	size_t blockSize = format == TextureFormat_RGB_DXT1 ? 8 : 16;
+	if (endBlockRow > blocksHigh) endBlockRow = blocksHigh;
+
+	uint32_t palette[4];
+	uint32_t pixels[16];
+
+	for (int by = firstBlockRow; by < endBlockRow; by++) {
+		const unsigned char * block = src + (size_t)by * blocksWide * blockSize;
+		unsigned char * row = dst + (size_t)by * 4 * dstStride;
+		int rows = height - by * 4 < 4 ? height - by * 4 : 4;
+
+		for (int bx = 0; bx < blocksWide; bx++, block += blockSize) {
+			if (format == TextureFormat_RGB_DXT1) {
+				colorPalette(block, false, 0xFF000000, palette);
+				colorIndices(block, palette, pixels);
+			}
+			else if (format == TextureFormat_YCoCg_DXT5) {
+				// converted while the block is still in registers
+				decodeYCoCg(block, pixels);
+			}
+			else {
+				colorPalette(block + 8, true, 0, palette);
+				colorIndices(block + 8, palette, pixels);
+				alphaIndices(block, pixels);
+			}
+
+			int cols = width - bx * 4 < 4 ? width - bx * 4 : 4;
+			writeBlock(pixels, row + (size_t)bx * 4 * channels, dstStride, channels, cols, rows);
+		}
+	}
+}
+
+struct DXTDecodeJob {
+	DXTTextureFormat format;
+	const unsigned char * src;
+	int width;
+	int height;
+	unsigned char * dst;
+	size_t dstStride;
+	int channels;
+	int blockRowsPerTask;
+};
+
+static void decodeTask(void * arg, int index) {
+	DXTDecodeJob * job = (DXTDecodeJob*)arg;
+	int first = index * job->blockRowsPerTask;
+	DXTBlockDecoder::decodeBlockRows(job->format, job->src, job->width, job->height,
+		job->dst, job->dstStride, job->channels, first, first + job->blockRowsPerTask);
+}
+
+void DXTBlockDecoder::decode(DXTTextureFormat format, const unsigned char * src, int width, int height,
+	unsigned char * dst, size_t dstStride, int channels, DXTThreadPool * pool) {
+
+	int blocksHigh = (height + 3) / 4;
+	if (!pool || pool->getNumThreads() == 0 || blocksHigh < 2) {
+		decodeBlockRows(format, src, width, height, dst, dstStride, channels, 0, blocksHigh);
+		return;
+	}
+
+	// a few tasks per thread, so the ones that got delayed don't hold up the frame
+	int tasks = (pool->getNumThreads() + 1) * 4;
+	DXTDecodeJob job;
+	job.format = format;
+	job.src = src;
+	job.width = width;
+	job.height = height;
+	job.dst = dst;
+	job.dstStride = dstStride;
+	job.channels = channels;
+	job.blockRowsPerTask = (blocksHigh + tasks - 1) / tasks;
+
+	DXTTaskGroup group;
+	for (int i = 0; i * job.blockRowsPerTask < blocksHigh; i++) {
+		pool->submit(group, decodeTask, &job, i);
+	}
+	pool->wait(group);
+}
@@ -0,0 +1,45 @@
+// DXTBlockDecoder - decompresses DXT frames to plain RGB/RGBA pixels on the CPU
+//
+// Portable. Decodes BC1 (DXT1), BC3 (DXT5) and YCoCg-DXT5 with scalar, SSE2 or AVX2 code,
+// picked at runtime from what the CPU supports. Whole frames are split into rows of blocks
+// that are decoded in parallel on a DXTThreadPool. YCoCg is converted to RGB with the player
+// shader's math in fixed point, while each block is decoded, so no YCoCg frame is ever stored.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DXTShared.h"
+
+class DXTThreadPool;
+
+enum DXTInstructionSet {
+	DXTInstructionSet_Scalar = 0,
+	DXTInstructionSet_SSE2,
+	DXTInstructionSet_AVX2
+};
+
+class DXTBlockDecoder {
+
+public:
+
+	// best instruction set this CPU and OS support
+	static DXTInstructionSet getSupportedInstructionSet();
+	// the one in use, defaults to the supported one, can be lowered e.g. for comparisons
+	static DXTInstructionSet getInstructionSet();
+	static void setInstructionSet(DXTInstructionSet instructionSet);
+	static const char * getInstructionSetName(DXTInstructionSet instructionSet);
+
+	// channels of the decoded pixels, 4 for DXT5, 3 for DXT1 and YCoCg (alpha is always opaque)
+	static int getChannels(DXTTextureFormat format);
+
+	// decodes a whole frame to dst (dstStride bytes per row, channels 3 or 4), block rows spread
+	// across the pool, NULL = the calling thread only
+	static void decode(DXTTextureFormat format, const unsigned char * src, int width, int height,
+		unsigned char * dst, size_t dstStride, int channels, DXTThreadPool * pool);
+
+	// decodes block rows [firstBlockRow, endBlockRow) on the calling thread
+	static void decodeBlockRows(DXTTextureFormat format, const unsigned char * src, int width, int height,
+		unsigned char * dst, size_t dstStride, int channels, int firstBlockRow, int endBlockRow);
+};
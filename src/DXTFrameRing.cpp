@@ -0,0 +1,313 @@
+#include "DXTFrameRing.h"
+
+DXTFrameRing::DXTFrameRing() {
+	m_slots = NULL;
+	m_numSlots = 0;
+	m_slotSize = 0;
+	m_ownsSlotData = false;
+	m_releaseProc = NULL;
+	m_leasesOutstanding.store(0, std::memory_order_relaxed);
+	reset();
+}
+
+DXTFrameRing::~DXTFrameRing() {
+	deallocate();
+}
+
+bool DXTFrameRing::allocate(int numSlots, long slotSize) {
+	deallocate();
+
+	// we need at least one slot for each side plus one in flight
+	if (numSlots < 3 || slotSize <= 0) return false;
+
+	m_slots = new Slot[numSlots];
+	m_numSlots = numSlots;
+	m_slotSize = slotSize;
+	m_ownsSlotData = true;
+
+	for (int i = 0; i < m_numSlots; i++) {
+		m_slots[i].frame.data = new unsigned char[slotSize];
+		m_slots[i].frame.capacity = slotSize;
+		m_slots[i].frame.lease = NULL;
+	}
+
+	reset();
+	return true;
+}
+
+bool DXTFrameRing::allocateExternal(int numSlots, long slotSize, unsigned char ** slotData) {
+	deallocate();
+
+	if (numSlots < 3 || slotSize <= 0 || !slotData) return false;
+
+	m_slots = new Slot[numSlots];
+	m_numSlots = numSlots;
+	m_slotSize = slotSize;
+
+	for (int i = 0; i < m_numSlots; i++) {
+		m_slots[i].frame.data = slotData[i];
+		m_slots[i].frame.capacity = slotSize;
+		m_slots[i].frame.lease = NULL;
+	}
+
+	reset();
+	return true;
+}
+
+bool DXTFrameRing::allocateLeased(int numSlots, DXTLeaseReleaseProc releaseProc) {
+	deallocate();
+
+	if (numSlots < 3 || !releaseProc) return false;
+
+	m_slots = new Slot[numSlots];
+	m_numSlots = numSlots;
+	m_releaseProc = releaseProc;
+
+	for (int i = 0; i < m_numSlots; i++) {
+		m_slots[i].frame.data = NULL;
+		m_slots[i].frame.capacity = 0;
+		m_slots[i].frame.lease = NULL;
+	}
+
+	reset();
+	return true;
+}
+
+void DXTFrameRing::deallocate() {
+	// hand back whatever is still leased, including slots the consumer forgot to release
+	for (int i = 0; i < m_numSlots; i++) {
+		releaseLease(&m_slots[i]);
+	}
+
+	if (m_slots) {
+		if (m_ownsSlotData) {
+			for (int i = 0; i < m_numSlots; i++) {
+				delete[] m_slots[i].frame.data;
+			}
+		}
+		delete[] m_slots;
+		m_slots = NULL;
+	}
+	m_numSlots = 0;
+	m_slotSize = 0;
+	m_ownsSlotData = false;
+	m_releaseProc = NULL;
+	reset();
+}
+
+void DXTFrameRing::reset() {
+	for (int i = 0; i < m_numSlots; i++) {
+		releaseLease(&m_slots[i]);
+		m_slots[i].state.store(SlotFree, std::memory_order_relaxed);
+		m_slots[i].sequence.store(0, std::memory_order_relaxed);
+		m_slots[i].startTime.store(0, std::memory_order_relaxed);
+		m_slots[i].frame.size = 0;
+		m_slots[i].frame.sequence = 0;
+		m_slots[i].frame.startTime = 0;
+		m_slots[i].frame.stopTime = 0;
+		m_slots[i].frame.frameIndex = -1;
+	}
+	m_writeSequence = 0;
+	m_readSequence = 0;
+	m_latestSequence.store(0, std::memory_order_relaxed);
+	m_framesWritten.store(0, std::memory_order_relaxed);
+	m_framesRead.store(0, std::memory_order_relaxed);
+	m_framesDropped.store(0, std::memory_order_relaxed);
+	m_framesRejected.store(0, std::memory_order_release);
+}
+
+// only call while the slot is owned exclusively (writing/reading) or the ring is idle
+void DXTFrameRing::releaseLease(Slot * slot) {
+	void * lease = slot->frame.lease;
+	if (!lease) return;
+
+	slot->frame.lease = NULL;
+	slot->frame.data = NULL;
+	slot->frame.size = 0;
+	m_leasesOutstanding.fetch_sub(1, std::memory_order_relaxed);
+	m_releaseProc(lease);
+}
+
+DXTFrameRing::Slot * DXTFrameRing::slotFor(const DXTFrame * frame) {
+	// map a frame handed out by beginWrite/acquireLatest back to its slot
+	for (int i = 0; i < m_numSlots; i++) {
+		if (&m_slots[i].frame == frame) return &m_slots[i];
+	}
+	return NULL;
+}
+
+DXTFrame * DXTFrameRing::beginWrite() {
+	for (int attempt = 0; attempt < m_numSlots; attempt++) {
+
+		// prefer a slot nobody has looked at yet
+		for (int i = 0; i < m_numSlots; i++) {
+			int expected = SlotFree;
+			if (m_slots[i].state.compare_exchange_strong(expected, SlotWriting, std::memory_order_acquire)) {
+				return &m_slots[i].frame;
+			}
+		}
+
+		// otherwise recycle the oldest frame the consumer did not pick up
+		Slot * oldest = NULL;
+		uint64_t oldestSequence = UINT64_MAX;
+		for (int i = 0; i < m_numSlots; i++) {
+			if (m_slots[i].state.load(std::memory_order_acquire) == SlotReady) {
+				uint64_t sequence = m_slots[i].sequence.load(std::memory_order_relaxed);
+				if (sequence < oldestSequence) {
+					oldestSequence = sequence;
+					oldest = &m_slots[i];
+				}
+			}
+		}
+		if (!oldest) break;
+
+		int expected = SlotReady;
+		if (oldest->state.compare_exchange_strong(expected, SlotWriting, std::memory_order_acquire)) {
+			m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+			releaseLease(oldest);
+			return &oldest->frame;
+		}
+		// the consumer grabbed it in the meantime, try again
+	}
+
+	m_framesRejected.fetch_add(1, std::memory_order_relaxed);
+	return NULL;
+}
+
+void DXTFrameRing::commitWrite(DXTFrame * frame) {
+	Slot * slot = slotFor(frame);
+	if (!slot) return;
+
+	uint64_t sequence = ++m_writeSequence;
+	frame->sequence = sequence;
+	slot->sequence.store(sequence, std::memory_order_relaxed);
+	slot->startTime.store(frame->startTime, std::memory_order_relaxed);
+	slot->state.store(SlotReady, std::memory_order_release);
+
+	m_latestSequence.store(sequence, std::memory_order_release);
+	m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DXTFrameRing::commitLease(DXTFrame * frame, unsigned char * data, long size, void * lease) {
+	Slot * slot = slotFor(frame);
+	if (!slot) return;
+
+	frame->data = data;
+	frame->size = size;
+	frame->lease = lease;
+	m_leasesOutstanding.fetch_add(1, std::memory_order_relaxed);
+
+	commitWrite(frame);
+}
+
+void DXTFrameRing::cancelWrite(DXTFrame * frame) {
+	Slot * slot = slotFor(frame);
+	if (!slot) return;
+
+	releaseLease(slot);
+	slot->sequence.store(0, std::memory_order_relaxed);
+	frame->sequence = 0;
+	slot->state.store(SlotFree, std::memory_order_release);
+}
+
+const DXTFrame * DXTFrameRing::acquireLatest() {
+	for (;;) {
+		Slot * newest = NULL;
+		uint64_t newestSequence = m_readSequence;
+		for (int i = 0; i < m_numSlots; i++) {
+			if (m_slots[i].state.load(std::memory_order_acquire) == SlotReady) {
+				uint64_t sequence = m_slots[i].sequence.load(std::memory_order_relaxed);
+				if (sequence > newestSequence) {
+					newestSequence = sequence;
+					newest = &m_slots[i];
+				}
+			}
+		}
+		if (!newest) return NULL;
+
+		int expected = SlotReady;
+		if (!newest->state.compare_exchange_strong(expected, SlotReading, std::memory_order_acq_rel)) {
+			// the producer recycled it, rescan
+			continue;
+		}
+
+		// the slot may have been republished in between, which only makes it newer
+		return claim(newest);
+	}
+}
+
+const DXTFrame * DXTFrameRing::acquireAt(int64_t time, int64_t * nextStartTime) {
+	for (;;) {
+		Slot * due = NULL;
+		int64_t dueStartTime = INT64_MIN;
+		int64_t earliestStartTime = INT64_MAX;
+		for (int i = 0; i < m_numSlots; i++) {
+			if (m_slots[i].state.load(std::memory_order_acquire) == SlotReady &&
+				m_slots[i].sequence.load(std::memory_order_relaxed) > m_readSequence) {
+				int64_t startTime = m_slots[i].startTime.load(std::memory_order_relaxed);
+				if (startTime <= time && startTime >= dueStartTime) {
+					dueStartTime = startTime;
+					due = &m_slots[i];
+				}
+				if (startTime < earliestStartTime) earliestStartTime = startTime;
+			}
+		}
+		if (!due) {
+			if (nextStartTime) *nextStartTime = earliestStartTime;
+			return NULL;
+		}
+
+		int expected = SlotReady;
+		if (!due->state.compare_exchange_strong(expected, SlotReading, std::memory_order_acq_rel)) {
+			continue;
+		}
+
+		// recycled and republished in between, put it back and look again
+		if (due->frame.startTime > time) {
+			due->state.store(SlotReady, std::memory_order_release);
+			continue;
+		}
+
+		if (nextStartTime) *nextStartTime = earliestStartTime;
+		return claim(due);
+	}
+}
+
+// consumer side, slot is already in SlotReading
+const DXTFrame * DXTFrameRing::claim(Slot * slot) {
+	m_readSequence = slot->frame.sequence;
+
+	// anything published before what we just took will never be shown
+	for (int i = 0; i < m_numSlots; i++) {
+		if (m_slots[i].state.load(std::memory_order_acquire) == SlotReady &&
+			m_slots[i].sequence.load(std::memory_order_relaxed) < m_readSequence) {
+			// claim it first, a lease must be handed back before the producer can reuse the slot
+			int ready = SlotReady;
+			if (m_slots[i].state.compare_exchange_strong(ready, SlotReading, std::memory_order_acq_rel)) {
+				releaseLease(&m_slots[i]);
+				m_slots[i].state.store(SlotFree, std::memory_order_release);
+				m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	m_framesRead.fetch_add(1, std::memory_order_relaxed);
+	return &slot->frame;
+}
+
+void DXTFrameRing::release(const DXTFrame * frame) {
+	Slot * slot = slotFor(frame);
+	if (!slot) return;
+	releaseLease(slot);
+	slot->state.store(SlotFree, std::memory_order_release);
+}
+
+DXTFrameRingStats DXTFrameRing::getStats() const {
+	DXTFrameRingStats stats;
+	stats.framesWritten = m_framesWritten.load(std::memory_order_relaxed);
+	stats.framesRead = m_framesRead.load(std::memory_order_relaxed);
+	stats.framesDropped = m_framesDropped.load(std::memory_order_relaxed);
+	stats.framesRejected = m_framesRejected.load(std::memory_order_relaxed);
+	stats.leasesOutstanding = m_leasesOutstanding.load(std::memory_order_relaxed);
+	return stats;
+}
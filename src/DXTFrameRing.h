@@ -0,0 +1,116 @@
+// DXTFrameRing - lock-free single-producer/single-consumer ring of pre-allocated frame slots
+//
+// The producer (DirectShow streaming thread) fills a free slot and publishes it,
+// the consumer (render thread) acquires the newest published slot and releases it
+// when done. Neither side ever blocks the other: if the consumer falls behind, the
+// producer recycles the oldest unread slot (latest frame wins).
+//
+// Slots either own a pre-allocated buffer the producer copies into, or lease a
+// buffer owned by someone else (e.g. an AddRef'ed IMediaSample). A lease is handed
+// back through the release callback as soon as its slot becomes free again.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+struct DXTFrame {
+	unsigned char * data;	// payload (compressed DXT texture)
+	long capacity;			// bytes available at data, 0 for leased slots
+	long size;				// bytes of valid payload
+	uint64_t sequence;		// increasing per published frame, 0 = never written
+	void * lease;			// owner of data for leased slots, NULL otherwise
+	int64_t startTime;		// presentation start in 100 ns units (REFERENCE_TIME)
+	int64_t stopTime;		// presentation end in 100 ns units
+	int64_t frameIndex;		// frame number within the media, -1 if unknown
+};
+
+typedef void (*DXTLeaseReleaseProc)(void * lease);
+
+struct DXTFrameRingStats {
+	uint64_t framesWritten;		// published by the producer
+	uint64_t framesRead;		// acquired by the consumer
+	uint64_t framesDropped;		// published but never acquired
+	uint64_t framesRejected;	// producer found no slot to write to
+	uint64_t leasesOutstanding;	// leases currently held by the ring
+};
+
+class DXTFrameRing {
+
+public:
+
+	DXTFrameRing();
+	~DXTFrameRing();
+
+	// not thread safe, only call while no producer/consumer is active
+	bool allocate(int numSlots, long slotSize);
+	bool allocateLeased(int numSlots, DXTLeaseReleaseProc releaseProc);
+	bool allocateExternal(int numSlots, long slotSize, unsigned char ** slotData); // storage stays owned by the caller
+	void deallocate();
+	void reset();
+
+	int getNumSlots() const { return m_numSlots; }
+	long getSlotSize() const { return m_slotSize; }
+	bool isLeased() const { return m_releaseProc != NULL; }
+
+	// producer side
+	DXTFrame * beginWrite();
+	void commitWrite(DXTFrame * frame);
+	void commitLease(DXTFrame * frame, unsigned char * data, long size, void * lease);
+	void cancelWrite(DXTFrame * frame);
+
+	// consumer side, returns NULL if nothing newer than the last acquired frame was published
+	const DXTFrame * acquireLatest();
+
+	// consumer side, returns the newest unread frame whose presentation started at or before time,
+	// older unread frames are dropped, later ones stay buffered. If none is due yet, returns NULL
+	// and sets nextStartTime to the earliest buffered start time (INT64_MAX if nothing is buffered).
+	const DXTFrame * acquireAt(int64_t time, int64_t * nextStartTime = NULL);
+
+	void release(const DXTFrame * frame);
+
+	// sequence of the newest published frame, 0 if none
+	uint64_t getLatestSequence() const { return m_latestSequence.load(std::memory_order_acquire); }
+
+	DXTFrameRingStats getStats() const;
+
+private:
+
+	enum SlotState {
+		SlotFree = 0,
+		SlotWriting,
+		SlotReady,
+		SlotReading
+	};
+
+	struct Slot {
+		std::atomic<int> state;
+		std::atomic<uint64_t> sequence;
+		std::atomic<int64_t> startTime;		// copy of frame.startTime the consumer may scan
+		DXTFrame frame;
+	};
+
+	Slot * slotFor(const DXTFrame * frame);
+	void releaseLease(Slot * slot);
+	const DXTFrame * claim(Slot * slot);
+
+	Slot * m_slots;
+	int m_numSlots;
+	long m_slotSize;
+	bool m_ownsSlotData;
+	DXTLeaseReleaseProc m_releaseProc;
+
+	uint64_t m_writeSequence;		// producer only
+	uint64_t m_readSequence;		// consumer only
+	std::atomic<uint64_t> m_latestSequence;
+
+	std::atomic<uint64_t> m_framesWritten;
+	std::atomic<uint64_t> m_framesRead;
+	std::atomic<uint64_t> m_framesDropped;
+	std::atomic<uint64_t> m_framesRejected;
+	std::atomic<uint64_t> m_leasesOutstanding;
+
+	DXTFrameRing(const DXTFrameRing &);
+	DXTFrameRing & operator=(const DXTFrameRing &);
+};
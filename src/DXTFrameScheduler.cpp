@@ -0,0 +1,75 @@
+#include "DXTFrameScheduler.h"
+
+#include <math.h>
+#include <string.h>
+
+// buffered frames this far ahead of the display time mean the clock and the stream disagree
+// (e.g. right after a seek), waiting for them would freeze the picture
+#define MAX_SCHEDULE_AHEAD 10000000LL	// 1 s in 100 ns units
+
+DXTFrameScheduler::DXTFrameScheduler() {
+	reset();
+}
+
+void DXTFrameScheduler::reset() {
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_lastFrameIndex = -1;
+	m_refreshesOnScreen = 0;
+	m_cadenceM2 = 0.0;
+}
+
+const DXTFrame * DXTFrameScheduler::selectFrame(DXTFrameRing & ring, int64_t displayTime) {
+	m_stats.refreshes++;
+
+	int64_t nextStartTime = INT64_MAX;
+	const DXTFrame * frame = ring.acquireAt(displayTime, &nextStartTime);
+
+	if (!frame && nextStartTime != INT64_MAX && nextStartTime - displayTime > MAX_SCHEDULE_AHEAD) {
+		m_stats.timelineResets++;
+		frame = ring.acquireLatest();
+	}
+
+	return account(frame);
+}
+
+const DXTFrame * DXTFrameScheduler::selectLatest(DXTFrameRing & ring) {
+	m_stats.refreshes++;
+
+	const DXTFrame * frame = ring.acquireLatest();
+	return account(frame);
+}
+
+const DXTFrame * DXTFrameScheduler::account(const DXTFrame * frame) {
+	if (frame) {
+		frameShown(frame);
+	}
+	else if (m_stats.framesShown == 0) {
+		m_stats.refreshesWithoutFrame++;
+	}
+	else {
+		m_refreshesOnScreen++;
+	}
+	return frame;
+}
+
+void DXTFrameScheduler::frameShown(const DXTFrame * frame) {
+
+	// close the cadence of the frame that was up until now
+	if (m_refreshesOnScreen > 0) {
+		m_stats.lastCadence = m_refreshesOnScreen;
+
+		uint64_t n = m_stats.framesShown;
+		double delta = m_refreshesOnScreen - m_stats.averageCadence;
+		m_stats.averageCadence += delta / n;
+		m_cadenceM2 += delta * (m_refreshesOnScreen - m_stats.averageCadence);
+		m_stats.judder = n > 1 ? sqrt(m_cadenceM2 / (n - 1)) : 0.0;
+	}
+
+	if (m_lastFrameIndex >= 0 && frame->frameIndex > m_lastFrameIndex + 1) {
+		m_stats.framesSkipped += frame->frameIndex - m_lastFrameIndex - 1;
+	}
+
+	m_stats.framesShown++;
+	m_lastFrameIndex = frame->frameIndex;
+	m_refreshesOnScreen = 1;
+}
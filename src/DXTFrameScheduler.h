@@ -0,0 +1,49 @@
+// DXTFrameScheduler - picks the buffered frame whose presentation interval covers a display time
+//
+// Called once per display refresh on the render thread. Frames decoded ahead wait in the
+// DXTFrameRing until their start time is reached, so e.g. 24p content on a 60 Hz output is
+// shown with a steady 2:3 cadence instead of whenever DirectShow happened to deliver.
+
+#pragma once
+
+#include <stdint.h>
+#include "DXTFrameRing.h"
+
+struct DXTSchedulerStats {
+	uint64_t refreshes;			// calls to selectFrame
+	uint64_t framesShown;		// distinct frames put on screen
+	uint64_t framesSkipped;		// frame indices jumped over between two shown frames
+	uint64_t refreshesWithoutFrame;	// nothing due and nothing shown yet
+	uint64_t timelineResets;	// buffered frames did not match the clock, fell back to the newest
+	int lastCadence;			// refreshes the previous frame stayed on screen
+	double averageCadence;		// mean refreshes per frame
+	double judder;				// standard deviation of refreshes per frame, 0 = perfectly even pacing
+};
+
+class DXTFrameScheduler {
+
+public:
+
+	DXTFrameScheduler();
+
+	void reset();
+
+	// returns the frame that should be on screen at displayTime (100 ns units, media time),
+	// or NULL if the previously selected frame should stay up
+	const DXTFrame * selectFrame(DXTFrameRing & ring, int64_t displayTime);
+
+	// no usable clock, show whatever is newest but keep the statistics going
+	const DXTFrame * selectLatest(DXTFrameRing & ring);
+
+	DXTSchedulerStats getStats() const { return m_stats; }
+
+private:
+
+	const DXTFrame * account(const DXTFrame * frame);
+	void frameShown(const DXTFrame * frame);
+
+	DXTSchedulerStats m_stats;
+	int64_t m_lastFrameIndex;
+	int m_refreshesOnScreen;
+	double m_cadenceM2;			// running sum of squared deviations (Welford)
+};
@@ -0,0 +1,125 @@
+#include "DXTPboUploader.h"
+#include "DirectShowDXTVideo.h"
+
+// keep slots aligned for the driver's DMA engine
+#define PBO_SLOT_ALIGNMENT 256
+
+DXTPboUploader::DXTPboUploader() {
+	m_buffer = 0;
+	m_mapped = NULL;
+	m_slotSize = 0;
+	m_bReadable = false;
+}
+
+DXTPboUploader::~DXTPboUploader() {
+	// the player has to call clear() while it is still alive, here we only free GL resources
+	clear(NULL);
+}
+
+bool DXTPboUploader::isSupported() {
+	return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && glBufferStorage != NULL;
+}
+
+bool DXTPboUploader::setup(int numSlots, long slotSize, bool bReadable) {
+	clear(NULL);
+
+	if (!isSupported() || numSlots <= 0 || slotSize <= 0) return false;
+
+	m_slotSize = (slotSize + PBO_SLOT_ALIGNMENT - 1) / PBO_SLOT_ALIGNMENT * PBO_SLOT_ALIGNMENT;
+	GLsizeiptr bufferSize = (GLsizeiptr)m_slotSize * numSlots;
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	// reads from uncached video memory crawl, a readable buffer stays in system memory
+	if (bReadable) flags |= GL_MAP_READ_BIT;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, bReadable ? flags | GL_CLIENT_STORAGE_BIT : flags);
+	m_mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!m_mapped) {
+		ofLogWarning("DXTPboUploader") << "Failed to map pixel buffer, falling back to client memory uploads";
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		return false;
+	}
+
+	m_bReadable = bReadable;
+	m_slotData.resize(numSlots);
+	m_fences.assign(numSlots, (GLsync)0);
+	for (int i = 0; i < numSlots; i++) {
+		m_slotData[i] = m_mapped + (size_t)i * m_slotSize;
+	}
+	return true;
+}
+
+void DXTPboUploader::clear(DirectShowDXTVideo * player) {
+	for (size_t i = 0; i < m_fences.size(); i++) {
+		if (m_fences[i]) {
+			glClientWaitSync(m_fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(m_fences[i]);
+		}
+	}
+	if (player) {
+		for (size_t i = 0; i < m_retired.size(); i++) {
+			player->releaseFrame(m_retired[i]);
+		}
+	}
+	m_retired.clear();
+	m_fences.clear();
+	m_slotData.clear();
+
+	if (m_buffer) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_mapped = NULL;
+	m_slotSize = 0;
+	m_bReadable = false;
+}
+
+int DXTPboUploader::slotIndex(const DXTFrame * frame) const {
+	if (!m_mapped || !frame || frame->data < m_mapped) return -1;
+	size_t index = (frame->data - m_mapped) / m_slotSize;
+	return index < m_slotData.size() ? (int)index : -1;
+}
+
+bool DXTPboUploader::upload(const DXTFrame * frame, GLsizei width, GLsizei height, GLenum internalFormat, GLsizei compressedSize) {
+	int slot = slotIndex(frame);
+	if (slot < 0) return false;
+
+	// data pointer becomes an offset into the bound buffer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+	glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, internalFormat, compressedSize,
+		(const GLvoid *)((size_t)slot * m_slotSize));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (m_fences[slot]) glDeleteSync(m_fences[slot]);
+	m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return true;
+}
+
+void DXTPboUploader::retire(const DXTFrame * frame) {
+	if (frame) m_retired.push_back(frame);
+}
+
+void DXTPboUploader::collect(DirectShowDXTVideo * player) {
+	for (size_t i = 0; i < m_retired.size();) {
+		int slot = slotIndex(m_retired[i]);
+		GLsync fence = slot >= 0 ? m_fences[slot] : 0;
+		if (fence) {
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+				i++;
+				continue;
+			}
+			glDeleteSync(fence);
+			m_fences[slot] = 0;
+		}
+		player->releaseFrame(m_retired[i]);
+		m_retired.erase(m_retired.begin() + i);
+	}
+}
@@ -0,0 +1,54 @@
+// DXTPboUploader - persistently mapped pixel buffer ring for compressed texture uploads
+//
+// One GL_PIXEL_UNPACK_BUFFER is split into slots that back the player's frame ring, so the
+// streaming thread writes the DXT payload straight into GPU visible memory. The render thread
+// only issues the upload from the bound buffer. A slot handed back after an upload is kept
+// until the GPU has signaled the fence of its last upload, only then the producer may reuse it.
+// The mapping is write only unless set up readable, then the CPU may decode the frames too.
+// Requires GL 4.4 or GL_ARB_buffer_storage, isSupported() tells whether the path is available.
+
+#pragma once
+
+#include "ofMain.h"
+
+struct DXTFrame;
+class DirectShowDXTVideo;
+
+class DXTPboUploader {
+
+public:
+
+	DXTPboUploader();
+	~DXTPboUploader();
+
+	static bool isSupported();
+
+	// creates and maps the buffer, call on the GL thread
+	bool setup(int numSlots, long slotSize, bool bReadable = false);
+	// waits for pending uploads, hands their frames back and deletes the buffer
+	void clear(DirectShowDXTVideo * player);
+
+	bool isAllocated() const { return m_buffer != 0; }
+	bool isReadable() const { return m_bReadable; }
+	unsigned char ** getSlotData() { return m_slotData.data(); }
+
+	// upload a frame that lives in one of our slots to the currently bound GL_TEXTURE_2D
+	bool upload(const DXTFrame * frame, GLsizei width, GLsizei height, GLenum internalFormat, GLsizei compressedSize);
+
+	// hand a frame back once the GPU is done with it
+	void retire(const DXTFrame * frame);
+	// releases retired frames whose uploads have completed, call once per update
+	void collect(DirectShowDXTVideo * player);
+
+private:
+
+	int slotIndex(const DXTFrame * frame) const;
+
+	GLuint m_buffer;
+	unsigned char * m_mapped;
+	long m_slotSize;
+	bool m_bReadable;
+	vector<unsigned char *> m_slotData;
+	vector<GLsync> m_fences;					// last upload per slot
+	vector<const DXTFrame *> m_retired;		// waiting for their fence
+};
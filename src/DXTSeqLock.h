@@ -0,0 +1,81 @@
+// DXTSeqLock - a small value that any thread reads without locking while others update it
+//
+// Portable. A writer makes the sequence odd, stores the value and makes it even again. A reader
+// copies the value between two reads of the sequence and retries if it changed or was odd, so
+// readers never block writers or each other. The value is kept as relaxed atomic words, which
+// keeps the copying race free by the language rules. Writers are serialized by a mutex, modify()
+// changes some fields while keeping the ones other writers own. T must be trivially copyable.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+template <class T>
+class DXTSeqLock {
+
+public:
+
+	DXTSeqLock() : m_sequence(0) {
+		memset(&m_value, 0, sizeof(m_value));
+		for (size_t i = 0; i < NUM_WORDS; i++) m_words[i].store(0, std::memory_order_relaxed);
+	}
+
+	T load() const {
+		uint64_t words[NUM_WORDS];
+		for (;;) {
+			uint32_t before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (size_t i = 0; i < NUM_WORDS; i++) words[i] = m_words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequence.load(std::memory_order_relaxed) == before) break;
+		}
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+	void store(const T & value) {
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		m_value = value;
+		publish();
+	}
+
+	// f(T &) on the latest value, under the writer lock
+	template <class F>
+	void modify(F f) {
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		f(m_value);
+		publish();
+	}
+
+private:
+
+	static const size_t NUM_WORDS = (sizeof(T) + 7) / 8;
+
+	DXTSeqLock(const DXTSeqLock &);
+	DXTSeqLock & operator=(const DXTSeqLock &);
+
+	void publish() {
+		uint64_t words[NUM_WORDS];
+		words[NUM_WORDS - 1] = 0;
+		memcpy(words, &m_value, sizeof(T));
+
+		uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < NUM_WORDS; i++) m_words[i].store(words[i], std::memory_order_relaxed);
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	std::atomic<uint32_t> m_sequence;
+	std::atomic<uint64_t> m_words[NUM_WORDS];
+	std::mutex m_writeMutex;
+	T m_value;		// the writers' copy
+};
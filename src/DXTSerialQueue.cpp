@@ -0,0 +1,42 @@
+#include "DXTSerialQueue.h"
+
+DXTSerialQueue::DXTSerialQueue() {
+	m_bStopping = false;
+	m_thread = std::thread(&DXTSerialQueue::threadLoop, this);
+}
+
+DXTSerialQueue::~DXTSerialQueue() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+void DXTSerialQueue::post(const std::function<void()> & job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_wake.notify_one();
+}
+
+int DXTSerialQueue::getPending() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)m_jobs.size();
+}
+
+void DXTSerialQueue::threadLoop() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_bStopping || !m_jobs.empty(); });
+			if (m_jobs.empty()) return;
+			job.swap(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
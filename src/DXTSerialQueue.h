@@ -0,0 +1,39 @@
+// DXTSerialQueue - one background thread running jobs in the order they were posted
+//
+// Portable (std::thread). For slow work that must stay off the render thread but shouldn't
+// occupy the decode workers, e.g. building filter graphs. Jobs posted while the queue is being
+// destroyed still run, the destructor waits for them.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class DXTSerialQueue {
+
+public:
+
+	DXTSerialQueue();
+	~DXTSerialQueue();
+
+	void post(const std::function<void()> & job);
+
+	// jobs posted and not started yet
+	int getPending();
+
+private:
+
+	DXTSerialQueue(const DXTSerialQueue &);
+	DXTSerialQueue & operator=(const DXTSerialQueue &);
+
+	void threadLoop();
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()> > m_jobs;
+	bool m_bStopping;
+	std::thread m_thread;
+};
@@ -5,3 +5,9 @@ enum DXTTextureFormat {
 	TextureFormat_RGBA_DXT5 = 0x83F3,
 	TextureFormat_YCoCg_DXT5 = 0x01
 };
+
+// bytes of one compressed frame, DXT1 stores a 4x4 block in 8 bytes, DXT5 in 16
+inline long DXTCompressedSize(DXTTextureFormat format, long width, long height) {
+	long blocks = ((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == TextureFormat_RGB_DXT1 ? 8 : 16);
+}
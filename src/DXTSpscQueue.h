@@ -0,0 +1,62 @@
+// DXTSpscQueue - lock-free bounded FIFO between one producer thread and one consumer thread
+//
+// Portable. The producer owns the tail, the consumer owns the head, each only reads the
+// other's index, so neither side ever waits. When the queue is full push() fails and
+// the item is counted as dropped instead of blocking the producer. CAPACITY must be a
+// power of two.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <class T, size_t CAPACITY>
+class DXTSpscQueue {
+
+public:
+
+	DXTSpscQueue() : m_head(0), m_tail(0), m_dropped(0) {}
+
+	// producer side
+	bool push(const T & item) {
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= CAPACITY) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		m_items[tail & (CAPACITY - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T & item) {
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return false;
+		item = m_items[head & (CAPACITY - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// any thread, a snapshot
+	size_t size() const {
+		return (size_t)(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+	}
+	uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "DXTSpscQueue capacity must be a power of two");
+
+	DXTSpscQueue(const DXTSpscQueue &);
+	DXTSpscQueue & operator=(const DXTSpscQueue &);
+
+	T m_items[CAPACITY];
+	// apart, so the producer and the consumer don't share a cache line
+	std::atomic<uint64_t> m_head;
+	char m_padHead[64 - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> m_tail;
+	char m_padTail[64 - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> m_dropped;
+};
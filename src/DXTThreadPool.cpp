@@ -0,0 +1,328 @@
+#include "DXTThreadPool.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// which pool and worker the current thread belongs to
+static thread_local DXTThreadPool * t_pool = NULL;
+static thread_local int t_worker = -1;
+
+static uint64_t nanosSince(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/////////////////////// DXTTaskClient //////////////////////////
+
+DXTTaskClient::DXTTaskClient(DXTTaskPriority priority)
+	: m_priority(priority), m_tasksSubmitted(0), m_tasksRun(0), m_runNanos(0), m_queueNanos(0) {
+}
+
+DXTTaskClientStats DXTTaskClient::getStats() const {
+	DXTTaskClientStats stats;
+	stats.tasksSubmitted = m_tasksSubmitted.load();
+	stats.tasksRun = m_tasksRun.load();
+	stats.runMicros = m_runNanos.load() / 1000.0;
+	stats.averageQueueMicros = stats.tasksRun > 0 ? m_queueNanos.load() / 1000.0 / stats.tasksRun : 0.0;
+	return stats;
+}
+
+void DXTTaskClient::resetStats() {
+	m_tasksSubmitted.store(0);
+	m_tasksRun.store(0);
+	m_runNanos.store(0);
+	m_queueNanos.store(0);
+}
+
+/////////////////////// DXTThreadPool //////////////////////////
+
+DXTThreadPool::DXTThreadPool()
+	: m_queued(0), m_numThreads(0), m_tasksRun(0), m_tasksStolen(0), m_busyNanos(0) {
+	m_bStopping = false;
+	m_affinityMask = 0;
+}
+
+DXTThreadPool::~DXTThreadPool() {
+	stop();
+}
+
+DXTThreadPool & DXTThreadPool::shared() {
+	static DXTThreadPool * pool = NULL;
+	static std::once_flag once;
+	std::call_once(once, [] {
+		// never destroyed, players may still wait on it while static destructors run
+		pool = new DXTThreadPool();
+		pool->start(-1);
+	});
+	return *pool;
+}
+
+int DXTThreadPool::getHardwareThreads() {
+	unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? (int)n : 1;
+}
+
+void DXTThreadPool::start(int numThreads, uint64_t affinityMask) {
+	std::lock_guard<std::mutex> config(m_configMutex);
+
+	if (numThreads < 0) numThreads = getHardwareThreads() - 1;
+	if (numThreads > DXT_MAX_WORKER_THREADS) numThreads = DXT_MAX_WORKER_THREADS;
+
+	// the old workers drain their queues before they exit
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_threads.size(); i++) {
+		m_threads[i].join();
+	}
+	m_threads.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = false;
+	}
+	m_affinityMask = affinityMask;
+	m_numThreads.store(numThreads);
+	for (int i = 0; i < numThreads; i++) {
+		m_threads.push_back(std::thread(&DXTThreadPool::workerLoop, this, i));
+	}
+}
+
+void DXTThreadPool::stop() {
+	start(0, m_affinityMask);
+}
+
+void DXTThreadPool::submit(DXTTaskGroup & group, DXTTaskProc proc, void * arg, int index) {
+	Task task;
+	task.proc = proc;
+	task.arg = arg;
+	task.index = index;
+	task.group = &group;
+	task.queued = std::chrono::steady_clock::now();
+
+	DXTTaskClient * client = group.m_client;
+	int priority = client ? client->m_priority.load() : DXTTaskPriority_Normal;
+	if (client) client->m_tasksSubmitted++;
+
+	// a worker keeps what it submits, everybody else goes through the shared queue
+	int worker = currentWorker();
+	TaskQueue & queue = worker >= 0 ? m_local[worker] : m_shared;
+
+	group.m_pending++;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks[priority].push_back(task);
+	}
+	queue.count++;
+	m_queued++;
+
+	// lock so a worker can't miss this between checking m_queued and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_wake.notify_one();
+}
+
+void DXTThreadPool::wait(DXTTaskGroup & group) {
+	int worker = currentWorker();
+	while (!group.isDone()) {
+		Task task;
+		if (takeFromGroup(worker, group, task)) {
+			run(task);
+			continue;
+		}
+
+		// the group's last tasks are running on other threads
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [&group] { return group.isDone(); });
+	}
+}
+
+int DXTThreadPool::currentWorker() const {
+	return t_pool == this ? t_worker : -1;
+}
+
+bool DXTThreadPool::popBack(TaskQueue & queue, int priority, Task & task) {
+	if (queue.count.load() <= 0) return false;
+
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks[priority].empty()) return false;
+	task = queue.tasks[priority].back();
+	queue.tasks[priority].pop_back();
+	queue.count--;
+	return true;
+}
+
+bool DXTThreadPool::popFront(TaskQueue & queue, int priority, Task & task) {
+	if (queue.count.load() <= 0) return false;
+
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks[priority].empty()) return false;
+	task = queue.tasks[priority].front();
+	queue.tasks[priority].pop_front();
+	queue.count--;
+	return true;
+}
+
+bool DXTThreadPool::take(int worker, Task & task) {
+	if (m_queued.load() == 0) return false;
+
+	// a higher priority anywhere beats a lower one in our own queue
+	int numQueues = DXT_MAX_WORKER_THREADS;
+	for (int priority = 0; priority < DXTTaskPriority_Count; priority++) {
+		bool found = false;
+		if (worker >= 0 && popBack(m_local[worker], priority, task)) {
+			found = true;
+		}
+		else if (popFront(m_shared, priority, task)) {
+			found = true;
+		}
+		else {
+			// steal the oldest task of another worker, the newest stay with it for locality.
+			// queues of workers that are gone are empty, except for tasks still running there
+			int first = worker >= 0 ? worker + 1 : 0;
+			for (int i = 0; i < numQueues && !found; i++) {
+				int victim = (first + i) % numQueues;
+				if (victim == worker) continue;
+				if (popFront(m_local[victim], priority, task)) {
+					m_tasksStolen++;
+					found = true;
+				}
+			}
+		}
+		if (found) {
+			m_queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool DXTThreadPool::popGroup(TaskQueue & queue, int priority, const DXTTaskGroup & group, bool bNewest, Task & task) {
+	if (queue.count.load() <= 0) return false;
+
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	std::deque<Task> & tasks = queue.tasks[priority];
+	for (size_t i = 0; i < tasks.size(); i++) {
+		size_t at = bNewest ? tasks.size() - 1 - i : i;
+		if (tasks[at].group != &group) continue;
+		task = tasks[at];
+		tasks.erase(tasks.begin() + at);
+		queue.count--;
+		return true;
+	}
+	return false;
+}
+
+bool DXTThreadPool::takeFromGroup(int worker, const DXTTaskGroup & group, Task & task) {
+	if (m_queued.load() == 0) return false;
+
+	// like take(), but only the group's own tasks
+	for (int priority = 0; priority < DXTTaskPriority_Count; priority++) {
+		bool found = false;
+		if (worker >= 0 && popGroup(m_local[worker], priority, group, true, task)) {
+			found = true;
+		}
+		else if (popGroup(m_shared, priority, group, false, task)) {
+			found = true;
+		}
+		else {
+			int first = worker >= 0 ? worker + 1 : 0;
+			for (int i = 0; i < DXT_MAX_WORKER_THREADS && !found; i++) {
+				int victim = (first + i) % DXT_MAX_WORKER_THREADS;
+				if (victim == worker) continue;
+				if (popGroup(m_local[victim], priority, group, false, task)) {
+					m_tasksStolen++;
+					found = true;
+				}
+			}
+		}
+		if (found) {
+			m_queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DXTThreadPool::run(const Task & task) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	task.proc(task.arg, task.index);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	uint64_t runNanos = nanosSince(start, end);
+	m_tasksRun++;
+	m_busyNanos += runNanos;
+
+	DXTTaskClient * client = task.group->m_client;
+	if (client) {
+		client->m_tasksRun++;
+		client->m_runNanos += runNanos;
+		client->m_queueNanos += nanosSince(task.queued, start);
+	}
+
+	// notify under the lock, so a waiter can't miss it between its check and its wait
+	if (task.group->m_pending.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done.notify_all();
+	}
+}
+
+void DXTThreadPool::workerLoop(int worker) {
+	t_pool = this;
+	t_worker = worker;
+	pinWorker(worker);
+
+	for (;;) {
+		Task task;
+		if (take(worker, task)) {
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_wake.wait(lock, [this] { return m_bStopping || m_queued.load() > 0; });
+		if (m_bStopping && m_queued.load() == 0) return;
+	}
+}
+
+void DXTThreadPool::pinWorker(int worker) {
+	if (m_affinityMask == 0) return;
+
+	// the worker-th set bit, wrapping around
+	int cores[64];
+	int numCores = 0;
+	for (int bit = 0; bit < 64; bit++) {
+		if (m_affinityMask & ((uint64_t)1 << bit)) cores[numCores++] = bit;
+	}
+	int core = cores[worker % numCores];
+
+#ifdef _WIN32
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+DXTThreadPoolStats DXTThreadPool::getStats() const {
+	DXTThreadPoolStats stats;
+	stats.threads = m_numThreads.load();
+	stats.tasksRun = m_tasksRun.load();
+	stats.tasksStolen = m_tasksStolen.load();
+	stats.busyMicros = m_busyNanos.load() / 1000.0;
+	return stats;
+}
+
+void DXTThreadPool::resetStats() {
+	m_tasksRun.store(0);
+	m_tasksStolen.store(0);
+	m_busyNanos.store(0);
+}
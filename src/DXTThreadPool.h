@@ -0,0 +1,168 @@
+// DXTThreadPool - work-stealing worker threads for decode work
+//
+// Portable (std::thread). Tasks are plain function pointers with an argument and an index,
+// grouped so a caller can wait for exactly the tasks it submitted. A waiting thread runs the
+// queued tasks of the group it waits for itself instead of sleeping, so a pool with 0 workers
+// degrades to serial work. It never runs other groups' tasks, a stream waiting for its frame's
+// chunks can't end up decoding another player's frame or reading another clip's file.
+//
+// Every worker has its own queues. Tasks a worker submits (e.g. the chunks of the frame it is
+// decoding) stay on its queues and run there while they are hot in its cache, idle workers
+// steal from the other end. Tasks from other threads go to a shared queue. Each group belongs
+// to a client (one per player), whose priority decides which queued task runs next and whose
+// statistics show how the workers' time was shared. shared() is the pool all players use, so
+// many streams don't oversubscribe the machine with a pool each.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define DXT_MAX_WORKER_THREADS 64
+
+typedef void (*DXTTaskProc)(void * arg, int index);
+
+enum DXTTaskPriority {
+	DXTTaskPriority_High = 0,	// e.g. streams on screen
+	DXTTaskPriority_Normal,
+	DXTTaskPriority_Low,		// e.g. streams preloading in the background
+	DXTTaskPriority_Count
+};
+
+struct DXTTaskClientStats {
+	uint64_t tasksSubmitted;
+	uint64_t tasksRun;
+	double runMicros;			// time the client's tasks ran, summed over all threads
+	double averageQueueMicros;	// time from submit until a thread picked the task up
+};
+
+// whoever submits work, e.g. one player
+class DXTTaskClient {
+
+public:
+
+	DXTTaskClient(DXTTaskPriority priority = DXTTaskPriority_Normal);
+
+	void setPriority(DXTTaskPriority priority) { m_priority.store(priority); }
+	DXTTaskPriority getPriority() const { return (DXTTaskPriority)m_priority.load(); }
+
+	DXTTaskClientStats getStats() const;
+	void resetStats();
+
+private:
+
+	friend class DXTThreadPool;
+
+	std::atomic<int> m_priority;
+	std::atomic<uint64_t> m_tasksSubmitted;
+	std::atomic<uint64_t> m_tasksRun;
+	std::atomic<uint64_t> m_runNanos;
+	std::atomic<uint64_t> m_queueNanos;
+};
+
+class DXTTaskGroup {
+
+public:
+
+	DXTTaskGroup(DXTTaskClient * client = NULL) : m_pending(0), m_client(client) {}
+
+	bool isDone() const { return m_pending.load() == 0; }
+
+	void setClient(DXTTaskClient * client) { m_client = client; }
+	DXTTaskClient * getClient() const { return m_client; }
+
+private:
+
+	friend class DXTThreadPool;
+
+	std::atomic<int> m_pending;
+	DXTTaskClient * m_client;
+};
+
+struct DXTThreadPoolStats {
+	int threads;
+	uint64_t tasksRun;
+	uint64_t tasksStolen;		// taken from another worker's queues
+	double busyMicros;			// time spent running tasks, summed over all threads
+};
+
+class DXTThreadPool {
+
+public:
+
+	DXTThreadPool();
+	~DXTThreadPool();
+
+	// the pool shared by all players, started with one worker per core besides the caller
+	static DXTThreadPool & shared();
+
+	// -1 = one worker per core besides the calling thread. affinityMask pins the workers
+	// round robin to the cores whose bits are set, 0 = let the OS schedule them.
+	// Safe while tasks are queued, they keep running on the new workers.
+	void start(int numThreads, uint64_t affinityMask = 0);
+	// runs what is queued and joins the workers, later tasks run on waiting threads
+	void stop();
+	int getNumThreads() const { return m_numThreads.load(); }
+	uint64_t getAffinityMask() const { return m_affinityMask; }
+
+	static int getHardwareThreads();
+
+	void submit(DXTTaskGroup & group, DXTTaskProc proc, void * arg, int index);
+
+	// runs the group's queued tasks until every task of the group has finished
+	void wait(DXTTaskGroup & group);
+
+	DXTThreadPoolStats getStats() const;
+	void resetStats();
+
+private:
+
+	struct Task {
+		DXTTaskProc proc;
+		void * arg;
+		int index;
+		DXTTaskGroup * group;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	struct TaskQueue {
+		TaskQueue() : count(0) {}
+		std::mutex mutex;
+		std::deque<Task> tasks[DXTTaskPriority_Count];
+		std::atomic<int> count;		// all priorities, checked before taking the lock
+	};
+
+	int currentWorker() const;
+	bool take(int worker, Task & task);
+	bool popBack(TaskQueue & queue, int priority, Task & task);
+	bool popFront(TaskQueue & queue, int priority, Task & task);
+	bool takeFromGroup(int worker, const DXTTaskGroup & group, Task & task);
+	bool popGroup(TaskQueue & queue, int priority, const DXTTaskGroup & group, bool bNewest, Task & task);
+	void run(const Task & task);
+	void workerLoop(int worker);
+	void pinWorker(int worker);
+
+	std::mutex m_configMutex;		// start/stop
+	std::mutex m_mutex;				// sleeping and waking
+	std::condition_variable m_wake;	// workers, something was queued
+	std::condition_variable m_done;	// waiters, a group finished
+	bool m_bStopping;
+
+	TaskQueue m_shared;
+	TaskQueue m_local[DXT_MAX_WORKER_THREADS];
+	std::atomic<int> m_queued;
+	std::atomic<int> m_numThreads;
+	std::vector<std::thread> m_threads;
+	uint64_t m_affinityMask;
+
+	std::atomic<uint64_t> m_tasksRun;
+	std::atomic<uint64_t> m_tasksStolen;
+	std::atomic<uint64_t> m_busyNanos;
+};
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <strsafe.h>
 #include <stdint.h>
+#include <chrono>
 
 #include "uids.h"
 #include <streams.h>
@@ -14,6 +15,16 @@
 #define SAFE_RELEASE(X) { if (X) X->Release(); X = NULL; }
 #define CHECK_SUCCESS(X) { if (!X) {tearDown();return false;} }
 
+// frames buffered between the streaming thread and the render thread
+#define FRAME_RING_SLOTS 4
+
+// the Hap source delivers a frame at least this often per measured refresh interval, so the
+// refreshes that come a little early still find a new frame
+#define REFRESH_INTERVAL_MARGIN 0.8
+
+// posted by setSpeed(), so rate changes reach the event thread in order with the graph's events
+#define EC_DXT_RATE_CHANGED (EC_USER + 1)
+
 static int comRefCount = 0;
 
 static void retainCom() {
@@ -30,23 +41,42 @@ static void releaseCom() {
 	}
 }
 
+// frame ring lease callback, hands an AddRef'ed sample back to its allocator
+static void releaseSampleLease(void * lease) {
+	((IMediaSample*)lease)->Release();
+}
+
+static uint64_t steadyMicros() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 DirectShowDXTVideo::DirectShowDXTVideo() {
 	retainCom();
+	bUseSampleLeasing = false;
+	bFrameScheduling = false;
+	decodePriority = DXTTaskPriority_Normal;
+	decodeAheadFrames = 1;
+	decodeAheadBudget = 0;
 	clearValues();
-	InitializeCriticalSection(&critSection);
 }
 
 DirectShowDXTVideo::~DirectShowDXTVideo() {
 	stop();
 	tearDown();
 	releaseCom();
-	DeleteCriticalSection(&critSection);
 }
 
 void DirectShowDXTVideo::tearDown() {
 
+	// no events are handled on an interface that's being released
+	stopEventThread();
+
 	//release interfaces
 	if (pControlInterface) pControlInterface->Stop();
+
+	// give leased samples back while their allocators are still around
+	frameRing.deallocate();
+
 	SAFE_RELEASE(pControlInterface);
 	SAFE_RELEASE(pEventInterface);
 	SAFE_RELEASE(pSeekInterface);
@@ -59,21 +89,17 @@ void DirectShowDXTVideo::tearDown() {
 	// release filters
 	if (pRawSampleGrabberFilter) pRawSampleGrabberFilter->SetCallback(NULL, 0);
 	SAFE_RELEASE(pRawSampleGrabberFilter);
+	SAFE_RELEASE(pHapSourceFilter);
 	SAFE_RELEASE(pLavSplitterSourceFilter);
 	SAFE_RELEASE(pHapDecoderFilter);
 	SAFE_RELEASE(pNullRendererFilter);
 	SAFE_RELEASE(pAudioRendererFilter);
 
-	if (rawBuffer) {
-		delete[] rawBuffer;
-		rawBuffer = NULL;
-	}
 	clearValues();
 }
 
 void DirectShowDXTVideo::clearValues() {
 	hr = 0;
-	rawBuffer = NULL;
 	timeFormat = TIME_FORMAT_MEDIA_TIME;
 	timeNow = 0;
 	lPositionInSecs = 0;
@@ -87,16 +113,30 @@ void DirectShowDXTVideo::clearValues() {
 	videoSize = 0;
 	bVideoOpened = false;
 	bLoop = true;
-	bPaused = false;
-	bPlaying = false;
-	bEndReached = false;
-	bNewPixels = false;
+	loopMode = HapLoopMode_Loop;
+	loopInFrame = 0;
+	loopOutFrame = -1;
 	bFrameNew = false;
-	curMovieFrame = -1;
-	frameCount = -1;
+	lastFrameIndex = -1;
+	lastFrameSequence = 0;
+	frameScheduler.reset();
 	lastBufferSize = 0;
-	movieRate = 1.0;
+	lastDisplayMicros = 0;
+	refreshInterval = 0.0;
+	sourceRefreshInterval = 0;
 	averageTimePerFrame = 1.0 / 30.0;
+	frameDuration = 333333;
+	graphRate = 1.0;
+
+	DXTPlaybackState state;
+	memset(&state, 0, sizeof(state));
+	state.rate = 1.0;
+	state.frameIndex = -1;
+	playbackState.store(state);
+
+	DXTGraphEventStats stats;
+	memset(&stats, 0, sizeof(stats));
+	graphEventStats.store(stats);
 }
 
 STDMETHODIMP DirectShowDXTVideo::QueryInterface(REFIID riid, void **ppvObject) {
@@ -104,26 +144,50 @@ STDMETHODIMP DirectShowDXTVideo::QueryInterface(REFIID riid, void **ppvObject) {
 	return S_OK;
 }
 
-STDMETHODIMP DirectShowDXTVideo::SampleCB(long Time, IMediaSample *pSample) {
+STDMETHODIMP DirectShowDXTVideo::SampleCB(double Time, IMediaSample *pSample) {
 
-	if (!rawBuffer) return E_OUTOFMEMORY;
+	if (frameRing.getNumSlots() == 0) return E_OUTOFMEMORY;
 
 	BYTE * ptrBuffer = NULL;
 	HRESULT hr = pSample->GetPointer(&ptrBuffer);
 	if (FAILED(hr)) return E_FAIL;
 
-	long latestBufferLength = pSample->GetActualDataLength();
-
-	EnterCriticalSection(&critSection);
-
-	memcpy(rawBuffer, ptrBuffer, latestBufferLength);
+	// full 64-bit media times, Time is only a convenience copy in seconds
+	REFERENCE_TIME startTime = 0;
+	REFERENCE_TIME stopTime = 0;
+	if (FAILED(pRawSampleGrabberFilter->GetMediaTime(pSample, &startTime, &stopTime))) {
+		startTime = (REFERENCE_TIME)(Time * 10000000.0);
+		stopTime = startTime;
+	}
+	if (stopTime <= startTime) stopTime = startTime + frameDuration;
+
+	// never blocks: if the render thread fell behind, the oldest unread frame is recycled
+	DXTFrame * frame = frameRing.beginWrite();
+	if (!frame) return S_OK;
+
+	frame->startTime = startTime;
+	frame->stopTime = stopTime;
+	frame->frameIndex = (startTime + frameDuration / 2) / frameDuration;
+
+	// the Hap source numbers its frames, the times of a looping one keep counting up
+	LONGLONG mediaStart = 0;
+	LONGLONG mediaStop = 0;
+	if (pSample->GetMediaTime(&mediaStart, &mediaStop) == S_OK) frame->frameIndex = mediaStart;
+
+	if (frameRing.isLeased()) {
+		// zero-copy: keep the sample alive until its slot is released
+		pSample->AddRef();
+		frameRing.commitLease(frame, ptrBuffer, pSample->GetActualDataLength(), pSample);
+		return S_OK;
+	}
 
-	bNewPixels = true;
+	long latestBufferLength = pSample->GetActualDataLength();
+	if (latestBufferLength > frame->capacity) latestBufferLength = frame->capacity;
 
-	//this is just so we know if there is a new frame
-	frameCount++;
+	memcpy(frame->data, ptrBuffer, latestBufferLength);
+	frame->size = latestBufferLength;
 
-	LeaveCriticalSection(&critSection);
+	frameRing.commitWrite(frame);
 
 	return S_OK;
 }
@@ -138,8 +202,15 @@ bool DirectShowDXTVideo::loadMovieManualGraph(string path) {
 	this->createFilterGraphManager(bSuccess);
 	CHECK_SUCCESS(bSuccess);
 
-	this->createLavSplitterSourceFilter(bSuccess);
-	CHECK_SUCCESS(bSuccess);
+	// our own source reads MOV, AVI and MKV files without audio, everything else goes through LAV
+	this->createHapSourceFilter(path, bSuccess);
+	bool bHapSource = bSuccess;
+	if (!bHapSource) {
+		bSuccess = true;
+		this->createLavSplitterSourceFilter(bSuccess);
+		CHECK_SUCCESS(bSuccess);
+	}
+	IBaseFilter * pSourceFilter = bHapSource ? (IBaseFilter*)this->pHapSourceFilter : this->pLavSplitterSourceFilter;
 
 	this->createHapDecoderFilter(bSuccess);
 	CHECK_SUCCESS(bSuccess);
@@ -165,10 +236,12 @@ bool DirectShowDXTVideo::loadMovieManualGraph(string path) {
 	this->queryEventInterface(bSuccess);
 	CHECK_SUCCESS(bSuccess);
 
-	this->queryFileSourceFilterInterface(bSuccess);
-	CHECK_SUCCESS(bSuccess);
+	if (!bHapSource) {
+		this->queryFileSourceFilterInterface(bSuccess);
+		CHECK_SUCCESS(bSuccess);
+	}
 
-	this->addFilter(this->pLavSplitterSourceFilter, L"LAVSplitterSource", bSuccess);
+	this->addFilter(pSourceFilter, bHapSource ? HAPSOURCE_FILTERNAME : L"LAVSplitterSource", bSuccess);
 	CHECK_SUCCESS(bSuccess);
 
 	this->addFilter(this->pHapDecoderFilter, L"HapDecoder", bSuccess);
@@ -180,18 +253,20 @@ bool DirectShowDXTVideo::loadMovieManualGraph(string path) {
 	this->addFilter(this->pNullRendererFilter, L"NullRenderer", bSuccess);
 	CHECK_SUCCESS(bSuccess);
 
-	this->pSourceFilterInterfaceLoad(path, bSuccess);
-	CHECK_SUCCESS(bSuccess);
+	if (!bHapSource) {
+		this->pSourceFilterInterfaceLoad(path, bSuccess);
+		CHECK_SUCCESS(bSuccess);
+	}
 
-	// pLavSplitterSourceFilter -> pHapDecoderFilter
-	IPin * lavSplitterSourceOutput = this->getOutputPin(this->pLavSplitterSourceFilter, bSuccess);
+	// pHapSourceFilter or pLavSplitterSourceFilter -> pHapDecoderFilter
+	IPin * sourceOutput = this->getOutputPin(pSourceFilter, bSuccess);
 	CHECK_SUCCESS(bSuccess);
 	IPin * hapDecoderInput = this->getInputPin(this->pHapDecoderFilter, bSuccess);
 	if (bSuccess) {
-		this->connectPins(lavSplitterSourceOutput, hapDecoderInput, bSuccess);
+		this->connectPins(sourceOutput, hapDecoderInput, bSuccess);
 		hapDecoderInput->Release();
 	}
-	lavSplitterSourceOutput->Release();
+	sourceOutput->Release();
 	CHECK_SUCCESS(bSuccess);
 
 	// pHapDecoderFilter -> pRawSampleGrabberFilter
@@ -218,7 +293,7 @@ bool DirectShowDXTVideo::loadMovieManualGraph(string path) {
 
 	// check if file also contains audio, if yes, render it with system defaults
 	IPin * lavSplitterSourceAudioOutput = NULL;
-	if (getContainsAudio(pLavSplitterSourceFilter, lavSplitterSourceAudioOutput)) {
+	if (!bHapSource && getContainsAudio(pLavSplitterSourceFilter, lavSplitterSourceAudioOutput)) {
 		this->createAudioRendererFilter(bSuccess);
 		if (bSuccess) this->addFilter(this->pAudioRendererFilter, L"SoundRenderer", bSuccess);
 		if (bSuccess) {
@@ -230,10 +305,41 @@ bool DirectShowDXTVideo::loadMovieManualGraph(string path) {
 
 	this->getDimensionsAndFrameInfo(bSuccess);
 
-	updatePlayState();
+	updateLookahead();
+
+	// asked once, the getters answer from the playback state
+	if (this->timeFormat != TIME_FORMAT_MEDIA_TIME)
+	{
+		pSeekInterface->SetTimeFormat(&TIME_FORMAT_MEDIA_TIME);
+		this->timeFormat = TIME_FORMAT_MEDIA_TIME;
+	}
+	REFERENCE_TIME duration = 0;
+	pSeekInterface->GetDuration(&duration);
+	LONGLONG totalFrames = 0;
+	if (pHapSourceFilter) {
+		totalFrames = pHapSourceFilter->GetIndex().getFrameCount();
+	}
+	else {
+		pSeekInterface->SetTimeFormat(&TIME_FORMAT_FRAME);
+		this->timeFormat = TIME_FORMAT_FRAME;
+		pSeekInterface->GetDuration(&totalFrames);
+	}
+	double rate = 1.0;
+	pPositionInterface->get_Rate(&rate);
+
+	playbackState.modify([&](DXTPlaybackState & state) {
+		state.bLoaded = true;
+		state.duration = duration;
+		state.totalFrames = (int)totalFrames;
+		state.rate = rate;
+	});
 
 	bVideoOpened = true;
 
+	updatePlayState();
+
+	startEventThread();
+
 	return true;
 }
 
@@ -309,6 +415,22 @@ void DirectShowDXTVideo::pSourceFilterInterfaceLoad(string path, bool &success)
 	}
 }
 
+void DirectShowDXTVideo::createHapSourceFilter(string path, bool &success) {
+	HRESULT hr = 0;
+	this->pHapSourceFilter = (DSHapSource*)DSHapSource::CreateInstance(NULL, &hr);
+	this->pHapSourceFilter->AddRef();
+	if (SUCCEEDED(hr)) hr = this->pHapSourceFilter->Open(path);
+	if (SUCCEEDED(hr)) this->pHapSourceFilter->SetLoop(loopMode, loopInFrame, loopOutFrame);
+
+	// audio needs a splitter, the frame index only keeps the PCM chunks for now
+	if (SUCCEEDED(hr) && this->pHapSourceFilter->GetIndex().audio.bPresent) hr = S_FALSE;
+	if (hr != S_OK) {
+		ofLogVerbose("DirectShowDXTVideo") << "Using LAV Splitter for " << path;
+		SAFE_RELEASE(this->pHapSourceFilter);
+		success = false;
+	}
+}
+
 void DirectShowDXTVideo::createLavSplitterSourceFilter(bool &success) {
 	HRESULT hr = CoCreateInstance(CLSID_LAVSplitterSource, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)(&this->pLavSplitterSourceFilter));
 	if (FAILED(hr)) {
@@ -317,10 +439,12 @@ void DirectShowDXTVideo::createLavSplitterSourceFilter(bool &success) {
 }
 
 void DirectShowDXTVideo::createHapDecoderFilter(bool &success) {
-	HRESULT hr = CoCreateInstance(CLSID_HapDecoder, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)(&this->pHapDecoderFilter));
-	if (FAILED(hr)) {
-		success = false;
-	}
+	HRESULT hr = 0;
+	this->pHapDecoderFilter = (DSHapDecoder*)DSHapDecoder::CreateInstance(NULL, &hr);
+	this->pHapDecoderFilter->AddRef();
+	success = SUCCEEDED(hr);
+	this->pHapDecoderFilter->SetDecodePriority(decodePriority);
+	this->pHapDecoderFilter->SetDecodeAhead(decodeAheadFrames, decodeAheadBudget);
 }
 
 void DirectShowDXTVideo::createRawSampleGrabberFilter(bool &success) {
@@ -329,6 +453,9 @@ void DirectShowDXTVideo::createRawSampleGrabberFilter(bool &success) {
 	this->pRawSampleGrabberFilter->AddRef();
 	success = SUCCEEDED(hr);
 	this->pRawSampleGrabberFilter->SetCallback(this, 0);
+
+	// every ring slot may hold a sample, upstream needs one more to decode into and one in transit
+	if (bUseSampleLeasing) this->pRawSampleGrabberFilter->SetInputBufferCount(FRAME_RING_SLOTS + 2);
 }
 
 void DirectShowDXTVideo::createNullRendererFilter(bool &success) {
@@ -419,6 +546,7 @@ void DirectShowDXTVideo::getDimensionsAndFrameInfo(bool &success)
 		this->width = infoheader->bmiHeader.biWidth;
 		this->height = infoheader->bmiHeader.biHeight;
 		this->averageTimePerFrame = infoheader->AvgTimePerFrame / 10000000.0;
+		if (infoheader->AvgTimePerFrame > 0) this->frameDuration = infoheader->AvgTimePerFrame;
 		this->videoSize = infoheader->bmiHeader.biSizeImage; // how many pixels to allocate
 
 		BITMAPINFOHEADER * bitmapheader = &((VIDEOINFOHEADER*)mt.pbFormat)->bmiHeader;
@@ -457,12 +585,22 @@ void DirectShowDXTVideo::getDimensionsAndFrameInfo(bool &success)
 			ofLogWarning("DirectShowDXTVideo") << "Video frame size not encoded in file header";
 			videoSize = width * height * (this->textureFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 4 : 3);
 		}
-
-		this->rawBuffer = new unsigned char[videoSize];
 	}
 
-	// Now pause the graph.
+	// Now stop the graph, so the streaming thread is idle while the frame ring gets set up.
 	hr = pControlInterface->Stop();
+
+	if (success) {
+		if (bUseSampleLeasing && pRawSampleGrabberFilter->GetInputBufferCount() > FRAME_RING_SLOTS) {
+			frameRing.allocateLeased(FRAME_RING_SLOTS, releaseSampleLease);
+		}
+		else {
+			if (bUseSampleLeasing) {
+				ofLogWarning("DirectShowDXTVideo") << "Upstream allocator has too few buffers for sample leasing, copying frames instead";
+			}
+			frameRing.allocate(FRAME_RING_SLOTS, videoSize);
+		}
+	}
 }
 
 bool DirectShowDXTVideo::getContainsAudio(IBaseFilter * filter, IPin *& audioPin) {
@@ -504,36 +642,132 @@ bool DirectShowDXTVideo::getContainsAudio(IBaseFilter * filter, IPin *& audioPin
 
 void DirectShowDXTVideo::update() {
 	if (bVideoOpened) {
+		// a frame is new if the render thread picked up a different one since the last update
+		DXTPlaybackState snapshot = playbackState.load();
+		bFrameNew = (snapshot.frameIndex != lastFrameIndex || snapshot.frameSequence != lastFrameSequence);
+		lastFrameIndex = snapshot.frameIndex;
+		lastFrameSequence = snapshot.frameSequence;
+	}
+}
+
+void DirectShowDXTVideo::startEventThread() {
+	OAEVENT hGraphEvent = 0;
+	if (FAILED(pEventInterface->GetEventHandle(&hGraphEvent))) {
+		ofLogWarning("DirectShowDXTVideo") << "No graph event handle, loops and end of stream won't be handled";
+		return;
+	}
+	hEventThreadStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	eventThread = std::thread(&DirectShowDXTVideo::eventThreadLoop, this);
+}
+
+void DirectShowDXTVideo::stopEventThread() {
+	if (eventThread.joinable()) {
+		SetEvent(hEventThreadStop);
+		eventThread.join();
+	}
+	if (hEventThreadStop) {
+		CloseHandle(hEventThreadStop);
+		hEventThreadStop = NULL;
+	}
+}
 
+void DirectShowDXTVideo::eventThreadLoop() {
+	// the graph is free threaded, see the loader thread
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+	OAEVENT hGraphEvent = 0;
+	pEventInterface->GetEventHandle(&hGraphEvent);
+	HANDLE handles[2] = { hEventThreadStop, (HANDLE)hGraphEvent };
+
+	// the graph's handle stays signaled while events are queued
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		uint64_t receivedMicros = steadyMicros();
 		long eventCode = 0;
 		LONG_PTR ptrParam1 = 0;
 		LONG_PTR ptrParam2 = 0;
-		long timeoutMs = 2000;
+		while (S_OK == pEventInterface->GetEvent(&eventCode, &ptrParam1, &ptrParam2, 0)) {
+			handleGraphEvent(eventCode, ptrParam1, receivedMicros);
+			pEventInterface->FreeEventParams(eventCode, ptrParam1, ptrParam2);
+		}
+	}
+
+	CoUninitialize();
+}
 
-		if (curMovieFrame != frameCount) {
-			bFrameNew = true;
+void DirectShowDXTVideo::handleGraphEvent(long eventCode, LONG_PTR param1, uint64_t receivedMicros) {
+	DXTGraphEvent event;
+	event.code = eventCode;
+	event.result = S_OK;
+	event.receivedMicros = receivedMicros;
+
+	if (eventCode == EC_COMPLETE) {
+		// 0 is the first frame in every time format, so this doesn't race with the app's seeks
+		REFERENCE_TIME start = 0;
+		pSeekInterface->SetPositions(&start, AM_SEEKING_AbsolutePositioning, NULL, AM_SEEKING_NoPositioning);
+		if (bLoop) {
+			event.type = DXTGraphEvent_Looped;
+			playbackState.modify([](DXTPlaybackState & state) { state.position = 0; });
 		}
 		else {
-			bFrameNew = false;
+			event.type = DXTGraphEvent_Completed;
+			pControlInterface->Stop();
+			playbackState.modify([](DXTPlaybackState & state) {
+				state.bPlaying = false;
+				state.bPaused = false;
+				state.bEndReached = true;
+				state.position = 0;
+			});
 		}
-		curMovieFrame = frameCount;
+	}
+	else if (eventCode == EC_ERRORABORT || eventCode == EC_ERRORABORTEX || eventCode == EC_USERABORT) {
+		event.type = DXTGraphEvent_Error;
+		event.result = eventCode == EC_USERABORT ? E_ABORT : (HRESULT)param1;
+		pControlInterface->Stop();
+		publishPlayState(false, false);
+		ofLogError("DirectShowDXTVideo") << "Playback aborted, hr = 0x" << std::hex << event.result;
+	}
+	else if (eventCode == EC_HAP_LOOPED) {
+		// the source already wrapped around, nothing to seek
+		event.type = DXTGraphEvent_Looped;
+	}
+	else if (eventCode == EC_DXT_RATE_CHANGED) {
+		event.type = DXTGraphEvent_RateChanged;
+	}
+	else {
+		return;
+	}
 
-		while (S_OK == pEventInterface->GetEvent(&eventCode, (LONG_PTR*)&ptrParam1, (LONG_PTR*)&ptrParam2, 0)) {
-			if (eventCode == EC_COMPLETE) {
-				if (bLoop) {
-					setPosition(0.0);
-					frameCount = 0;
-				}
-				else {
-					bEndReached = true;
-					stop();
-					updatePlayState();
-				}
-			}
+	event.rate = playbackState.load().rate;
+	event.latencyMicros = (double)(steadyMicros() - receivedMicros);
 
-			pEventInterface->FreeEventParams(eventCode, ptrParam1, ptrParam2);
+	graphEventStats.modify([&event](DXTGraphEventStats & stats) {
+		stats.events++;
+		if (event.type == DXTGraphEvent_Looped) {
+			stats.loops++;
+			stats.lastLoopMicros = event.latencyMicros;
+			stats.averageLoopMicros += (event.latencyMicros - stats.averageLoopMicros) / stats.loops;
+			stats.maxLoopMicros = max(stats.maxLoopMicros, event.latencyMicros);
 		}
-	}
+	});
+	graphEvents.push(event);
+}
+
+bool DirectShowDXTVideo::pollGraphEvent(DXTGraphEvent & event) {
+	return graphEvents.pop(event);
+}
+
+DXTGraphEventStats DirectShowDXTVideo::getGraphEventStats() {
+	DXTGraphEventStats stats = graphEventStats.load();
+	stats.dropped = graphEvents.getDropped();
+	return stats;
+}
+
+void DirectShowDXTVideo::setUseSampleLeasing(bool bUseLeasing) {
+	bUseSampleLeasing = bUseLeasing;
+}
+
+bool DirectShowDXTVideo::isUsingSampleLeasing() {
+	return frameRing.isLeased();
 }
 
 bool DirectShowDXTVideo::isLoaded() {
@@ -562,35 +796,11 @@ float DirectShowDXTVideo::getVolume() {
 }
 
 double DirectShowDXTVideo::getDurationInSeconds() {
-	if (this->timeFormat != TIME_FORMAT_MEDIA_TIME)
-	{
-		pSeekInterface->SetTimeFormat(&TIME_FORMAT_MEDIA_TIME);
-		this->timeFormat = TIME_FORMAT_MEDIA_TIME;
-	}
-	if (isLoaded()) {
-		long long lDurationInNanoSecs = 0;
-		pSeekInterface->GetDuration(&lDurationInNanoSecs);
-		double timeInSeconds = (double)lDurationInNanoSecs / 10000000.0;
-
-		return timeInSeconds;
-	}
-	return 0.0;
+	return playbackState.load().duration / 10000000.0;
 }
 
 double DirectShowDXTVideo::getCurrentTimeInSeconds() {
-	if (this->timeFormat != TIME_FORMAT_MEDIA_TIME)
-	{
-		pSeekInterface->SetTimeFormat(&TIME_FORMAT_MEDIA_TIME);
-		this->timeFormat = TIME_FORMAT_MEDIA_TIME;
-	}
-	if (isLoaded()) {
-		long long lCurrentTimeInNanoSecs = 0;
-		pSeekInterface->GetCurrentPosition(&lCurrentTimeInNanoSecs);
-		double timeInSeconds = (double)lCurrentTimeInNanoSecs / 10000000.0;
-
-		return timeInSeconds;
-	}
-	return 0.0;
+	return playbackState.load().position / 10000000.0;
 }
 
 void DirectShowDXTVideo::setPosition(float pct) {
@@ -603,38 +813,56 @@ void DirectShowDXTVideo::setPosition(float pct) {
 		if (pct < 0.0) pct = 0.0;
 		if (pct > 1.0) pct = 1.0;
 
-		long long lDurationInNanoSecs = 0;
-		pSeekInterface->GetDuration(&lDurationInNanoSecs);
-
-		rtNew = ((float)lDurationInNanoSecs * pct);
+		rtNew = (REFERENCE_TIME)(playbackState.load().duration * (double)pct);
 		hr = pSeekInterface->SetPositions(&rtNew, AM_SEEKING_AbsolutePositioning, NULL, AM_SEEKING_NoPositioning);
+		if (SUCCEEDED(hr)) {
+			REFERENCE_TIME position = rtNew;
+			playbackState.modify([position](DXTPlaybackState & state) { state.position = position; });
+		}
 	}
 }
 
 float DirectShowDXTVideo::getPosition() {
-	if (this->timeFormat != TIME_FORMAT_MEDIA_TIME)
-	{
-		pSeekInterface->SetTimeFormat(&TIME_FORMAT_MEDIA_TIME);
-		this->timeFormat = TIME_FORMAT_MEDIA_TIME;
-	}
-	if (bVideoOpened) {
-		float timeDur = getDurationInSeconds();
-		if (timeDur > 0.0) {
-			return getCurrentTimeInSeconds() / timeDur;
-		}
+	DXTPlaybackState state = playbackState.load();
+	if (state.duration > 0) {
+		return (float)((double)state.position / state.duration);
 	}
 	return 0.0;
 }
 
 void DirectShowDXTVideo::setSpeed(float speed) {
 	if (bVideoOpened) {
-		pPositionInterface->put_Rate(speed);
-		pPositionInterface->get_Rate(&movieRate);
+		double rate = 1.0;
+		if (pHapSourceFilter) {
+			// the source times its frames for the speed and direction, the graph stays at rate 1
+			// so nothing is flushed
+			if (FAILED(pHapSourceFilter->SetSpeed(speed))) {
+				ofLogWarning("DirectShowDXTVideo") << "setSpeed(): speed must not be 0";
+				return;
+			}
+			rate = speed;
+		}
+		else {
+			if (speed < 0.0f) {
+				ofLogWarning("DirectShowDXTVideo") << "setSpeed(): reverse playback needs the Hap source";
+				return;
+			}
+			pPositionInterface->put_Rate(speed);
+			pPositionInterface->get_Rate(&rate);
+			graphRate = rate;
+		}
+		playbackState.modify([rate](DXTPlaybackState & state) { state.rate = rate; });
+
+		IMediaEventSink * pEventSink = NULL;
+		if (SUCCEEDED(pGraphManager->QueryInterface(IID_IMediaEventSink, (void **)&pEventSink))) {
+			pEventSink->Notify(EC_DXT_RATE_CHANGED, 0, 0);
+			pEventSink->Release();
+		}
 	}
 }
 
 double DirectShowDXTVideo::getSpeed() {
-	return movieRate;
+	return playbackState.load().rate;
 }
 
 DXTTextureFormat DirectShowDXTVideo::getTextureFormat() {
@@ -644,8 +872,11 @@ DXTTextureFormat DirectShowDXTVideo::getTextureFormat() {
 void DirectShowDXTVideo::play() {
 	if (bVideoOpened) {
 		pControlInterface->Run();
-		bEndReached = false;
-		updatePlayState();
+		playbackState.modify([](DXTPlaybackState & state) {
+			state.bPlaying = true;
+			state.bPaused = false;
+			state.bEndReached = false;
+		});
 	}
 }
 
@@ -655,7 +886,7 @@ void DirectShowDXTVideo::stop() {
 			setPosition(0.0);
 		}
 		pControlInterface->Stop();
-		updatePlayState();
+		publishPlayState(false, false);
 	}
 }
 
@@ -667,39 +898,38 @@ void DirectShowDXTVideo::setPaused(bool bPaused) {
 		else {
 			pControlInterface->Run();
 		}
-		updatePlayState();
+		publishPlayState(!bPaused, bPaused);
 	}
 }
 
+// the state a transition is heading for counts, waiting for it would block the caller
 void DirectShowDXTVideo::updatePlayState() {
 	if (bVideoOpened) {
 		FILTER_STATE fs;
-		hr = pControlInterface->GetState(4000, (OAFilterState*)&fs);
-		if (hr == S_OK) {
-			if (fs == State_Running) {
-				bPlaying = true;
-				bPaused = false;
-			}
-			else if (fs == State_Paused) {
-				bPlaying = false;
-				bPaused = true;
-			}
-			else if (fs == State_Stopped) {
-				bPlaying = false;
-				bPaused = false;
-			}
+		hr = pControlInterface->GetState(0, (OAFilterState*)&fs);
+		if (hr == S_OK || hr == VFW_S_STATE_INTERMEDIATE) {
+			publishPlayState(fs == State_Running, fs == State_Paused);
 		}
 	}
 }
 
+void DirectShowDXTVideo::publishPlayState(bool bPlaying, bool bPaused) {
+	playbackState.modify([bPlaying, bPaused](DXTPlaybackState & state) {
+		state.bPlaying = bPlaying;
+		state.bPaused = bPaused;
+	});
+}
+
+DXTPlaybackState DirectShowDXTVideo::getPlaybackState() {
+	return playbackState.load();
+}
+
 bool DirectShowDXTVideo::isPlaying() {
-	updatePlayState();
-	return bPlaying;
+	return playbackState.load().bPlaying;
 }
 
 bool DirectShowDXTVideo::isPaused() {
-	updatePlayState();
-	return bPaused;
+	return playbackState.load().bPaused;
 }
 
 bool DirectShowDXTVideo::isLooping() {
@@ -707,11 +937,46 @@ bool DirectShowDXTVideo::isLooping() {
 }
 
 void DirectShowDXTVideo::setLoop(bool loop) {
-	bLoop = loop;
+	setLoopMode(loop ? HapLoopMode_Loop : HapLoopMode_None);
+}
+
+void DirectShowDXTVideo::setLoopMode(HapLoopMode mode) {
+	loopMode = mode;
+	bLoop = mode != HapLoopMode_None;
+	// the Hap source loops by itself, EC_COMPLETE only comes from other sources or with looping off
+	if (pHapSourceFilter) {
+		pHapSourceFilter->SetLoop(loopMode, loopInFrame, loopOutFrame);
+	}
+	else if (bVideoOpened && mode == HapLoopMode_Palindrome) {
+		ofLogWarning("DirectShowDXTVideo") << "Palindrome loops need the Hap source, looping the whole clip instead";
+	}
+}
+
+HapLoopMode DirectShowDXTVideo::getLoopMode() {
+	return loopMode;
+}
+
+void DirectShowDXTVideo::setLoopRegion(int inFrame, int outFrame) {
+	loopInFrame = inFrame;
+	loopOutFrame = outFrame;
+	if (pHapSourceFilter) {
+		pHapSourceFilter->SetLoop(loopMode, loopInFrame, loopOutFrame);
+	}
+	else if (bVideoOpened) {
+		ofLogWarning("DirectShowDXTVideo") << "Loop regions need the Hap source, looping the whole clip instead";
+	}
+}
+
+int DirectShowDXTVideo::getLoopInFrame() {
+	return loopInFrame;
+}
+
+int DirectShowDXTVideo::getLoopOutFrame() {
+	return loopOutFrame;
 }
 
 bool DirectShowDXTVideo::isMovieDone() {
-	return bEndReached;
+	return playbackState.load().bEndReached;
 }
 
 float DirectShowDXTVideo::getWidth() {
@@ -752,33 +1017,33 @@ void DirectShowDXTVideo::setFrame(int frame) {
 	if (bVideoOpened) {
 		LONGLONG frameNumber = frame;
 		hr = pSeekInterface->SetPositions(&frameNumber, AM_SEEKING_AbsolutePositioning, NULL, AM_SEEKING_NoPositioning);
+		if (SUCCEEDED(hr)) {
+			REFERENCE_TIME position = frameNumber * frameDuration;
+			playbackState.modify([position](DXTPlaybackState & state) { state.position = position; });
+		}
 	}
 }
 
+// index of the frame last handed to the render thread, no graph query needed
 int DirectShowDXTVideo::getCurrentFrame() {
-	if (this->timeFormat != TIME_FORMAT_FRAME)
-	{
-		pSeekInterface->SetTimeFormat(&TIME_FORMAT_FRAME);
-		this->timeFormat = TIME_FORMAT_FRAME;
+	DXTPlaybackState state = playbackState.load();
+	if (state.frameIndex >= 0) {
+		return (int)state.frameIndex;
 	}
-	LONGLONG currentFrame = 0;
-	if (bVideoOpened) {
-		pSeekInterface->GetCurrentPosition(&currentFrame);
+	return 0;
+}
+
+// media time in seconds of the frame last handed to the render thread
+double DirectShowDXTVideo::getCurrentFrameTime() {
+	DXTPlaybackState state = playbackState.load();
+	if (state.frameIndex >= 0) {
+		return state.frameTime / 10000000.0;
 	}
-	return currentFrame;
+	return 0.0;
 }
 
 int DirectShowDXTVideo::getTotalFrames() {
-	if (this->timeFormat != TIME_FORMAT_FRAME)
-	{
-		pSeekInterface->SetTimeFormat(&TIME_FORMAT_FRAME);
-		this->timeFormat = TIME_FORMAT_FRAME;
-	}
-	LONGLONG frames = 0;
-	if (isLoaded()) {
-		pSeekInterface->GetDuration(&frames);
-	}
-	return frames;
+	return playbackState.load().totalFrames;
 }
 
 int DirectShowDXTVideo::getBufferSize() {
@@ -786,10 +1051,189 @@ int DirectShowDXTVideo::getBufferSize() {
 }
 
 void DirectShowDXTVideo::getPixels(unsigned char * dstBuffer) {
-	if (bVideoOpened && bNewPixels) {
-		EnterCriticalSection(&critSection);
-		memcpy(dstBuffer, rawBuffer, videoSize);
-		bNewPixels = false;
-		LeaveCriticalSection(&critSection);
+	if (bVideoOpened) {
+		const DXTFrame * frame = acquireFrame();
+		if (frame) {
+			memcpy(dstBuffer, frame->data, frame->size);
+			frameRing.release(frame);
+		}
+	}
+}
+
+const DXTFrame * DirectShowDXTVideo::acquireFrame() {
+	if (!bVideoOpened) return NULL;
+
+	const DXTFrame * frame = frameRing.acquireLatest();
+	frameAcquired(frame);
+	return frame;
+}
+
+const DXTFrame * DirectShowDXTVideo::prerollFirstFrame(int timeoutMs, const std::atomic<bool> & bCancel) {
+	if (!bVideoOpened) return NULL;
+
+	// a paused graph delivers frames until the renderer holds one
+	setPaused(true);
+	DWORD start = GetTickCount();
+	for (;;) {
+		const DXTFrame * frame = acquireFrame();
+		if (frame) return frame;
+		if (bCancel.load() || GetTickCount() - start > (DWORD)timeoutMs) return NULL;
+		Sleep(1);
 	}
 }
+
+void DirectShowDXTVideo::frameAcquired(const DXTFrame * frame) {
+	if (frame) {
+		// the position within the clip, frame->startTime is on the continuous timeline of a loop
+		REFERENCE_TIME frameTime = frame->startTime;
+		if (pHapSourceFilter && frame->frameIndex >= 0 && frame->frameIndex < pHapSourceFilter->GetIndex().getFrameCount()) {
+			frameTime = pHapSourceFilter->GetIndex().getFrameTime((int)frame->frameIndex);
+		}
+		playbackState.modify([frame, frameTime](DXTPlaybackState & state) {
+			state.frameIndex = frame->frameIndex;
+			state.frameTime = frameTime;
+			state.frameSequence = frame->sequence;
+			state.position = frameTime;
+		});
+	}
+}
+
+void DirectShowDXTVideo::releaseFrame(const DXTFrame * frame) {
+	if (frame) frameRing.release(frame);
+}
+
+DXTFrameRingStats DirectShowDXTVideo::getFrameRingStats() {
+	return frameRing.getStats();
+}
+
+int DirectShowDXTVideo::getFrameRingSize() {
+	return FRAME_RING_SLOTS;
+}
+
+long DirectShowDXTVideo::getFrameSize() {
+	return videoSize;
+}
+
+bool DirectShowDXTVideo::setFrameStorage(unsigned char ** slotData, long slotSize) {
+	if (!bVideoOpened || frameRing.isLeased() || slotSize < videoSize) return false;
+
+	// the streaming thread must be idle while slots are swapped
+	pControlInterface->Stop();
+	publishPlayState(false, false);
+
+	if (!frameRing.allocateExternal(FRAME_RING_SLOTS, slotSize, slotData)) {
+		frameRing.allocate(FRAME_RING_SLOTS, videoSize);
+		return false;
+	}
+	return true;
+}
+
+void DirectShowDXTVideo::resetFrameStorage() {
+	if (!bVideoOpened || frameRing.isLeased()) return;
+
+	pControlInterface->Stop();
+	publishPlayState(false, false);
+	frameRing.allocate(FRAME_RING_SLOTS, videoSize);
+}
+
+void DirectShowDXTVideo::setFrameScheduling(bool bScheduling) {
+	bFrameScheduling = bScheduling;
+	updateLookahead();
+}
+
+bool DirectShowDXTVideo::isFrameScheduling() {
+	return bFrameScheduling;
+}
+
+// keep all but two ring slots (the one on screen and the one being written) decoded ahead
+void DirectShowDXTVideo::updateLookahead() {
+	if (pRawSampleGrabberFilter) {
+		pRawSampleGrabberFilter->SetLookahead(bFrameScheduling ? (FRAME_RING_SLOTS - 2) * frameDuration : 0);
+	}
+}
+
+const DXTFrame * DirectShowDXTVideo::acquireFrameForDisplay(double secondsUntilDisplay) {
+	if (!bVideoOpened) return NULL;
+	updateRefreshInterval();
+
+	const DXTFrame * frame = NULL;
+	REFERENCE_TIME now = 0;
+	if (SUCCEEDED(pRawSampleGrabberFilter->GetCurrentMediaTime(&now))) {
+		REFERENCE_TIME displayTime = now + (REFERENCE_TIME)(secondsUntilDisplay * 10000000.0 * graphRate);
+		frame = frameScheduler.selectFrame(frameRing, displayTime);
+	}
+	else {
+		// paused or stopped, nothing is moving, so the newest frame is the right one
+		frame = frameScheduler.selectLatest(frameRing);
+	}
+
+	frameAcquired(frame);
+	return frame;
+}
+
+DXTSchedulerStats DirectShowDXTVideo::getSchedulerStats() {
+	return frameScheduler.getStats();
+}
+
+HapSourceStats DirectShowDXTVideo::getSourceStats() {
+	if (pHapSourceFilter) return pHapSourceFilter->GetStats();
+	HapSourceStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+void DirectShowDXTVideo::updateRefreshInterval() {
+	uint64_t nowMicros = steadyMicros();
+	if (lastDisplayMicros > 0) {
+		// hitches like loading another clip would throw the average off
+		double interval = (nowMicros - lastDisplayMicros) / 1000000.0;
+		if (interval >= 0.002 && interval <= 0.1) {
+			refreshInterval = refreshInterval > 0.0 ? refreshInterval + (interval - refreshInterval) * 0.05 : interval;
+		}
+	}
+	lastDisplayMicros = nowMicros;
+
+	// the source takes its lock for it, only pass on changes of more than 2%
+	if (pHapSourceFilter && refreshInterval > 0.0) {
+		REFERENCE_TIME interval = (REFERENCE_TIME)(refreshInterval * 10000000.0 * REFRESH_INTERVAL_MARGIN);
+		if (llabs(interval - sourceRefreshInterval) * 50 > sourceRefreshInterval) {
+			pHapSourceFilter->SetRefreshInterval(interval);
+			sourceRefreshInterval = interval;
+		}
+	}
+}
+
+void DirectShowDXTVideo::setDecodePriority(DXTTaskPriority priority) {
+	decodePriority = priority;
+	if (pHapDecoderFilter) pHapDecoderFilter->SetDecodePriority(priority);
+}
+
+DXTTaskPriority DirectShowDXTVideo::getDecodePriority() {
+	return decodePriority;
+}
+
+HapDecodeStats DirectShowDXTVideo::getDecodeStats() {
+	if (pHapDecoderFilter) return pHapDecoderFilter->GetDecodeStats();
+	HapDecodeStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+DXTTaskClientStats DirectShowDXTVideo::getDecodeSchedulingStats() {
+	if (pHapDecoderFilter) return pHapDecoderFilter->GetSchedulingStats();
+	DXTTaskClientStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+void DirectShowDXTVideo::setDecodeAhead(int frames, size_t memoryBudget) {
+	decodeAheadFrames = frames;
+	decodeAheadBudget = memoryBudget;
+}
+
+HapPipelineStats DirectShowDXTVideo::getDecodePipelineStats() {
+	if (pHapDecoderFilter) return pHapDecoderFilter->GetPipelineStats();
+	HapPipelineStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
@@ -5,11 +5,60 @@
 #include <stdio.h>
 #include <strsafe.h>
 #include <stdint.h>
+#include <atomic>
+#include <thread>
 
 #include "ofMain.h"
 #include "DSShared.h"
 #include "DXTShared.h"
+#include "DSHapDecoder.h"
+#include "DSHapSource.h"
 #include "DSRawSampleGrabber.h"
+#include "DXTFrameRing.h"
+#include "DXTFrameScheduler.h"
+#include "DXTSeqLock.h"
+#include "DXTSpscQueue.h"
+
+// as of the last command, graph event or frame handed to the render thread, readable from any thread
+struct DXTPlaybackState {
+	bool bLoaded;
+	bool bPlaying;
+	bool bPaused;
+	bool bEndReached;
+	double rate;
+	REFERENCE_TIME duration;	// 100 ns units
+	int totalFrames;
+	REFERENCE_TIME position;	// the last seek target or frame handed to the render thread
+	int64_t frameIndex;		// last frame handed to the render thread, -1 before the first
+	REFERENCE_TIME frameTime;
+	uint64_t frameSequence;
+};
+
+enum DXTGraphEventType {
+	DXTGraphEvent_Looped,		// reached the end and restarted at the first frame
+	DXTGraphEvent_Completed,	// reached the end without looping, stopped and rewound
+	DXTGraphEvent_Error,		// the graph aborted and was stopped
+	DXTGraphEvent_RateChanged,
+};
+
+// handled on the player's event thread as soon as the graph signaled it
+struct DXTGraphEvent {
+	DXTGraphEventType type;
+	long code;					// the DirectShow event code
+	HRESULT result;				// why the graph aborted, S_OK otherwise
+	double rate;
+	uint64_t receivedMicros;	// steady clock, when the event thread woke up for it
+	double latencyMicros;		// from waking up until it was handled, e.g. the seek back to the start
+};
+
+struct DXTGraphEventStats {
+	uint64_t events;			// published, including dropped ones
+	uint64_t dropped;			// the app didn't poll them in time
+	uint64_t loops;
+	double lastLoopMicros;		// time to restart at the first frame
+	double averageLoopMicros;
+	double maxLoopMicros;
+};
 
 class DirectShowDXTVideo : public ISampleGrabberCB {
 
@@ -18,7 +67,14 @@ public:
 	DirectShowDXTVideo();
 	~DirectShowDXTVideo();
 
+	// may run on another thread than the rest, which must have initialized COM
 	bool loadMovieManualGraph(string path);
+	// pauses the graph and waits for the first decoded frame, NULL on timeout or when cancelled
+	const DXTFrame * prerollFirstFrame(int timeoutMs, const std::atomic<bool> & bCancel);
+
+	// opt-in: hold on to the decoder's samples instead of copying them, set before loading
+	void setUseSampleLeasing(bool bUseLeasing);
+	bool isUsingSampleLeasing();
 
 	void getDimensionsAndFrameInfo(bool &success);
 	bool getContainsAudio(IBaseFilter * filter, IPin *& audioPin);
@@ -30,18 +86,34 @@ public:
 	double getCurrentTimeInSeconds();
 	void setPosition(float pct);
 	float getPosition();
+	// negative plays backward, only with the Hap source
 	void setSpeed(float speed);
 	double getSpeed();
 	DXTTextureFormat getTextureFormat();
 	void play();
 	void stop();
 	void setPaused(bool bPaused);
+	// asks the graph without waiting for a transition, the play commands publish their state themselves
 	void updatePlayState();
+	// without a graph query or a lock
+	DXTPlaybackState getPlaybackState();
 	bool isPlaying();
 	bool isPaused();
 	bool isLooping();
 	void setLoop(bool loop);
+	// palindromes and loop regions need the Hap source, they never seek. outFrame < 0 = the last frame
+	void setLoopMode(HapLoopMode mode);
+	HapLoopMode getLoopMode();
+	void setLoopRegion(int inFrame, int outFrame);
+	int getLoopInFrame();
+	int getLoopOutFrame();
 	bool isMovieDone();
+
+	// loops, end of stream, errors and rate changes, handled on the event thread, oldest first.
+	// Only one thread may poll
+	bool pollGraphEvent(DXTGraphEvent & event);
+	DXTGraphEventStats getGraphEventStats();
+
 	float getWidth();
 	float getHeight();
 	bool isFrameNew();
@@ -50,19 +122,60 @@ public:
 	void setFrame(int frame);
 	int getCurrentFrame();
 	int getTotalFrames();
+	double getCurrentFrameTime();
 	int getBufferSize();
 	void getPixels(unsigned char * dstBuffer);
 
+	// lock-free access to the newest frame, every acquired frame must be released
+	const DXTFrame * acquireFrame();
+	void releaseFrame(const DXTFrame * frame);
+	DXTFrameRingStats getFrameRingStats();
+	int getFrameRingSize();
+	long getFrameSize();
+
+	// let the frame ring use caller owned slot memory (e.g. a mapped pixel buffer), stops the graph
+	bool setFrameStorage(unsigned char ** slotData, long slotSize);
+	void resetFrameStorage();
+
+	// buffer frames ahead and pick the one due at the next display refresh instead of the newest
+	void setFrameScheduling(bool bScheduling);
+	bool isFrameScheduling();
+	const DXTFrame * acquireFrameForDisplay(double secondsUntilDisplay);
+	DXTSchedulerStats getSchedulerStats();
+	// frames the Hap source delivered and skipped, it skips frames no refresh would show, timed
+	// by the calls to acquireFrameForDisplay()
+	HapSourceStats getSourceStats();
+
+	// priority of this player's frames on the decode workers all players share
+	void setDecodePriority(DXTTaskPriority priority);
+	DXTTaskPriority getDecodePriority();
+	HapDecodeStats getDecodeStats();
+	DXTTaskClientStats getDecodeSchedulingStats();
+
+	// decode this many frames ahead on the workers, within memoryBudget bytes (0 = no limit), set before loading
+	void setDecodeAhead(int frames, size_t memoryBudget);
+	HapPipelineStats getDecodePipelineStats();
+
 private:
 
 	STDMETHODIMP_(ULONG) AddRef() { return 1; }
 	STDMETHODIMP_(ULONG) Release() { return 2; }
 	STDMETHODIMP QueryInterface(REFIID riid, void **ppvObject);
-	STDMETHODIMP SampleCB(long Time, IMediaSample *pSample);
+	STDMETHODIMP SampleCB(double Time, IMediaSample *pSample);
 	STDMETHODIMP BufferCB(double Time, BYTE *pBuffer, long BufferLen) {return E_NOTIMPL;}
 
 	void tearDown();
 	void clearValues();
+	void frameAcquired(const DXTFrame * frame);
+	void publishPlayState(bool bPlaying, bool bPaused);
+
+	void startEventThread();
+	void stopEventThread();
+	void eventThreadLoop();
+	void handleGraphEvent(long eventCode, LONG_PTR param1, uint64_t receivedMicros);
+
+	void updateLookahead();
+	void updateRefreshInterval();
 
 	void createFilterGraphManager(bool &success);
 
@@ -75,6 +188,7 @@ private:
 
 	void pSourceFilterInterfaceLoad(string path, bool &success);
 
+	void createHapSourceFilter(string path, bool &success);
 	void createLavSplitterSourceFilter(bool &success);
 	void createHapDecoderFilter(bool &success);
 	void createRawSampleGrabberFilter(bool &success);
@@ -98,8 +212,9 @@ private:
 	IFileSourceFilter * pSourceFilterInterface = NULL;
 
 	// filters
+	DSHapSource * pHapSourceFilter = NULL;
 	IBaseFilter * pLavSplitterSourceFilter = NULL;
-	IBaseFilter * pHapDecoderFilter = NULL;
+	DSHapDecoder * pHapDecoderFilter = NULL;
 	DSRawSampleGrabber * pRawSampleGrabberFilter = NULL;
 	IBaseFilter * pNullRendererFilter = NULL;
 	IBaseFilter * pAudioRendererFilter = NULL;
@@ -118,21 +233,38 @@ private:
 	long videoSize;
 
 	double averageTimePerFrame;
+	REFERENCE_TIME frameDuration;		// averageTimePerFrame in 100 ns units
+	double graphRate;					// media time per stream time, the Hap source keeps it at 1
 
 	bool bFrameNew;
-	bool bNewPixels;
 	bool bVideoOpened;
-	bool bPlaying;
-	bool bPaused;
-	bool bLoop;
-	bool bEndReached;
-	double movieRate;
-	int curMovieFrame;
-	int frameCount;
+	std::atomic<bool> bLoop;			// read by the event thread
+	HapLoopMode loopMode;
+	int loopInFrame;
+	int loopOutFrame;
+	bool bUseSampleLeasing;
+	bool bFrameScheduling;
+	DXTTaskPriority decodePriority;
+	int decodeAheadFrames;
+	size_t decodeAheadBudget;
+	DXTSeqLock<DXTPlaybackState> playbackState;
+
+	// waits on the graph's event handle, the only producer of graphEvents
+	std::thread eventThread;
+	HANDLE hEventThreadStop = NULL;
+	DXTSpscQueue<DXTGraphEvent, 64> graphEvents;
+	DXTSeqLock<DXTGraphEventStats> graphEventStats;
+
+	// frame seen by the last update(), only touched by the render thread
+	int64_t lastFrameIndex;
+	uint64_t lastFrameSequence;
 	int lastBufferSize;
+	uint64_t lastDisplayMicros;			// last call to acquireFrameForDisplay()
+	double refreshInterval;				// average seconds between those calls
+	REFERENCE_TIME sourceRefreshInterval;	// passed to the Hap source
 
-	CRITICAL_SECTION critSection;
-	unsigned char * rawBuffer;
+	DXTFrameRing frameRing;
+	DXTFrameScheduler frameScheduler;
 
 	DXTTextureFormat textureFormat;
 
@@ -0,0 +1,361 @@
+#include "HapAviDemuxer.h"
+
+#include <stdlib.h>
+
+// chunk ids as read little endian from the file
+#define AVI_TYPE(a, b, c, d) HAP_FOURCC(a, b, c, d)
+
+// OpenDML index types
+#define AVI_INDEX_OF_INDEXES 0x00
+#define AVI_INDEX_OF_CHUNKS 0x01
+#define AVI_INDEX_DELTAFRAME 0x80000000
+
+// WAVEFORMATEX tags, named apart from the ones in mmreg.h
+#define AVI_WAVE_FORMAT_PCM 0x0001
+#define AVI_WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define AVI_WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t readLE16(const unsigned char * p) {
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const unsigned char * p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t readLE64(const unsigned char * p) {
+	return ((uint64_t)readLE32(p + 4) << 32) | readLE32(p);
+}
+
+static int64_t ticksToTime(uint64_t ticks, uint32_t rate) {
+	return (int64_t)((ticks / rate) * 10000000 + (ticks % rate) * 10000000 / rate);
+}
+
+struct RiffChunk {
+	uint32_t id;
+	const unsigned char * data;		// payload, after the header
+	size_t size;
+};
+
+// the chunk at p, moves p past it and its padding byte
+static bool nextChunk(const unsigned char *& p, const unsigned char * end, RiffChunk & chunk) {
+	if (end - p < 8) return false;
+
+	size_t size = readLE32(p + 4);
+	if (size > (size_t)(end - p) - 8) return false;
+
+	chunk.id = readLE32(p);
+	chunk.data = p + 8;
+	chunk.size = size;
+	p += 8 + size;
+	if ((size & 1) && p < end) p++;
+	return true;
+}
+
+static bool isList(const RiffChunk & chunk, uint32_t type) {
+	return chunk.id == AVI_TYPE('L', 'I', 'S', 'T') && chunk.size >= 4 && readLE32(chunk.data) == type;
+}
+
+// frame or audio data of one stream, after the chunk header
+struct AviChunk {
+	uint64_t offset;
+	uint32_t size;
+};
+
+struct AviStream {
+	uint32_t type;			// 'vids', 'auds', ...
+	uint32_t handler;
+	uint32_t scale;			// rate / scale chunks per second
+	uint32_t rate;
+	const unsigned char * format;		// strf, BITMAPINFOHEADER or WAVEFORMATEX
+	size_t formatSize;
+	const unsigned char * superIndex;	// indx, NULL without
+	size_t superIndexSize;
+	std::vector<AviChunk> chunks;
+};
+
+static bool parseStream(const RiffChunk & strl, AviStream & stream) {
+	stream.format = NULL;
+	stream.formatSize = 0;
+	stream.superIndex = NULL;
+	stream.superIndexSize = 0;
+
+	bool bHeader = false;
+	const unsigned char * p = strl.data + 4;
+	const unsigned char * end = strl.data + strl.size;
+	RiffChunk chunk;
+	while (nextChunk(p, end, chunk)) {
+		if (chunk.id == AVI_TYPE('s', 't', 'r', 'h') && chunk.size >= 48) {
+			stream.type = readLE32(chunk.data);
+			stream.handler = readLE32(chunk.data + 4);
+			stream.scale = readLE32(chunk.data + 20);
+			stream.rate = readLE32(chunk.data + 24);
+			bHeader = true;
+		}
+		else if (chunk.id == AVI_TYPE('s', 't', 'r', 'f')) {
+			stream.format = chunk.data;
+			stream.formatSize = chunk.size;
+		}
+		else if (chunk.id == AVI_TYPE('i', 'n', 'd', 'x')) {
+			stream.superIndex = chunk.data;
+			stream.superIndexSize = chunk.size;
+		}
+	}
+	return bHeader && stream.format != NULL;
+}
+
+// the ix## standard indexes listed in a stream's indx, mapped one at a time
+static HapDemuxResult readSuperIndex(const HapMediaFile & file, AviStream & stream) {
+	const unsigned char * indx = stream.superIndex;
+	if (stream.superIndexSize < 24) return HapDemuxResult_BadFile;
+	uint32_t numEntries = readLE32(indx + 4);
+	if (readLE16(indx) != 4 || indx[3] != AVI_INDEX_OF_INDEXES || numEntries > (stream.superIndexSize - 24) / 16) return HapDemuxResult_BadFile;
+
+	// each entry gives the number of chunks its index holds, with 8 bytes of chunk header at least
+	uint64_t fileSize = file.getSize();
+	uint64_t numChunksTotal = 0;
+	for (uint32_t i = 0; i < numEntries; i++) numChunksTotal += readLE32(indx + 24 + 16 * i + 12);
+	stream.chunks.reserve((size_t)(numChunksTotal < fileSize / 8 ? numChunksTotal : fileSize / 8));
+
+	for (uint32_t i = 0; i < numEntries; i++) {
+		uint64_t offset = readLE64(indx + 24 + 16 * i);
+
+		// an index past the end belongs to data that was never written
+		unsigned char header[8];
+		if (offset > fileSize || fileSize - offset < 8) break;
+		if (!file.read(offset, header, sizeof(header))) return HapDemuxResult_ReadError;
+		uint64_t size = readLE32(header + 4);
+		if (size > fileSize - offset - 8) break;
+
+		if (size < 24) return HapDemuxResult_BadFile;
+
+		HapFileView view;
+		if (!file.map(offset + 8, size, view)) return HapDemuxResult_ReadError;
+		const unsigned char * ix = view.getData();
+		uint32_t numChunks = readLE32(ix + 4);
+		if (readLE16(ix) != 2 || ix[3] != AVI_INDEX_OF_CHUNKS || numChunks > (size - 24) / 8) return HapDemuxResult_BadFile;
+
+		// entries are relative to a base offset and point at the data, the top bit marks delta frames
+		uint64_t baseOffset = readLE64(ix + 12);
+		for (uint32_t c = 0; c < numChunks; c++) {
+			AviChunk chunk;
+			chunk.offset = baseOffset + readLE32(ix + 24 + 8 * c);
+			chunk.size = readLE32(ix + 24 + 8 * c + 4) & ~AVI_INDEX_DELTAFRAME;
+			stream.chunks.push_back(chunk);
+		}
+	}
+	return HapDemuxResult_OK;
+}
+
+// stream number of a ##dc, ##db or ##wb chunk id, -1 for anything else
+static int getStreamNumber(uint32_t id) {
+	int hi = (int)(id & 0xFF) - '0';
+	int lo = (int)((id >> 8) & 0xFF) - '0';
+	if (hi < 0 || hi > 9 || lo < 0 || lo > 9) return -1;
+	return hi * 10 + lo;
+}
+
+// idx1 offsets are either relative to the movi list or absolute, the first entry tells which
+static HapDemuxResult readLegacyIndex(const HapMediaFile & file, uint64_t idx1Offset, uint64_t idx1Size, uint64_t moviOffset, std::vector<AviStream*> & streams) {
+	HapFileView view;
+	if (!file.map(idx1Offset, idx1Size, view)) return HapDemuxResult_ReadError;
+	const unsigned char * entries = view.getData();
+	size_t numEntries = view.getSize() / 16;
+
+	uint64_t baseOffset = moviOffset;
+	for (size_t i = 0; i < numEntries; i++) {
+		uint32_t id = readLE32(entries + 16 * i);
+		int number = getStreamNumber(id);
+		if (number < 0 || number >= (int)streams.size() || streams[number] == NULL) continue;
+
+		unsigned char header[4];
+		uint64_t offset = readLE32(entries + 16 * i + 8);
+		if (file.read(moviOffset + offset, header, 4) && readLE32(header) == id) baseOffset = moviOffset;
+		else if (file.read(offset, header, 4) && readLE32(header) == id) baseOffset = 0;
+		break;
+	}
+
+	for (size_t i = 0; i < numEntries; i++) {
+		const unsigned char * entry = entries + 16 * i;
+		int number = getStreamNumber(readLE32(entry));
+		if (number < 0 || number >= (int)streams.size() || streams[number] == NULL) continue;
+
+		AviChunk chunk;
+		chunk.offset = baseOffset + readLE32(entry + 8) + 8;
+		chunk.size = readLE32(entry + 12);
+		streams[number]->chunks.push_back(chunk);
+	}
+	return HapDemuxResult_OK;
+}
+
+static HapDemuxResult indexVideo(const AviStream & stream, uint64_t fileSize, HapFrameIndex & index) {
+	// every chunk is a frame slot, empty ones are dropped frames that keep the previous one showing
+	index.frames.reserve(stream.chunks.size());
+	size_t slot = 0;
+	for (; slot < stream.chunks.size(); slot++) {
+		const AviChunk & chunk = stream.chunks[slot];
+		if (chunk.size == 0) continue;
+
+		// a file that is still being written (or was cut) plays up to where its data ends
+		if (chunk.offset > fileSize || chunk.size > fileSize - chunk.offset) break;
+
+		HapIndexEntry entry;
+		entry.offset = chunk.offset;
+		entry.size = chunk.size;
+		entry.time = ticksToTime((uint64_t)slot * stream.scale, stream.rate);
+		index.frames.push_back(entry);
+	}
+
+	if (index.frames.empty()) return HapDemuxResult_BadFile;
+
+	index.duration = ticksToTime((uint64_t)slot * stream.scale, stream.rate);
+	index.frameDuration = ticksToTime(stream.scale, stream.rate);
+	return HapDemuxResult_OK;
+}
+
+static void indexAudio(const AviStream & stream, uint64_t fileSize, HapAudioTrack & audio) {
+	if (stream.formatSize < 16) return;
+
+	const unsigned char * format = stream.format;
+	uint32_t tag = readLE16(format);
+	audio.codec = tag;
+	audio.channels = readLE16(format + 2);
+	audio.sampleRate = (int)readLE32(format + 4);
+	audio.bitsPerSample = readLE16(format + 14);
+	int blockAlign = readLE16(format + 12);
+	if (tag == AVI_WAVE_FORMAT_EXTENSIBLE && stream.formatSize >= 40) tag = readLE16(format + 24);
+
+	if (tag == AVI_WAVE_FORMAT_IEEE_FLOAT) audio.bFloat = true;
+	else if (tag != AVI_WAVE_FORMAT_PCM) return;
+
+	if (audio.channels <= 0 || audio.sampleRate <= 0 || audio.bitsPerSample <= 0 || audio.bitsPerSample % 8) return;
+	if (blockAlign <= 0) blockAlign = audio.channels * audio.bitsPerSample / 8;
+
+	audio.chunks.reserve(stream.chunks.size());
+	uint64_t bytes = 0;
+	for (size_t c = 0; c < stream.chunks.size(); c++) {
+		HapIndexEntry chunk;
+		chunk.offset = stream.chunks[c].offset;
+		chunk.size = stream.chunks[c].size;
+		chunk.time = ticksToTime(bytes / blockAlign, (uint32_t)audio.sampleRate);
+		if (chunk.offset > fileSize || chunk.size > fileSize - chunk.offset) break;
+		audio.chunks.push_back(chunk);
+		bytes += chunk.size;
+	}
+	audio.bPCM = true;
+}
+
+bool HapAviDemuxer::isAviFile(const unsigned char * header, size_t size) {
+	return size >= 12 && readLE32(header) == AVI_TYPE('R', 'I', 'F', 'F') && readLE32(header + 8) == AVI_TYPE('A', 'V', 'I', ' ');
+}
+
+HapDemuxResult HapAviDemuxer::buildIndex(const HapMediaFile & file, HapFrameIndex & index) {
+	index.clear();
+
+	uint64_t fileSize = file.getSize();
+	unsigned char header[12];
+	if (fileSize < 12 || !file.read(0, header, 12)) return HapDemuxResult_ReadError;
+
+	// files that were never finished can have a RIFF size of 0 or one past the end
+	uint64_t riffEnd = 8 + (uint64_t)readLE32(header + 4);
+	if (riffEnd <= 12 || riffEnd > fileSize) riffEnd = fileSize;
+
+	// chunks of the first RIFF, only their headers are read
+	uint64_t position = 12;
+	uint64_t hdrlOffset = 0, hdrlSize = 0;
+	uint64_t moviOffset = 0;
+	uint64_t idx1Offset = 0, idx1Size = 0;
+	while (riffEnd - position >= 8) {
+		size_t headerSize = riffEnd - position >= 12 ? 12 : 8;
+		if (!file.read(position, header, headerSize)) return HapDemuxResult_ReadError;
+
+		uint32_t id = readLE32(header);
+		uint64_t size = readLE32(header + 4);
+		uint32_t listType = headerSize == 12 ? readLE32(header + 8) : 0;
+		bool bList = id == AVI_TYPE('L', 'I', 'S', 'T') && size >= 4;
+
+		if (bList && listType == AVI_TYPE('m', 'o', 'v', 'i')) {
+			moviOffset = position + 8;
+		}
+		if (size > riffEnd - position - 8) break;
+
+		if (bList && listType == AVI_TYPE('h', 'd', 'r', 'l')) {
+			hdrlOffset = position + 12;
+			hdrlSize = size - 4;
+		}
+		else if (id == AVI_TYPE('i', 'd', 'x', '1')) {
+			idx1Offset = position + 8;
+			idx1Size = size;
+		}
+		position += 8 + size + (size & 1);
+	}
+	if (hdrlSize == 0) return HapDemuxResult_BadFile;
+
+	HapFileView hdrlView;
+	if (!file.map(hdrlOffset, hdrlSize, hdrlView)) return HapDemuxResult_ReadError;
+
+	// streams are numbered in the order of their strl lists
+	std::vector<AviStream> streams;
+	const unsigned char * p = hdrlView.getData();
+	const unsigned char * end = p + hdrlView.getSize();
+	RiffChunk chunk;
+	while (nextChunk(p, end, chunk)) {
+		if (!isList(chunk, AVI_TYPE('s', 't', 'r', 'l'))) continue;
+		streams.push_back(AviStream());
+		if (!parseStream(chunk, streams.back())) streams.back().type = 0;
+	}
+
+	AviStream * video = NULL;
+	AviStream * audio = NULL;
+	for (size_t i = 0; i < streams.size(); i++) {
+		AviStream & stream = streams[i];
+		if (stream.type == AVI_TYPE('v', 'i', 'd', 's') && video == NULL && stream.formatSize >= 40 && stream.scale > 0 && stream.rate > 0) {
+			// the handler in the stream header is only a hint, the compression in the format counts
+			index.codec = readLE32(stream.format + 16);
+			DXTTextureFormat format;
+			if (!index.getTextureFormat(format)) continue;
+			index.width = (int)readLE32(stream.format + 4);
+			index.height = abs((int)readLE32(stream.format + 8));
+			video = &stream;
+		}
+		else if (stream.type == AVI_TYPE('a', 'u', 'd', 's') && audio == NULL) {
+			index.audio.bPresent = true;
+			audio = &stream;
+		}
+	}
+	if (video == NULL) {
+		HapAudioTrack audioTrack = index.audio;
+		index.clear();
+		index.audio = audioTrack;
+		return HapDemuxResult_NoHapTrack;
+	}
+
+	// streams without an OpenDML index take their chunks from idx1
+	HapDemuxResult result = HapDemuxResult_OK;
+	std::vector<AviStream*> legacyStreams(streams.size(), (AviStream*)NULL);
+	bool bLegacy = false;
+	for (size_t i = 0; i < streams.size() && result == HapDemuxResult_OK; i++) {
+		AviStream * stream = &streams[i];
+		if (stream != video && stream != audio) continue;
+		if (stream->superIndex != NULL) {
+			result = readSuperIndex(file, *stream);
+		}
+		else if (idx1Size > 0 && moviOffset > 0) {
+			legacyStreams[i] = stream;
+			bLegacy = true;
+		}
+	}
+	if (result == HapDemuxResult_OK && bLegacy) {
+		result = readLegacyIndex(file, idx1Offset, idx1Size, moviOffset, legacyStreams);
+	}
+
+	if (result == HapDemuxResult_OK) result = indexVideo(*video, fileSize, index);
+	if (result == HapDemuxResult_OK && audio != NULL) indexAudio(*audio, fileSize, index.audio);
+
+	if (result != HapDemuxResult_OK) {
+		HapAudioTrack audioTrack = index.audio;
+		index.clear();
+		index.audio = audioTrack;
+	}
+	return result;
+}
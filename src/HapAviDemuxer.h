@@ -0,0 +1,23 @@
+// HapAviDemuxer - AVI and OpenDML (AVI 2.0) indexes to a HapFrameIndex
+//
+// Portable. Reads the hdrl list and the index, never the movi list: the OpenDML super index
+// (indx in the stream header, pointing at ix## standard indexes anywhere in the file) when
+// there is one, else idx1, which only covers the first RIFF and so the first GB or so.
+// Index chunks are memory mapped. Files with neither index are left to a splitter.
+// See https://learn.microsoft.com/windows/win32/directshow/avi-riff-file-reference
+
+#pragma once
+
+#include <stddef.h>
+
+#include "HapDemuxer.h"
+
+class HapAviDemuxer {
+
+public:
+
+	// whether the first bytes of a file are a RIFF AVI header
+	static bool isAviFile(const unsigned char * header, size_t size);
+
+	static HapDemuxResult buildIndex(const HapMediaFile & file, HapFrameIndex & index);
+};
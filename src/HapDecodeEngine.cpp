@@ -0,0 +1,104 @@
+#include "HapDecodeEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+
+// one frame in flight, lives on the stack of decode()
+struct HapDecodeJob {
+	const HapFrameInfo * info;
+	unsigned char * dst;
+	std::atomic<int> result;
+};
+
+HapDecodeEngine::HapDecodeEngine(DXTThreadPool & pool)
+	: m_pool(pool) {
+	resetStats();
+}
+
+HapDecodeEngine::~HapDecodeEngine() {
+}
+
+void HapDecodeEngine::decodeChunkTask(void * arg, int index) {
+	HapDecodeJob * job = (HapDecodeJob*)arg;
+	HapResult result = HapDecoder::decodeChunk(job->info->chunks[index], job->dst);
+	if (result != HapResult_OK) job->result.store(result);
+}
+
+HapResult HapDecodeEngine::decode(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, HapFrameInfo & info) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	HapResult result = HapDecoder::parseFrame(src, srcSize, info);
+	if (result == HapResult_OK && info.outputSize > dstCapacity) result = HapResult_BufferTooSmall;
+	if (result == HapResult_OK && !dst) result = HapResult_BadArguments;
+
+	if (result == HapResult_OK) {
+		if (info.chunks.size() == 1 || m_pool.getNumThreads() == 0) {
+			for (size_t i = 0; i < info.chunks.size() && result == HapResult_OK; i++) {
+				result = HapDecoder::decodeChunk(info.chunks[i], dst);
+			}
+		}
+		else {
+			HapDecodeJob job;
+			job.info = &info;
+			job.dst = dst;
+			job.result.store(HapResult_OK);
+
+			DXTTaskGroup group(&m_client);
+			for (size_t i = 0; i < info.chunks.size(); i++) {
+				m_pool.submit(group, decodeChunkTask, &job, (int)i);
+			}
+			m_pool.wait(group);
+			result = (HapResult)job.result.load();
+		}
+	}
+
+	double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	frameDecoded(result, info.chunks.size(), micros);
+	return result;
+}
+
+void HapDecodeEngine::decodeRequestTask(void * arg, int /*index*/) {
+	HapDecodeRequest * request = (HapDecodeRequest*)arg;
+	request->result = request->engine->decode(request->src, request->srcSize, request->dst, request->dstCapacity, request->info);
+}
+
+void HapDecodeEngine::decodeAsync(HapDecodeRequest & request) {
+	request.engine = this;
+	request.result = HapResult_OK;
+	request.group.setClient(&m_client);
+	m_pool.submit(request.group, decodeRequestTask, &request, 0);
+}
+
+HapResult HapDecodeEngine::wait(HapDecodeRequest & request) {
+	m_pool.wait(request.group);
+	return request.result;
+}
+
+void HapDecodeEngine::frameDecoded(HapResult result, size_t chunks, double micros) {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+
+	if (result != HapResult_OK) {
+		m_stats.failures++;
+		return;
+	}
+
+	m_stats.frames++;
+	m_stats.chunks += chunks;
+	m_stats.lastDecodeMicros = micros;
+	m_stats.averageDecodeMicros += (micros - m_stats.averageDecodeMicros) / m_stats.frames;
+	if (micros > m_stats.maxDecodeMicros) m_stats.maxDecodeMicros = micros;
+}
+
+HapDecodeStats HapDecodeEngine::getStats() const {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	HapDecodeStats stats = m_stats;
+	stats.threads = m_pool.getNumThreads();
+	return stats;
+}
+
+void HapDecodeEngine::resetStats() {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_client.resetStats();
+}
@@ -0,0 +1,76 @@
+// HapDecodeEngine - decodes the chunks of a HAP frame in parallel
+//
+// Portable. Encoders split large frames into independently compressed chunks, each one is
+// decompressed by a worker straight to its offset in the destination frame. The calling
+// thread decodes chunks too while it waits, so a pool with 0 workers means plain serial decoding.
+// Engines submit to DXTThreadPool::shared() unless given a pool, each one as its own client.
+
+#pragma once
+
+#include <mutex>
+
+#include "HapDecoder.h"
+#include "DXTThreadPool.h"
+
+struct HapDecodeStats {
+	uint64_t frames;			// frames decoded successfully
+	uint64_t failures;			// corrupt or unsupported frames
+	uint64_t chunks;			// chunks decoded in total
+	int threads;				// worker threads besides the decoding thread
+	double lastDecodeMicros;	// wall clock time of the last frame, parsing included
+	double averageDecodeMicros;
+	double maxDecodeMicros;
+};
+
+class HapDecodeEngine;
+
+// one frame decoded in the background, src and dst must stay valid until it is done
+struct HapDecodeRequest {
+	const unsigned char * src;
+	size_t srcSize;
+	unsigned char * dst;
+	size_t dstCapacity;
+	HapFrameInfo info;
+	HapResult result;
+	HapDecodeEngine * engine;
+	DXTTaskGroup group;
+};
+
+class HapDecodeEngine {
+
+public:
+
+	HapDecodeEngine(DXTThreadPool & pool = DXTThreadPool::shared());
+	~HapDecodeEngine();
+
+	DXTThreadPool & getPool() { return m_pool; }
+
+	// which engine's work the shared workers pick first
+	void setPriority(DXTTaskPriority priority) { m_client.setPriority(priority); }
+	DXTTaskPriority getPriority() const { return m_client.getPriority(); }
+	DXTTaskClientStats getSchedulingStats() const { return m_client.getStats(); }
+
+	// same contract as HapDecoder::decodeFrame, may be called from several threads at once
+	HapResult decode(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, HapFrameInfo & info);
+
+	// queues the request to a worker and returns right away
+	void decodeAsync(HapDecodeRequest & request);
+	bool isDone(const HapDecodeRequest & request) const { return request.group.isDone(); }
+	// helps the workers until the request has been decoded
+	HapResult wait(HapDecodeRequest & request);
+
+	HapDecodeStats getStats() const;
+	void resetStats();
+
+private:
+
+	static void decodeChunkTask(void * arg, int index);
+	static void decodeRequestTask(void * arg, int index);
+	void frameDecoded(HapResult result, size_t chunks, double micros);
+
+	DXTThreadPool & m_pool;
+	DXTTaskClient m_client;
+
+	mutable std::mutex m_statsMutex;
+	HapDecodeStats m_stats;
+};
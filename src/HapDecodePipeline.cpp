@@ -0,0 +1,101 @@
+#include "HapDecodePipeline.h"
+
+#include <chrono>
+#include <string.h>
+
+HapDecodePipeline::HapDecodePipeline(HapDecodeEngine & engine)
+	: m_engine(engine) {
+	m_depth = 1;
+	resetStats();
+}
+
+HapDecodePipeline::~HapDecodePipeline() {
+	// frames still in flight are written to by workers, their owners have to drain us first
+	while (!m_inFlight.empty()) {
+		waitOldest();
+		pop();
+	}
+	for (size_t i = 0; i < m_free.size(); i++) {
+		delete m_free[i];
+	}
+}
+
+void HapDecodePipeline::setDepth(int depth) {
+	m_depth = depth > 1 ? depth : 1;
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.depth = m_depth;
+}
+
+HapPipelineFrame * HapDecodePipeline::push(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, void * srcOwner, void * dstOwner) {
+	HapPipelineFrame * frame;
+	if (m_free.empty()) {
+		frame = new HapPipelineFrame();
+	}
+	else {
+		frame = m_free.back();
+		m_free.pop_back();
+	}
+
+	frame->request.src = src;
+	frame->request.srcSize = srcSize;
+	frame->request.dst = dst;
+	frame->request.dstCapacity = dstCapacity;
+	frame->srcOwner = srcOwner;
+	frame->dstOwner = dstOwner;
+
+	m_inFlight.push_back(frame);
+	m_engine.decodeAsync(frame->request);
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	int occupancy = (int)m_inFlight.size();
+	m_stats.framesQueued++;
+	m_stats.occupancy = occupancy;
+	if (occupancy > m_stats.maxOccupancy) m_stats.maxOccupancy = occupancy;
+	m_stats.averageOccupancy += (occupancy - m_stats.averageOccupancy) / m_stats.framesQueued;
+	return frame;
+}
+
+HapPipelineFrame * HapDecodePipeline::peekCompleted() {
+	if (m_inFlight.empty() || !m_engine.isDone(m_inFlight.front()->request)) return NULL;
+	return m_inFlight.front();
+}
+
+HapPipelineFrame * HapDecodePipeline::waitOldest() {
+	if (m_inFlight.empty()) return NULL;
+
+	HapPipelineFrame * frame = m_inFlight.front();
+	if (!m_engine.isDone(frame->request)) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		m_engine.wait(frame->request);
+		double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_stats.stalls++;
+		m_stats.stallMicros += micros;
+	}
+	return frame;
+}
+
+void HapDecodePipeline::pop() {
+	if (m_inFlight.empty()) return;
+
+	m_free.push_back(m_inFlight.front());
+	m_inFlight.pop_front();
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.framesCompleted++;
+	m_stats.occupancy = (int)m_inFlight.size();
+}
+
+HapPipelineStats HapDecodePipeline::getStats() const {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+void HapDecodePipeline::resetStats() {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.depth = m_depth;
+	m_stats.occupancy = (int)m_inFlight.size();
+}
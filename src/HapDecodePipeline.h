@@ -0,0 +1,69 @@
+// HapDecodePipeline - keeps several HAP frames decoding ahead and hands them back in order
+//
+// Portable. Frames are queued in stream order and decoded on the engine's workers at the same
+// time, so even single chunk frames use more than one core. Decodes may finish in any order,
+// the queue only ever returns its oldest frame. All methods except getStats() belong to one
+// thread (the streaming thread).
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "HapDecodeEngine.h"
+
+struct HapPipelineFrame {
+	HapDecodeRequest request;
+	void * srcOwner;	// whatever keeps src and dst alive, e.g. the media samples
+	void * dstOwner;
+};
+
+struct HapPipelineStats {
+	int depth;					// frames allowed in flight
+	int occupancy;				// frames in flight right now
+	int maxOccupancy;
+	double averageOccupancy;	// frames in flight when a new one was queued
+	uint64_t framesQueued;
+	uint64_t framesCompleted;
+	uint64_t stalls;			// times the oldest frame was needed before its decode had finished
+	double stallMicros;			// total time spent waiting in those stalls
+};
+
+class HapDecodePipeline {
+
+public:
+
+	HapDecodePipeline(HapDecodeEngine & engine);
+	~HapDecodePipeline();
+
+	// 1 = no decode ahead
+	void setDepth(int depth);
+	int getDepth() const { return m_depth; }
+
+	bool isEmpty() const { return m_inFlight.empty(); }
+	bool isFull() const { return (int)m_inFlight.size() >= m_depth; }
+
+	// starts decoding a frame right away, the pipeline must not be full
+	HapPipelineFrame * push(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, void * srcOwner, void * dstOwner);
+
+	// the oldest frame if it is decoded, NULL otherwise
+	HapPipelineFrame * peekCompleted();
+	// the oldest frame, waits for its decode if necessary, NULL if empty
+	HapPipelineFrame * waitOldest();
+	// done with the oldest frame
+	void pop();
+
+	HapPipelineStats getStats() const;
+	void resetStats();
+
+private:
+
+	HapDecodeEngine & m_engine;
+	int m_depth;
+	std::deque<HapPipelineFrame *> m_inFlight;
+	std::vector<HapPipelineFrame *> m_free;
+
+	mutable std::mutex m_statsMutex;
+	HapPipelineStats m_stats;
+};
@@ -0,0 +1,280 @@
+#include "HapDecoder.h"
+
+#include <string.h>
+
+// top level section types: high nibble is the second-stage compressor, low nibble the texture format
+#define HAP_FORMAT_RGB_DXT1 0x0B
+#define HAP_FORMAT_RGBA_DXT5 0x0E
+#define HAP_FORMAT_YCOCG_DXT5 0x0F
+
+// sections inside a complex frame
+#define HAP_SECTION_DECODE_INSTRUCTIONS 0x01
+#define HAP_SECTION_CHUNK_COMPRESSORS 0x02
+#define HAP_SECTION_CHUNK_SIZES 0x03
+#define HAP_SECTION_CHUNK_OFFSETS 0x04
+
+static uint32_t readLE32(const unsigned char * p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// a section header is a 3 byte size and a type, or 3 zero bytes, the type and a 4 byte size
+static bool readSectionHeader(const unsigned char * src, size_t srcSize, size_t & headerSize, size_t & sectionSize, int & sectionType) {
+	if (srcSize < 4) return false;
+
+	sectionSize = (size_t)src[0] | ((size_t)src[1] << 8) | ((size_t)src[2] << 16);
+	sectionType = src[3];
+	headerSize = 4;
+
+	if (sectionSize == 0) {
+		if (srcSize < 8) return false;
+		sectionSize = readLE32(src + 4);
+		headerSize = 8;
+	}
+
+	return sectionSize <= srcSize - headerSize;
+}
+
+static bool textureFormatFromType(int sectionType, DXTTextureFormat & format) {
+	switch (sectionType & 0x0F) {
+	case HAP_FORMAT_RGB_DXT1: format = TextureFormat_RGB_DXT1; return true;
+	case HAP_FORMAT_RGBA_DXT5: format = TextureFormat_RGBA_DXT5; return true;
+	case HAP_FORMAT_YCOCG_DXT5: format = TextureFormat_YCoCg_DXT5; return true;
+	}
+	return false;
+}
+
+static HapResult addChunk(HapFrameInfo & info, const unsigned char * data, size_t size, int compressor) {
+	HapChunk chunk;
+	chunk.data = data;
+	chunk.size = size;
+	chunk.compressor = compressor;
+	chunk.outputOffset = info.outputSize;
+
+	if (compressor == HapCompressor_None) {
+		chunk.outputSize = size;
+	}
+	else if (compressor == HapCompressor_Snappy) {
+		if (!HapDecoder::snappyGetUncompressedLength(data, size, chunk.outputSize)) return HapResult_BadFrame;
+	}
+	else {
+		return HapResult_UnsupportedFormat;
+	}
+
+	info.outputSize += chunk.outputSize;
+	info.chunks.push_back(chunk);
+	return HapResult_OK;
+}
+
+static HapResult parseComplexFrame(const unsigned char * src, size_t srcSize, HapFrameInfo & info) {
+	size_t headerSize, containerSize;
+	int sectionType;
+	if (!readSectionHeader(src, srcSize, headerSize, containerSize, sectionType) ||
+		sectionType != HAP_SECTION_DECODE_INSTRUCTIONS) {
+		return HapResult_BadFrame;
+	}
+
+	const unsigned char * compressors = NULL;
+	const unsigned char * sizes = NULL;
+	const unsigned char * offsets = NULL;
+	size_t chunkCount = 0;
+	size_t sizeCount = 0;
+	size_t offsetCount = 0;
+
+	// walk the sections of the decode instructions container, unknown ones are skipped
+	const unsigned char * section = src + headerSize;
+	size_t remaining = containerSize;
+	while (remaining > 0) {
+		size_t sectionHeaderSize, sectionSize;
+		if (!readSectionHeader(section, remaining, sectionHeaderSize, sectionSize, sectionType)) return HapResult_BadFrame;
+
+		const unsigned char * sectionData = section + sectionHeaderSize;
+		if (sectionType == HAP_SECTION_CHUNK_COMPRESSORS) {
+			compressors = sectionData;
+			chunkCount = sectionSize;
+		}
+		else if (sectionType == HAP_SECTION_CHUNK_SIZES) {
+			sizes = sectionData;
+			sizeCount = sectionSize / 4;
+		}
+		else if (sectionType == HAP_SECTION_CHUNK_OFFSETS) {
+			offsets = sectionData;
+			offsetCount = sectionSize / 4;
+		}
+
+		section += sectionHeaderSize + sectionSize;
+		remaining -= sectionHeaderSize + sectionSize;
+	}
+
+	if (!compressors || !sizes || chunkCount == 0 || sizeCount != chunkCount) return HapResult_BadFrame;
+	if (offsets && offsetCount != chunkCount) return HapResult_BadFrame;
+
+	// chunk data follows the decode instructions
+	const unsigned char * frameData = src + headerSize + containerSize;
+	size_t frameDataSize = srcSize - headerSize - containerSize;
+
+	info.chunks.reserve(chunkCount);
+	size_t runningOffset = 0;
+	for (size_t i = 0; i < chunkCount; i++) {
+		size_t chunkSize = readLE32(sizes + i * 4);
+		size_t chunkOffset = offsets ? readLE32(offsets + i * 4) : runningOffset;
+		if (chunkOffset > frameDataSize || chunkSize > frameDataSize - chunkOffset) return HapResult_BadFrame;
+
+		HapResult result = addChunk(info, frameData + chunkOffset, chunkSize, compressors[i]);
+		if (result != HapResult_OK) return result;
+
+		runningOffset = chunkOffset + chunkSize;
+	}
+
+	return HapResult_OK;
+}
+
+HapResult HapDecoder::parseFrame(const unsigned char * src, size_t srcSize, HapFrameInfo & info) {
+	info.outputSize = 0;
+	info.chunks.clear();
+
+	if (!src) return HapResult_BadArguments;
+
+	size_t headerSize, sectionSize;
+	int sectionType;
+	if (!readSectionHeader(src, srcSize, headerSize, sectionSize, sectionType)) return HapResult_BadFrame;
+	if (!textureFormatFromType(sectionType, info.textureFormat)) return HapResult_UnsupportedFormat;
+
+	const unsigned char * payload = src + headerSize;
+	int compressor = sectionType >> 4;
+
+	if (compressor == HapCompressor_Complex) {
+		return parseComplexFrame(payload, sectionSize, info);
+	}
+	return addChunk(info, payload, sectionSize, compressor);
+}
+
+HapResult HapDecoder::decodeChunk(const HapChunk & chunk, unsigned char * dst) {
+	if (!dst) return HapResult_BadArguments;
+
+	if (chunk.compressor == HapCompressor_None) {
+		memcpy(dst + chunk.outputOffset, chunk.data, chunk.size);
+		return HapResult_OK;
+	}
+	if (chunk.compressor == HapCompressor_Snappy) {
+		return snappyDecompress(chunk.data, chunk.size, dst + chunk.outputOffset, chunk.outputSize) ? HapResult_OK : HapResult_BadFrame;
+	}
+	return HapResult_UnsupportedFormat;
+}
+
+HapResult HapDecoder::decodeFrame(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, HapFrameInfo & info) {
+	HapResult result = parseFrame(src, srcSize, info);
+	if (result != HapResult_OK) return result;
+	if (info.outputSize > dstCapacity) return HapResult_BufferTooSmall;
+
+	for (size_t i = 0; i < info.chunks.size(); i++) {
+		result = decodeChunk(info.chunks[i], dst);
+		if (result != HapResult_OK) return result;
+	}
+	return HapResult_OK;
+}
+
+HapResult HapDecoder::getTextureFormat(const unsigned char * src, size_t srcSize, DXTTextureFormat & format) {
+	if (!src || srcSize < 4) return HapResult_BadArguments;
+	return textureFormatFromType(src[3], format) ? HapResult_OK : HapResult_UnsupportedFormat;
+}
+
+const char * HapDecoder::getResultString(HapResult result) {
+	switch (result) {
+	case HapResult_OK: return "OK";
+	case HapResult_BadArguments: return "bad arguments";
+	case HapResult_BadFrame: return "corrupt frame";
+	case HapResult_BufferTooSmall: return "output buffer too small";
+	case HapResult_UnsupportedFormat: return "unsupported HAP format";
+	}
+	return "unknown error";
+}
+
+//////////////////////////////////// Snappy ////////////////////////////////////
+
+bool HapDecoder::snappyGetUncompressedLength(const unsigned char * src, size_t srcSize, size_t & length) {
+	// little endian base 128 varint, at most 5 bytes for 32 bits
+	uint32_t value = 0;
+	for (size_t i = 0; i < srcSize && i < 5; i++) {
+		value |= (uint32_t)(src[i] & 0x7F) << (7 * i);
+		if (!(src[i] & 0x80)) {
+			length = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HapDecoder::snappyDecompress(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstSize) {
+	size_t length;
+	if (!snappyGetUncompressedLength(src, srcSize, length) || length != dstSize) return false;
+
+	size_t ip = 0;
+	while (src[ip++] & 0x80);
+
+	size_t op = 0;
+	while (ip < srcSize) {
+		unsigned char tag = src[ip++];
+		size_t len, offset;
+
+		switch (tag & 3) {
+
+		case 0: // literal
+			len = tag >> 2;
+			if (len >= 60) {
+				size_t extraBytes = len - 59;
+				if (srcSize - ip < extraBytes) return false;
+				len = 0;
+				for (size_t i = 0; i < extraBytes; i++) len |= (size_t)src[ip + i] << (8 * i);
+				ip += extraBytes;
+			}
+			len += 1;
+			if (srcSize - ip < len || dstSize - op < len) return false;
+			memcpy(dst + op, src + ip, len);
+			ip += len;
+			op += len;
+			continue;
+
+		case 1: // copy with 1 byte offset
+			if (srcSize - ip < 1) return false;
+			len = 4 + ((tag >> 2) & 7);
+			offset = ((size_t)(tag >> 5) << 8) | src[ip];
+			ip += 1;
+			break;
+
+		case 2: // copy with 2 byte offset
+			if (srcSize - ip < 2) return false;
+			len = (tag >> 2) + 1;
+			offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+			ip += 2;
+			break;
+
+		default: // copy with 4 byte offset
+			if (srcSize - ip < 4) return false;
+			len = (tag >> 2) + 1;
+			offset = readLE32(src + ip);
+			ip += 4;
+			break;
+		}
+
+		if (offset == 0 || offset > op || dstSize - op < len) return false;
+
+		unsigned char * out = dst + op;
+		const unsigned char * from = out - offset;
+		if (offset >= len) {
+			memcpy(out, from, len);
+		}
+		else if (offset >= 8) {
+			// overlapping, but every 8 byte step only reads bytes that are already written
+			size_t i = 0;
+			for (; i + 8 <= len; i += 8) memcpy(out + i, from + i, 8);
+			for (; i < len; i++) out[i] = from[i];
+		}
+		else {
+			// short repeating pattern (e.g. run of identical DXT blocks bytes)
+			for (size_t i = 0; i < len; i++) out[i] = from[i];
+		}
+		op += len;
+	}
+
+	return op == dstSize;
+}
@@ -0,0 +1,66 @@
+// HapDecoder - turns HAP frames into DXT texture data
+//
+// Portable (no Windows/DirectShow dependencies). Parses the HAP section headers,
+// including "complex" frames that are split into independently compressed chunks
+// (decode instructions, chunk second-stage compressor table, chunk size and offset
+// tables), and undoes the Snappy second-stage compression.
+// See https://github.com/Vidvox/hap/blob/master/documentation/HapVideoDRAFT.md
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "DXTShared.h"
+
+enum HapResult {
+	HapResult_OK = 0,
+	HapResult_BadArguments,
+	HapResult_BadFrame,
+	HapResult_BufferTooSmall,
+	HapResult_UnsupportedFormat
+};
+
+enum HapCompressor {
+	HapCompressor_None = 0x0A,
+	HapCompressor_Snappy = 0x0B,
+	HapCompressor_Complex = 0x0C
+};
+
+struct HapChunk {
+	const unsigned char * data;	// second-stage compressed bytes inside the frame
+	size_t size;
+	int compressor;				// HapCompressor_None or HapCompressor_Snappy
+	size_t outputOffset;		// where the chunk's DXT data goes in the output frame
+	size_t outputSize;
+};
+
+struct HapFrameInfo {
+	DXTTextureFormat textureFormat;
+	size_t outputSize;			// bytes of DXT data the whole frame decodes to
+	std::vector<HapChunk> chunks;
+};
+
+class HapDecoder {
+
+public:
+
+	// reads headers and chunk tables only, no decompression
+	static HapResult parseFrame(const unsigned char * src, size_t srcSize, HapFrameInfo & info);
+
+	// decompresses one chunk of a parsed frame into its place in dst (the start of the output frame)
+	static HapResult decodeChunk(const HapChunk & chunk, unsigned char * dst);
+
+	// parse and decode a whole frame on the calling thread
+	static HapResult decodeFrame(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstCapacity, HapFrameInfo & info);
+
+	// texture format of a HAP frame from its first section header, without parsing the rest
+	static HapResult getTextureFormat(const unsigned char * src, size_t srcSize, DXTTextureFormat & format);
+
+	static const char * getResultString(HapResult result);
+
+	// Snappy raw format (https://github.com/google/snappy/blob/master/format_description.txt)
+	static bool snappyGetUncompressedLength(const unsigned char * src, size_t srcSize, size_t & length);
+	static bool snappyDecompress(const unsigned char * src, size_t srcSize, unsigned char * dst, size_t dstSize);
+};
@@ -0,0 +1,39 @@
+#include "HapDemuxer.h"
+#include "HapMovDemuxer.h"
+#include "HapAviDemuxer.h"
+#include "HapMkvDemuxer.h"
+
+HapDemuxResult HapDemuxer::buildIndex(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool) {
+	index.clear();
+
+	unsigned char header[16];
+	size_t headerSize = file.getSize() < sizeof(header) ? (size_t)file.getSize() : sizeof(header);
+	if (!file.read(0, header, headerSize)) return HapDemuxResult_ReadError;
+
+	HapDemuxResult result = HapDemuxResult_UnknownContainer;
+	if (HapMovDemuxer::isMovFile(header, headerSize)) {
+		result = HapMovDemuxer::buildIndex(file, index);
+	}
+	else if (HapAviDemuxer::isAviFile(header, headerSize)) {
+		result = HapAviDemuxer::buildIndex(file, index);
+	}
+	else if (HapMkvDemuxer::isMkvFile(header, headerSize)) {
+		result = HapMkvDemuxer::buildIndex(file, index, pool);
+	}
+
+	// once here, a sidecar stores it so loading one doesn't touch every entry
+	if (result == HapDemuxResult_OK) index.updateMaxFrameSize();
+	return result;
+}
+
+const char * HapDemuxer::getResultString(HapDemuxResult result) {
+	switch (result) {
+	case HapDemuxResult_OK: return "OK";
+	case HapDemuxResult_UnknownContainer: return "unknown container";
+	case HapDemuxResult_BadFile: return "damaged or unsupported file";
+	case HapDemuxResult_NoHapTrack: return "no Hap1, Hap5 or HapY video track";
+	case HapDemuxResult_ReadError: return "read error";
+	case HapDemuxResult_OpenError: return "can't open file";
+	}
+	return "unknown error";
+}
@@ -0,0 +1,29 @@
+// HapDemuxer - builds a HapFrameIndex for a HAP movie without a splitter
+//
+// Portable. Picks the container reader from the first bytes of the file.
+
+#pragma once
+
+#include "HapFrameIndex.h"
+#include "HapMediaFile.h"
+
+class DXTThreadPool;
+
+enum HapDemuxResult {
+	HapDemuxResult_OK = 0,
+	HapDemuxResult_UnknownContainer,
+	HapDemuxResult_BadFile,
+	HapDemuxResult_NoHapTrack,
+	HapDemuxResult_ReadError,
+	HapDemuxResult_OpenError
+};
+
+class HapDemuxer {
+
+public:
+
+	// pool is used by readers that can split their work, NULL does it all on the calling thread
+	static HapDemuxResult buildIndex(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool = NULL);
+
+	static const char * getResultString(HapDemuxResult result);
+};
@@ -0,0 +1,82 @@
+#include "HapFrameIndex.h"
+#include "HapMediaFile.h"
+
+void HapFrameIndex::clear() {
+	codec = 0;
+	width = 0;
+	height = 0;
+	duration = 0;
+	frameDuration = 0;
+	maxFrameSize = 0;
+	frames.clear();
+	m_mappedView.reset();
+	m_mappedFrames = NULL;
+	m_numMappedFrames = 0;
+
+	audio.bPresent = false;
+	audio.bPCM = false;
+	audio.codec = 0;
+	audio.channels = 0;
+	audio.sampleRate = 0;
+	audio.bitsPerSample = 0;
+	audio.bFloat = false;
+	audio.bBigEndian = false;
+	audio.chunks.clear();
+}
+
+bool HapFrameIndex::getTextureFormat(DXTTextureFormat & format) const {
+	switch (codec) {
+	case HAP_CODEC_HAP1: format = TextureFormat_RGB_DXT1; return true;
+	case HAP_CODEC_HAP5: format = TextureFormat_RGBA_DXT5; return true;
+	case HAP_CODEC_HAPY: format = TextureFormat_YCoCg_DXT5; return true;
+	}
+	return false;
+}
+
+void HapFrameIndex::updateMaxFrameSize() {
+	const HapIndexEntry * entries = getFrames();
+	maxFrameSize = 0;
+	for (int i = 0; i < getFrameCount(); i++) {
+		if (entries[i].size > maxFrameSize) maxFrameSize = entries[i].size;
+	}
+}
+
+int HapFrameIndex::findFrame(int64_t time) const {
+	const HapIndexEntry * entries = getFrames();
+	if (getFrameCount() == 0 || time <= entries[0].time) return 0;
+
+	// times only grow, binary search for the last frame starting at or before time
+	size_t lo = 0;
+	size_t hi = getFrameCount();
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (entries[mid].time <= time) lo = mid;
+		else hi = mid;
+	}
+	return (int)lo;
+}
+
+int64_t HapFrameIndex::getFrameTime(int frame) const {
+	if (frame < 0 || getFrameCount() == 0) return 0;
+	if (frame >= getFrameCount()) return duration;
+	return getFrames()[frame].time;
+}
+
+int64_t HapFrameIndex::getFrameStopTime(int frame) const {
+	if (frame + 1 < getFrameCount()) return getFrameTime(frame + 1);
+	return duration > getFrameTime(frame) ? duration : getFrameTime(frame) + frameDuration;
+}
+
+bool HapFrameIndex::readFrame(const HapMediaFile & file, int frame, void * dst, size_t capacity) const {
+	if (frame < 0 || frame >= getFrameCount()) return false;
+	const HapIndexEntry & entry = getFrames()[frame];
+	if (entry.size > capacity) return false;
+	return file.read(entry.offset, dst, entry.size);
+}
+
+void HapFrameIndex::setMappedFrames(const std::shared_ptr<HapFileView> & view, const HapIndexEntry * entries, size_t count) {
+	frames.clear();
+	m_mappedView = view;
+	m_mappedFrames = entries;
+	m_numMappedFrames = count;
+}
@@ -0,0 +1,83 @@
+// HapFrameIndex - where every frame of a HAP movie is, built from the container's tables
+//
+// Portable. HAP frames are all keyframes, so with offset, size and time of each frame
+// reading frame N is a single read, no matter where the last one was.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "DXTShared.h"
+
+class HapMediaFile;
+class HapFileView;
+
+// first character in the lowest byte, like Windows' MAKEFOURCC
+#define HAP_FOURCC(a, b, c, d) ((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+#define HAP_CODEC_HAP1 HAP_FOURCC('H', 'a', 'p', '1')
+#define HAP_CODEC_HAP5 HAP_FOURCC('H', 'a', 'p', '5')
+#define HAP_CODEC_HAPY HAP_FOURCC('H', 'a', 'p', 'Y')
+
+struct HapIndexEntry {
+	uint64_t offset;	// in the file
+	uint32_t size;
+	int64_t time;		// presentation time in 100 ns units
+};
+
+struct HapAudioTrack {
+	bool bPresent;			// the file has an audio track, indexed or not
+	bool bPCM;				// uncompressed, chunks below are filled
+	uint32_t codec;
+	int channels;
+	int sampleRate;
+	int bitsPerSample;
+	bool bFloat;
+	bool bBigEndian;
+	std::vector<HapIndexEntry> chunks;	// as stored, each holds whole sample frames
+};
+
+struct HapFrameIndex {
+
+	HapFrameIndex() { clear(); }
+	void clear();
+
+	bool getTextureFormat(DXTTextureFormat & format) const;
+	int getFrameCount() const { return m_mappedFrames ? (int)m_numMappedFrames : (int)frames.size(); }
+	const HapIndexEntry & getFrame(int frame) const { return getFrames()[frame]; }
+	uint32_t getMaxFrameSize() const { return maxFrameSize; }
+	// walks the frames once, the demuxers call it when they're done
+	void updateMaxFrameSize();
+
+	// the frame showing at time, i.e. the last one starting at or before it
+	int findFrame(int64_t time) const;
+	int64_t getFrameTime(int frame) const;
+	int64_t getFrameStopTime(int frame) const;
+
+	bool readFrame(const HapMediaFile & file, int frame, void * dst, size_t capacity) const;
+
+	uint32_t codec;			// HAP_CODEC_*
+	int width;
+	int height;
+	int64_t duration;		// 100 ns units
+	int64_t frameDuration;	// average
+	uint32_t maxFrameSize;	// bytes of the largest frame
+	std::vector<HapIndexEntry> frames;	// as built by the demuxers, empty while mapped
+
+	HapAudioTrack audio;
+
+	// use frames that live in a mapped file (a sidecar, see HapIndexCache) instead of frames
+	void setMappedFrames(const std::shared_ptr<HapFileView> & view, const HapIndexEntry * entries, size_t count);
+	bool isMapped() const { return m_mappedFrames != NULL; }
+
+private:
+
+	const HapIndexEntry * getFrames() const { return m_mappedFrames ? m_mappedFrames : frames.data(); }
+
+	std::shared_ptr<HapFileView> m_mappedView;
+	const HapIndexEntry * m_mappedFrames;
+	size_t m_numMappedFrames;
+};
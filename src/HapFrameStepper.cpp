@@ -0,0 +1,64 @@
+#include "HapFrameStepper.h"
+
+#include "HapFrameIndex.h"
+
+HapFrameStepper::HapFrameStepper() {
+	m_rate = 1.0;
+	m_refreshInterval = 0;
+	m_segmentStart = 0;
+	m_bStarted = false;
+	m_lastStop = 0;
+	m_nextRefresh = 0;
+}
+
+void HapFrameStepper::setRate(double rate) {
+	m_rate = rate > 0.0 ? rate : 1.0;
+}
+
+void HapFrameStepper::setRefreshInterval(int64_t interval) {
+	m_refreshInterval = interval > 0 ? interval : 0;
+}
+
+void HapFrameStepper::restart(int64_t segmentStart) {
+	m_segmentStart = segmentStart;
+	m_bStarted = false;
+}
+
+bool HapFrameStepper::next(HapPlayhead & playhead, const HapFrameIndex & index, HapFrameStep & step) {
+	step.skipped = 0;
+	step.bWrapped = false;
+
+	for (;;) {
+		bool bWrapped = false;
+		int frame = playhead.next(&bWrapped);
+		if (frame < 0) return false;
+		if (bWrapped) step.bWrapped = true;
+
+		// every frame starts where the one before stopped, skipped ones included
+		int64_t duration = index.getFrameStopTime(frame) - index.getFrameTime(frame);
+		int64_t start = m_bStarted ? m_lastStop : (int64_t)((index.getFrameTime(frame) - m_segmentStart) / m_rate);
+		int64_t stop = start + (int64_t)(duration / m_rate);
+		if (!m_bStarted) m_nextRefresh = start;
+		m_bStarted = true;
+		m_lastStop = stop;
+
+		// over before the next refresh, nobody would see it
+		if (m_refreshInterval > 0 && stop > start && stop <= m_nextRefresh && step.skipped < playhead.getFrameCount()) {
+			HapPlayhead ahead = playhead;
+			if (ahead.next() >= 0) {
+				step.skipped++;
+				continue;
+			}
+		}
+
+		// the refreshes while it lasts show this frame
+		if (m_refreshInterval > 0 && m_nextRefresh < stop) {
+			m_nextRefresh += (stop - m_nextRefresh + m_refreshInterval - 1) / m_refreshInterval * m_refreshInterval;
+		}
+
+		step.frame = frame;
+		step.start = start;
+		step.stop = stop;
+		return true;
+	}
+}
@@ -0,0 +1,55 @@
+// HapFrameStepper - times the frames a playhead delivers and skips the ones no display refresh would show
+//
+// Portable. Frames follow each other on one continuous timeline in stream time (100 ns units),
+// across loops, turns and speed changes, each lasting its duration divided by the rate. With a
+// refresh interval set, a frame that ends before the next refresh is due is stepped over
+// without being read or decoded, and its time goes to the timeline all the same, so at high
+// speeds only about one frame per refresh costs anything. The last frame of a clip that
+// doesn't loop is never skipped. Copies are cheap, stepping a copy together with a copy of
+// the playhead tells which frames will be delivered next.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "HapPlayhead.h"
+
+struct HapFrameIndex;
+
+struct HapFrameStep {
+	int frame;
+	int64_t start;			// stream time
+	int64_t stop;
+	int skipped;			// frames stepped over before this one
+	bool bWrapped;			// a loop restarted or a palindrome turned on the way
+};
+
+class HapFrameStepper {
+
+public:
+
+	HapFrameStepper();
+
+	// media time per stream time, the graph's rate times the speed
+	void setRate(double rate);
+	double getRate() const { return m_rate; }
+
+	// stream time between display refreshes, 0 = deliver every frame
+	void setRefreshInterval(int64_t interval);
+	int64_t getRefreshInterval() const { return m_refreshInterval; }
+
+	// the next frame is timed from its media time relative to segmentStart, e.g. after a seek
+	void restart(int64_t segmentStart);
+
+	// false at the end of a clip that doesn't loop
+	bool next(HapPlayhead & playhead, const HapFrameIndex & index, HapFrameStep & step);
+
+private:
+
+	double m_rate;
+	int64_t m_refreshInterval;
+	int64_t m_segmentStart;
+	bool m_bStarted;		// a frame was delivered since the restart
+	int64_t m_lastStop;		// where the next frame starts
+	int64_t m_nextRefresh;	// the first refresh after the last delivered frame
+};
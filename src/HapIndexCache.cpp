@@ -0,0 +1,311 @@
+// 64 bit off_t on 32 bit POSIX builds, before anything pulls in the system headers
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "HapIndexCache.h"
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+#define HAP_INDEX_CACHE_MAGIC HAP_FOURCC('H', 'I', 'D', 'X')
+#define HAP_INDEX_CACHE_VERSION 1
+
+#define HAP_INDEX_CACHE_AUDIO_PRESENT	0x01
+#define HAP_INDEX_CACHE_AUDIO_PCM		0x02
+#define HAP_INDEX_CACHE_AUDIO_FLOAT		0x04
+#define HAP_INDEX_CACHE_AUDIO_BIGENDIAN	0x08
+
+// written as is, so sidecars are only shared between little endian builds
+struct HapIndexCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t clipSize;
+	int64_t clipModifiedTime;
+	uint32_t codec;
+	int32_t width;
+	int32_t height;
+	uint32_t maxFrameSize;
+	int64_t duration;
+	int64_t frameDuration;
+	uint64_t frameCount;
+	uint64_t framesOffset;		// from the start of the sidecar
+	uint32_t audioFlags;
+	uint32_t audioCodec;
+	int32_t audioChannels;
+	int32_t audioSampleRate;
+	int32_t audioBitsPerSample;
+	uint32_t reserved;
+	uint64_t audioChunkCount;
+	uint64_t audioChunksOffset;
+};
+
+static_assert(sizeof(HapIndexEntry) == 24, "sidecar entries are HapIndexEntry as laid out in memory");
+static_assert(sizeof(HapIndexCacheHeader) == 112, "sidecar header layout changed, bump HAP_INDEX_CACHE_VERSION");
+
+// entries start 8 byte aligned so the mapped array can be used in place
+static const uint64_t FRAMES_OFFSET = 128;
+
+static std::atomic<bool> s_bEnabled(true);
+static std::mutex s_directoryMutex;
+static std::string s_directory;
+
+static bool isValidCodec(uint32_t codec) {
+	return codec == HAP_CODEC_HAP1 || codec == HAP_CODEC_HAP5 || codec == HAP_CODEC_HAPY;
+}
+
+// FNV-1a, only to give sidecars of same named clips in one cache directory different names
+static uint64_t hashString(const std::string & s) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < s.size(); i++) {
+		hash ^= (unsigned char)s[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static std::string toHex(uint64_t value) {
+	static const char digits[] = "0123456789abcdef";
+	char text[17];
+	for (int i = 15; i >= 0; i--) {
+		text[i] = digits[value & 15];
+		value >>= 4;
+	}
+	text[16] = 0;
+	return text;
+}
+
+static bool writeWholeFile(const std::string & path, const void * data, size_t size) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+	const unsigned char * p = (const unsigned char*)data;
+	bool bOK = true;
+	while (bOK && size > 0) {
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+		DWORD written = 0;
+		bOK = WriteFile(handle, p, chunk, &written, NULL) && written == chunk;
+		p += chunk;
+		size -= chunk;
+	}
+	if (!CloseHandle(handle)) bOK = false;
+	return bOK;
+#else
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+	const unsigned char * p = (const unsigned char*)data;
+	bool bOK = true;
+	while (bOK && size > 0) {
+		ssize_t written = ::write(fd, p, size);
+		if (written < 0 && errno == EINTR) continue;
+		bOK = written > 0;
+		if (bOK) {
+			p += written;
+			size -= written;
+		}
+	}
+	if (::close(fd) != 0) bOK = false;
+	return bOK;
+#endif
+}
+
+static bool replaceFile(const std::string & from, const std::string & to) {
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void removeFile(const std::string & path) {
+#ifdef _WIN32
+	DeleteFileA(path.c_str());
+#else
+	::unlink(path.c_str());
+#endif
+}
+
+// opens the clip's sidecar and checks its header against the clip, false if there's none or it doesn't match
+static bool openSidecar(const HapMediaFile & file, HapMediaFile & sidecar, HapIndexCacheHeader & header) {
+	if (!file.isOpen()) return false;
+	if (!sidecar.open(HapIndexCache::getSidecarPath(file.getPath()))) return false;
+	if (!sidecar.read(0, &header, sizeof(header))) return false;
+
+	if (header.magic != HAP_INDEX_CACHE_MAGIC || header.version != HAP_INDEX_CACHE_VERSION) return false;
+	if (header.clipSize != file.getSize() || header.clipModifiedTime != file.getModifiedTime()) return false;
+	if (!isValidCodec(header.codec) || header.width <= 0 || header.height <= 0 || header.maxFrameSize == 0) return false;
+	if (header.frameCount == 0 || header.frameCount > 0x7fffffff || header.audioChunkCount > 0x7fffffff) return false;
+
+	uint64_t size = sidecar.getSize();
+	if (header.framesOffset % 8 != 0 || header.framesOffset > size) return false;
+	if (header.frameCount > (size - header.framesOffset) / sizeof(HapIndexEntry)) return false;
+	if (header.audioChunksOffset > size) return false;
+	if (header.audioChunkCount > (size - header.audioChunksOffset) / sizeof(HapIndexEntry)) return false;
+	return true;
+}
+
+void HapIndexCache::setEnabled(bool bEnabled) {
+	s_bEnabled = bEnabled;
+}
+
+bool HapIndexCache::isEnabled() {
+	return s_bEnabled;
+}
+
+void HapIndexCache::setDirectory(const std::string & directory) {
+	std::lock_guard<std::mutex> lock(s_directoryMutex);
+	s_directory = directory;
+}
+
+std::string HapIndexCache::getDirectory() {
+	std::lock_guard<std::mutex> lock(s_directoryMutex);
+	return s_directory;
+}
+
+std::string HapIndexCache::getSidecarPath(const std::string & clipPath) {
+	std::string directory = getDirectory();
+	if (directory.empty()) return clipPath + ".hapidx";
+
+	size_t slash = clipPath.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? clipPath : clipPath.substr(slash + 1);
+	char last = directory[directory.size() - 1];
+	if (last != '/' && last != '\\') directory += '/';
+	return directory + toHex(hashString(clipPath)) + "-" + name + ".hapidx";
+}
+
+bool HapIndexCache::readInfo(const HapMediaFile & file, HapIndexCacheInfo & info) {
+	HapMediaFile sidecar;
+	HapIndexCacheHeader header;
+	if (!openSidecar(file, sidecar, header)) return false;
+
+	info.codec = header.codec;
+	info.width = header.width;
+	info.height = header.height;
+	info.duration = header.duration;
+	info.frameDuration = header.frameDuration;
+	info.frameCount = (int)header.frameCount;
+	info.maxFrameSize = header.maxFrameSize;
+	info.bAudio = (header.audioFlags & HAP_INDEX_CACHE_AUDIO_PRESENT) != 0;
+	return true;
+}
+
+bool HapIndexCache::load(const HapMediaFile & file, HapFrameIndex & index) {
+	HapMediaFile sidecar;
+	HapIndexCacheHeader header;
+	if (!openSidecar(file, sidecar, header)) return false;
+
+	// the view outlives the sidecar's handle, the index keeps it for as long as it uses the entries
+	std::shared_ptr<HapFileView> view = std::make_shared<HapFileView>();
+	if (!sidecar.map(header.framesOffset, header.frameCount * sizeof(HapIndexEntry), *view)) return false;
+
+	std::vector<HapIndexEntry> audioChunks((size_t)header.audioChunkCount);
+	if (!audioChunks.empty() && !sidecar.read(header.audioChunksOffset, &audioChunks[0], audioChunks.size() * sizeof(HapIndexEntry))) return false;
+
+	index.clear();
+	index.codec = header.codec;
+	index.width = header.width;
+	index.height = header.height;
+	index.duration = header.duration;
+	index.frameDuration = header.frameDuration;
+	index.maxFrameSize = header.maxFrameSize;
+	index.setMappedFrames(view, (const HapIndexEntry*)view->getData(), (size_t)header.frameCount);
+
+	index.audio.bPresent = (header.audioFlags & HAP_INDEX_CACHE_AUDIO_PRESENT) != 0;
+	index.audio.bPCM = (header.audioFlags & HAP_INDEX_CACHE_AUDIO_PCM) != 0;
+	index.audio.bFloat = (header.audioFlags & HAP_INDEX_CACHE_AUDIO_FLOAT) != 0;
+	index.audio.bBigEndian = (header.audioFlags & HAP_INDEX_CACHE_AUDIO_BIGENDIAN) != 0;
+	index.audio.codec = header.audioCodec;
+	index.audio.channels = header.audioChannels;
+	index.audio.sampleRate = header.audioSampleRate;
+	index.audio.bitsPerSample = header.audioBitsPerSample;
+	index.audio.chunks.swap(audioChunks);
+	return true;
+}
+
+bool HapIndexCache::save(const HapMediaFile & file, const HapFrameIndex & index) {
+	if (!file.isOpen() || index.getFrameCount() == 0) return false;
+
+	uint64_t frameCount = (uint64_t)index.getFrameCount();
+	uint64_t audioChunkCount = index.audio.chunks.size();
+	uint64_t size = FRAMES_OFFSET + (frameCount + audioChunkCount) * sizeof(HapIndexEntry);
+	if (size > (uint64_t)SIZE_MAX) return false;
+
+	// zeroed, so the padding in the header and the entries is written as zeros
+	std::vector<unsigned char> data((size_t)size, 0);
+
+	HapIndexCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = HAP_INDEX_CACHE_MAGIC;
+	header.version = HAP_INDEX_CACHE_VERSION;
+	header.clipSize = file.getSize();
+	header.clipModifiedTime = file.getModifiedTime();
+	header.codec = index.codec;
+	header.width = index.width;
+	header.height = index.height;
+	header.maxFrameSize = index.getMaxFrameSize();
+	header.duration = index.duration;
+	header.frameDuration = index.frameDuration;
+	header.frameCount = frameCount;
+	header.framesOffset = FRAMES_OFFSET;
+	if (index.audio.bPresent) header.audioFlags |= HAP_INDEX_CACHE_AUDIO_PRESENT;
+	if (index.audio.bPCM) header.audioFlags |= HAP_INDEX_CACHE_AUDIO_PCM;
+	if (index.audio.bFloat) header.audioFlags |= HAP_INDEX_CACHE_AUDIO_FLOAT;
+	if (index.audio.bBigEndian) header.audioFlags |= HAP_INDEX_CACHE_AUDIO_BIGENDIAN;
+	header.audioCodec = index.audio.codec;
+	header.audioChannels = index.audio.channels;
+	header.audioSampleRate = index.audio.sampleRate;
+	header.audioBitsPerSample = index.audio.bitsPerSample;
+	header.audioChunkCount = audioChunkCount;
+	header.audioChunksOffset = FRAMES_OFFSET + frameCount * sizeof(HapIndexEntry);
+	memcpy(&data[0], &header, sizeof(header));
+
+	// field by field, the struct's own padding bytes are indeterminate
+	unsigned char * dst = &data[(size_t)FRAMES_OFFSET];
+	for (int i = 0; i < index.getFrameCount(); i++, dst += sizeof(HapIndexEntry)) {
+		const HapIndexEntry & entry = index.getFrame(i);
+		memcpy(dst + offsetof(HapIndexEntry, offset), &entry.offset, sizeof(entry.offset));
+		memcpy(dst + offsetof(HapIndexEntry, size), &entry.size, sizeof(entry.size));
+		memcpy(dst + offsetof(HapIndexEntry, time), &entry.time, sizeof(entry.time));
+	}
+	for (size_t i = 0; i < index.audio.chunks.size(); i++, dst += sizeof(HapIndexEntry)) {
+		const HapIndexEntry & entry = index.audio.chunks[i];
+		memcpy(dst + offsetof(HapIndexEntry, offset), &entry.offset, sizeof(entry.offset));
+		memcpy(dst + offsetof(HapIndexEntry, size), &entry.size, sizeof(entry.size));
+		memcpy(dst + offsetof(HapIndexEntry, time), &entry.time, sizeof(entry.time));
+	}
+
+	// a name of our own per process and thread, then renamed over any older sidecar in one step
+	std::string path = getSidecarPath(file.getPath());
+#ifdef _WIN32
+	uint64_t processId = GetCurrentProcessId();
+#else
+	uint64_t processId = (uint64_t)getpid();
+#endif
+	std::string tempPath = path + ".tmp" + toHex(processId ^ ((uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id()) << 20));
+
+	if (!writeWholeFile(tempPath, &data[0], data.size()) || !replaceFile(tempPath, path)) {
+		removeFile(tempPath);
+		return false;
+	}
+	return true;
+}
+
+HapDemuxResult HapIndexCache::loadOrBuild(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool) {
+	if (isEnabled() && load(file, index)) return HapDemuxResult_OK;
+
+	HapDemuxResult result = HapDemuxer::buildIndex(file, index, pool);
+	if (result == HapDemuxResult_OK && isEnabled()) save(file, index);
+	return result;
+}
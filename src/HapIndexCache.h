@@ -0,0 +1,52 @@
+// HapIndexCache - the frame index of a clip saved to a sidecar file, for instant reopening
+//
+// Portable. The first open of a clip builds its HapFrameIndex from the container and writes it
+// to <clip>.hapidx (or to a cache directory): a fixed header with the format, dimensions and
+// timing, then the frame entries exactly as they are laid out in memory. Later opens check the
+// header against the clip's size and modification time and map the entries in place, so
+// opening costs a few system calls however many frames there are. Sidecars are written to a
+// temporary name and renamed, a half written one is never read. Sidecars that can't be
+// written (read-only media) are skipped silently.
+
+#pragma once
+
+#include <string>
+
+#include "HapDemuxer.h"
+
+class DXTThreadPool;
+
+// what the header of a valid sidecar says, without mapping the frames
+struct HapIndexCacheInfo {
+	uint32_t codec;
+	int width;
+	int height;
+	int64_t duration;
+	int64_t frameDuration;
+	int frameCount;
+	uint32_t maxFrameSize;
+	bool bAudio;
+};
+
+class HapIndexCache {
+
+public:
+
+	// on by default
+	static void setEnabled(bool bEnabled);
+	static bool isEnabled();
+
+	// empty (the default) puts sidecars next to their clips, a directory must already exist
+	static void setDirectory(const std::string & directory);
+	static std::string getDirectory();
+
+	static std::string getSidecarPath(const std::string & clipPath);
+
+	// false without a sidecar or when it's stale or damaged
+	static bool readInfo(const HapMediaFile & file, HapIndexCacheInfo & info);
+	static bool load(const HapMediaFile & file, HapFrameIndex & index);
+	static bool save(const HapMediaFile & file, const HapFrameIndex & index);
+
+	// the index from the sidecar, else from the container, writing the sidecar for next time
+	static HapDemuxResult loadOrBuild(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool = NULL);
+};
@@ -0,0 +1,179 @@
+// 64 bit off_t on 32 bit POSIX builds, before anything pulls in the system headers
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "HapMediaFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/////////////////////// HapFileView //////////////////////////
+
+HapFileView::HapFileView() {
+	m_base = NULL;
+	m_baseSize = 0;
+	m_data = NULL;
+	m_size = 0;
+}
+
+HapFileView::~HapFileView() {
+	unmap();
+}
+
+void HapFileView::unmap() {
+	if (m_base) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_base);
+#else
+		munmap(m_base, m_baseSize);
+#endif
+	}
+	m_base = NULL;
+	m_baseSize = 0;
+	m_data = NULL;
+	m_size = 0;
+}
+
+/////////////////////// HapMediaFile //////////////////////////
+
+HapMediaFile::HapMediaFile() {
+#ifdef _WIN32
+	m_handle = INVALID_HANDLE_VALUE;
+#else
+	m_fd = -1;
+#endif
+	m_size = 0;
+	m_modifiedTime = 0;
+}
+
+HapMediaFile::~HapMediaFile() {
+	close();
+}
+
+bool HapMediaFile::open(const std::string & path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle(handle, &info)) {
+		CloseHandle(handle);
+		return false;
+	}
+	m_handle = handle;
+	m_size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	m_modifiedTime = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	m_fd = fd;
+	m_size = (uint64_t)st.st_size;
+	m_modifiedTime = (int64_t)st.st_mtime * 1000000000;
+#ifdef __linux__
+	m_modifiedTime += st.st_mtim.tv_nsec;
+#endif
+#endif
+
+	m_path = path;
+	return true;
+}
+
+void HapMediaFile::close() {
+#ifdef _WIN32
+	if (m_handle != INVALID_HANDLE_VALUE) CloseHandle(m_handle);
+	m_handle = INVALID_HANDLE_VALUE;
+#else
+	if (m_fd >= 0) ::close(m_fd);
+	m_fd = -1;
+#endif
+	m_path.clear();
+	m_size = 0;
+	m_modifiedTime = 0;
+}
+
+bool HapMediaFile::isOpen() const {
+#ifdef _WIN32
+	return m_handle != INVALID_HANDLE_VALUE;
+#else
+	return m_fd >= 0;
+#endif
+}
+
+bool HapMediaFile::read(uint64_t offset, void * dst, size_t size) const {
+	if (!isOpen() || offset > m_size || size > m_size - offset) return false;
+
+	unsigned char * p = (unsigned char*)dst;
+	while (size > 0) {
+#ifdef _WIN32
+		// an explicit offset per call, the handle's file position is never used
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+		OVERLAPPED overlapped;
+		ZeroMemory(&overlapped, sizeof(overlapped));
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD bytesRead = 0;
+		if (!ReadFile(m_handle, p, chunk, &bytesRead, &overlapped) || bytesRead == 0) return false;
+#else
+		size_t chunk = size > 0x40000000 ? 0x40000000 : size;
+		ssize_t bytesRead = pread(m_fd, p, chunk, (off_t)offset);
+		if (bytesRead < 0 && errno == EINTR) continue;
+		if (bytesRead <= 0) return false;
+#endif
+		p += bytesRead;
+		offset += bytesRead;
+		size -= bytesRead;
+	}
+	return true;
+}
+
+bool HapMediaFile::map(uint64_t offset, uint64_t size, HapFileView & view) const {
+	view.unmap();
+	if (!isOpen() || size == 0 || offset > m_size || size > m_size - offset) return false;
+
+#ifdef _WIN32
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	uint64_t granularity = systemInfo.dwAllocationGranularity;
+#else
+	uint64_t granularity = (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+
+	uint64_t base = offset - offset % granularity;
+	uint64_t baseSize = size + (offset - base);
+	if (baseSize > (uint64_t)SIZE_MAX) return false;
+
+#ifdef _WIN32
+	// the view keeps the mapping object alive
+	HANDLE mapping = CreateFileMappingA(m_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) return false;
+	void * p = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(base >> 32), (DWORD)base, (SIZE_T)baseSize);
+	CloseHandle(mapping);
+	if (!p) return false;
+#else
+	void * p = mmap(NULL, (size_t)baseSize, PROT_READ, MAP_SHARED, m_fd, (off_t)base);
+	if (p == MAP_FAILED) return false;
+#endif
+
+	view.m_base = p;
+	view.m_baseSize = (size_t)baseSize;
+	view.m_data = (const unsigned char*)p + (offset - base);
+	view.m_size = (size_t)size;
+	return true;
+}
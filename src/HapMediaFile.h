@@ -0,0 +1,75 @@
+// HapMediaFile - random access reads and memory-mapped views of a media file
+//
+// Portable: Win32 file handles and file mappings on Windows, open/pread/mmap elsewhere.
+// Offsets and sizes are 64 bit throughout, so multi-GB files work on 32 bit builds too
+// (as long as each single read or view fits the address space). Reads don't share a file
+// position, so any number of threads can read the same file at once.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// a read-only mapped region of a file, unmapped when destroyed, stays valid after the file is closed
+class HapFileView {
+
+public:
+
+	HapFileView();
+	~HapFileView();
+
+	const unsigned char * getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+	bool isMapped() const { return m_data != NULL; }
+	void unmap();
+
+private:
+
+	friend class HapMediaFile;
+
+	HapFileView(const HapFileView &);
+	HapFileView & operator=(const HapFileView &);
+
+	void * m_base;				// start of the mapping, aligned down to the allocation granularity
+	size_t m_baseSize;
+	const unsigned char * m_data;
+	size_t m_size;
+};
+
+class HapMediaFile {
+
+public:
+
+	HapMediaFile();
+	~HapMediaFile();
+
+	bool open(const std::string & path);
+	void close();
+	bool isOpen() const;
+	const std::string & getPath() const { return m_path; }
+
+	uint64_t getSize() const { return m_size; }
+	// last modification, only meant to be compared with earlier values of the same file
+	int64_t getModifiedTime() const { return m_modifiedTime; }
+
+	// exactly size bytes at offset, false on errors and short reads
+	bool read(uint64_t offset, void * dst, size_t size) const;
+
+	// maps [offset, offset + size)
+	bool map(uint64_t offset, uint64_t size, HapFileView & view) const;
+
+private:
+
+	HapMediaFile(const HapMediaFile &);
+	HapMediaFile & operator=(const HapMediaFile &);
+
+#ifdef _WIN32
+	void * m_handle;
+#else
+	int m_fd;
+#endif
+	std::string m_path;
+	uint64_t m_size;
+	int64_t m_modifiedTime;
+};
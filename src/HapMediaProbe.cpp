@@ -0,0 +1,95 @@
+#include "HapMediaProbe.h"
+#include "HapIndexCache.h"
+#include "DXTThreadPool.h"
+
+struct ProbeBatchJob {
+	const std::vector<std::string> * paths;
+	std::vector<HapProbeInfo> * results;
+};
+
+static HapProbeInfo probeFile(const std::string & path, DXTThreadPool * pool) {
+	HapProbeInfo info;
+	info.result = HapDemuxResult_OK;
+	info.textureFormat = TextureFormat_RGB_DXT1;
+	info.codec = 0;
+	info.width = 0;
+	info.height = 0;
+	info.fps = 0.0;
+	info.frameCount = 0;
+	info.duration = 0.0;
+	info.bAudio = false;
+	info.maxFrameSize = 0;
+
+	HapMediaFile file;
+	if (!file.open(path)) {
+		info.result = HapDemuxResult_OpenError;
+		return info;
+	}
+
+	HapIndexCacheInfo cached;
+	int64_t frameDuration;
+	int64_t duration;
+	if (HapIndexCache::isEnabled() && HapIndexCache::readInfo(file, cached)) {
+		info.codec = cached.codec;
+		info.width = cached.width;
+		info.height = cached.height;
+		info.frameCount = cached.frameCount;
+		info.bAudio = cached.bAudio;
+		info.maxFrameSize = cached.maxFrameSize;
+		frameDuration = cached.frameDuration;
+		duration = cached.duration;
+	}
+	else {
+		// the tables are read anyway, keep them for the next probe or load
+		HapFrameIndex index;
+		info.result = HapDemuxer::buildIndex(file, index, pool);
+		if (info.result != HapDemuxResult_OK) return info;
+		if (HapIndexCache::isEnabled()) HapIndexCache::save(file, index);
+
+		info.codec = index.codec;
+		info.width = index.width;
+		info.height = index.height;
+		info.frameCount = index.getFrameCount();
+		info.bAudio = index.audio.bPresent;
+		info.maxFrameSize = index.getMaxFrameSize();
+		frameDuration = index.frameDuration;
+		duration = index.duration;
+	}
+
+	switch (info.codec) {
+	case HAP_CODEC_HAP1: info.textureFormat = TextureFormat_RGB_DXT1; break;
+	case HAP_CODEC_HAP5: info.textureFormat = TextureFormat_RGBA_DXT5; break;
+	case HAP_CODEC_HAPY: info.textureFormat = TextureFormat_YCoCg_DXT5; break;
+	}
+	info.fps = frameDuration > 0 ? 10000000.0 / frameDuration : 0.0;
+	info.duration = duration / 10000000.0;
+	return info;
+}
+
+static void probeBatchTask(void * arg, int index) {
+	ProbeBatchJob * job = (ProbeBatchJob*)arg;
+	(*job->results)[index] = probeFile((*job->paths)[index], NULL);
+}
+
+HapProbeInfo HapMediaProbe::probe(const std::string & path, DXTThreadPool * pool) {
+	return probeFile(path, pool);
+}
+
+std::vector<HapProbeInfo> HapMediaProbe::probeBatch(const std::vector<std::string> & paths, DXTThreadPool * pool) {
+	std::vector<HapProbeInfo> results(paths.size());
+	ProbeBatchJob job;
+	job.paths = &paths;
+	job.results = &results;
+
+	if (!pool) {
+		for (size_t i = 0; i < paths.size(); i++) probeBatchTask(&job, (int)i);
+		return results;
+	}
+
+	// one task per clip, behind the decoding of the clips that are playing
+	DXTTaskClient client(DXTTaskPriority_Low);
+	DXTTaskGroup group(&client);
+	for (size_t i = 0; i < paths.size(); i++) pool->submit(group, probeBatchTask, &job, (int)i);
+	pool->wait(group);
+	return results;
+}
@@ -0,0 +1,40 @@
+// HapMediaProbe - what a HAP movie is, without building a filter graph
+//
+// Portable. Reads the clip's index sidecar when there is a current one (see HapIndexCache),
+// else the container's tables through the demuxers, and writes the sidecar so the next probe
+// or load of the clip is instant. Files the demuxers can't read (the ones a load hands to LAV
+// Splitter) fail with HapDemuxResult_UnknownContainer. probeBatch spreads many paths over a
+// thread pool, each probe on its own worker.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "HapDemuxer.h"
+
+class DXTThreadPool;
+
+struct HapProbeInfo {
+	HapDemuxResult result;		// the rest is only valid when OK
+	DXTTextureFormat textureFormat;
+	uint32_t codec;				// HAP_CODEC_*
+	int width;
+	int height;
+	double fps;					// average
+	int frameCount;
+	double duration;			// seconds
+	bool bAudio;
+	uint32_t maxFrameSize;		// bytes of the largest compressed frame
+};
+
+class HapMediaProbe {
+
+public:
+
+	// pool is used to scan Matroska files without Cues, NULL does it all on the calling thread
+	static HapProbeInfo probe(const std::string & path, DXTThreadPool * pool = NULL);
+
+	// results in the order of paths. pool NULL probes on the calling thread
+	static std::vector<HapProbeInfo> probeBatch(const std::vector<std::string> & paths, DXTThreadPool * pool);
+};
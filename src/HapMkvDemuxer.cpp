@@ -0,0 +1,670 @@
+#include "HapMkvDemuxer.h"
+#include "DXTThreadPool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string>
+
+// element ids with their length marker, as in the specification
+#define MKV_ID_EBML 0x1A45DFA3
+#define MKV_ID_DOCTYPE 0x4282
+#define MKV_ID_SEGMENT 0x18538067
+#define MKV_ID_SEEKHEAD 0x114D9B74
+#define MKV_ID_SEEK 0x4DBB
+#define MKV_ID_SEEKID 0x53AB
+#define MKV_ID_SEEKPOSITION 0x53AC
+#define MKV_ID_INFO 0x1549A966
+#define MKV_ID_TIMECODESCALE 0x2AD7B1
+#define MKV_ID_DURATION 0x4489
+#define MKV_ID_TRACKS 0x1654AE6B
+#define MKV_ID_TRACKENTRY 0xAE
+#define MKV_ID_TRACKNUMBER 0xD7
+#define MKV_ID_TRACKTYPE 0x83
+#define MKV_ID_CODECID 0x86
+#define MKV_ID_CODECPRIVATE 0x63A2
+#define MKV_ID_DEFAULTDURATION 0x23E383
+#define MKV_ID_CONTENTENCODINGS 0x6D80
+#define MKV_ID_VIDEO 0xE0
+#define MKV_ID_PIXELWIDTH 0xB0
+#define MKV_ID_PIXELHEIGHT 0xBA
+#define MKV_ID_AUDIO 0xE1
+#define MKV_ID_SAMPLINGFREQUENCY 0xB5
+#define MKV_ID_CHANNELS 0x9F
+#define MKV_ID_BITDEPTH 0x6264
+#define MKV_ID_CUES 0x1C53BB6B
+#define MKV_ID_CUEPOINT 0xBB
+#define MKV_ID_CUETRACKPOSITIONS 0xB7
+#define MKV_ID_CUETRACK 0xF7
+#define MKV_ID_CUECLUSTERPOSITION 0xF1
+#define MKV_ID_CLUSTER 0x1F43B675
+#define MKV_ID_TIMECODE 0xE7
+#define MKV_ID_SIMPLEBLOCK 0xA3
+#define MKV_ID_BLOCKGROUP 0xA0
+#define MKV_ID_BLOCK 0xA1
+#define MKV_ID_CRC32 0xBF
+
+#define MKV_TRACK_VIDEO 1
+#define MKV_TRACK_AUDIO 2
+#define MKV_FLAG_LACING 0x06
+#define MKV_UNKNOWN_SIZE 0xFFFFFFFFFFFFFFFFULL
+#define MKV_NO_POSITION 0xFFFFFFFFFFFFFFFFULL
+
+// enough for an element header and the header of a block inside it
+#define MKV_PEEK_SIZE 32
+// regions smaller than this aren't worth a task of their own
+#define MKV_MIN_SCAN_REGION (64 << 20)
+#define MKV_RESYNC_READ (64 << 10)
+#define MKV_MAX_CACHED_SCANS 32
+
+// a variable length integer, ids keep their length marker, sizes with all bits set are unknown
+static int readVint(const unsigned char * p, size_t avail, int maxLength, bool bId, uint64_t & value) {
+	if (avail == 0 || p[0] == 0) return 0;
+	int length = 1;
+	while (!(p[0] & (0x80 >> (length - 1)))) length++;
+	if (length > maxLength || (size_t)length > avail) return 0;
+
+	uint64_t mask = 0xFF >> length;
+	value = bId ? p[0] : p[0] & mask;
+	bool bAllOnes = (p[0] & mask) == mask;
+	for (int i = 1; i < length; i++) {
+		value = (value << 8) | p[i];
+		bAllOnes = bAllOnes && p[i] == 0xFF;
+	}
+	if (!bId && bAllOnes) value = MKV_UNKNOWN_SIZE;
+	return length;
+}
+
+struct MkvHeader {
+	uint32_t id;
+	uint64_t size;		// MKV_UNKNOWN_SIZE for clusters and segments still being written
+	int headerSize;
+};
+
+static bool parseHeader(const unsigned char * p, size_t avail, MkvHeader & header) {
+	uint64_t id;
+	int idLength = readVint(p, avail, 4, true, id);
+	if (idLength == 0) return false;
+	int sizeLength = readVint(p + idLength, avail - idLength, 8, false, header.size);
+	if (sizeLength == 0) return false;
+	header.id = (uint32_t)id;
+	header.headerSize = idLength + sizeLength;
+	return true;
+}
+
+// ids of the segment's children are 4 bytes long and start with 0x1X
+static bool isTopLevelId(uint32_t id) {
+	return (id & 0xF0000000) == 0x10000000;
+}
+
+struct MkvElement {
+	uint32_t id;
+	const unsigned char * data;		// payload, after the header
+	size_t size;
+};
+
+// the element at p, moves p past it
+static bool nextElement(const unsigned char *& p, const unsigned char * end, MkvElement & element) {
+	MkvHeader header;
+	if (!parseHeader(p, end - p, header)) return false;
+	if (header.size == MKV_UNKNOWN_SIZE || header.size > (uint64_t)(end - p - header.headerSize)) return false;
+
+	element.id = header.id;
+	element.data = p + header.headerSize;
+	element.size = (size_t)header.size;
+	p = element.data + element.size;
+	return true;
+}
+
+static bool findElement(const MkvElement & parent, uint32_t id, MkvElement & element) {
+	const unsigned char * p = parent.data;
+	const unsigned char * end = parent.data + parent.size;
+	while (nextElement(p, end, element)) {
+		if (element.id == id) return true;
+	}
+	return false;
+}
+
+static uint64_t readUInt(const unsigned char * p, size_t size) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < size && i < 8; i++) value = (value << 8) | p[i];
+	return value;
+}
+
+static uint64_t readUInt(const MkvElement & element) {
+	return readUInt(element.data, element.size);
+}
+
+static double readFloat(const MkvElement & element) {
+	uint64_t bits = readUInt(element);
+	if (element.size == 4) {
+		uint32_t bits32 = (uint32_t)bits;
+		float value;
+		memcpy(&value, &bits32, sizeof(value));
+		return value;
+	}
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return element.size == 8 ? value : 0.0;
+}
+
+static uint64_t findUInt(const MkvElement & parent, uint32_t id, uint64_t defaultValue) {
+	MkvElement element;
+	return findElement(parent, id, element) ? readUInt(element) : defaultValue;
+}
+
+static std::string findString(const MkvElement & parent, uint32_t id) {
+	MkvElement element;
+	if (!findElement(parent, id, element)) return std::string();
+	std::string value((const char*)element.data, element.size);
+	return value.substr(0, value.find('\0'));
+}
+
+// a top level element mapped whole
+struct MkvMappedElement {
+	HapFileView view;
+	MkvElement element;
+};
+
+static bool mapElement(const HapMediaFile & file, uint64_t position, uint64_t end, uint32_t id, MkvMappedElement & mapped) {
+	unsigned char buf[MKV_PEEK_SIZE];
+	if (position >= end) return false;
+	size_t n = end - position < sizeof(buf) ? (size_t)(end - position) : sizeof(buf);
+	MkvHeader header;
+	if (!file.read(position, buf, n) || !parseHeader(buf, n, header) || header.id != id) return false;
+	if (header.size == MKV_UNKNOWN_SIZE || header.size > end - position - header.headerSize) return false;
+	if (!file.map(position + header.headerSize, header.size, mapped.view)) return false;
+
+	mapped.element.id = id;
+	mapped.element.data = mapped.view.getData();
+	mapped.element.size = mapped.view.getSize();
+	return true;
+}
+
+/////////////////////// cluster walks //////////////////////////
+
+struct MkvContext {
+	const HapMediaFile * file;
+	uint64_t fileSize;
+	uint64_t segmentData;
+	uint64_t segmentEnd;
+	uint64_t videoTrack;
+	uint64_t timecodeScale;		// ns per tick
+};
+
+// what one walk found, frames in file order
+struct MkvWalk {
+	uint64_t firstCluster;		// MKV_NO_POSITION if none
+	uint64_t next;				// element boundary where the walk stopped
+	bool bUnsupported;			// laced video blocks
+	std::vector<HapIndexEntry> frames;
+
+	MkvWalk() : firstCluster(MKV_NO_POSITION), next(0), bUnsupported(false) {}
+};
+
+// up to MKV_PEEK_SIZE bytes at position and the element header in them
+static bool peekElement(const MkvContext & ctx, uint64_t position, uint64_t end, unsigned char * buf, size_t & n, MkvHeader & header) {
+	if (position >= end) return false;
+	n = end - position < MKV_PEEK_SIZE ? (size_t)(end - position) : MKV_PEEK_SIZE;
+	return ctx.file->read(position, buf, n) && parseHeader(buf, n, header);
+}
+
+static void addBlock(const MkvContext & ctx, const unsigned char * p, size_t avail, uint64_t offset, uint64_t size, int64_t clusterTime, MkvWalk & walk) {
+	uint64_t track;
+	int trackLength = readVint(p, avail, 8, false, track);
+	if (trackLength == 0 || (size_t)trackLength + 3 > avail || size < (uint64_t)trackLength + 3 || track != ctx.videoTrack) return;
+
+	if (p[trackLength + 2] & MKV_FLAG_LACING) {
+		walk.bUnsupported = true;
+		return;
+	}
+	int16_t relativeTime = (int16_t)((p[trackLength] << 8) | p[trackLength + 1]);
+	int64_t ticks = clusterTime + relativeTime;
+
+	HapIndexEntry entry;
+	entry.offset = offset + trackLength + 3;
+	entry.size = (uint32_t)(size - trackLength - 3);
+	entry.time = ticks > 0 ? (int64_t)(ticks * ctx.timecodeScale / 100) : 0;
+	if (size - trackLength - 3 > 0xFFFFFFFF || entry.offset > ctx.fileSize || entry.size > ctx.fileSize - entry.offset) return;
+	walk.frames.push_back(entry);
+}
+
+// the blocks of the cluster at position, returns where the cluster ends, 0 if there's no cluster
+static uint64_t walkCluster(const MkvContext & ctx, uint64_t position, MkvWalk & walk) {
+	unsigned char buf[MKV_PEEK_SIZE];
+	size_t n;
+	MkvHeader header;
+	if (!peekElement(ctx, position, ctx.segmentEnd, buf, n, header) || header.id != MKV_ID_CLUSTER) return 0;
+
+	bool bUnknownSize = header.size == MKV_UNKNOWN_SIZE;
+	uint64_t p = position + header.headerSize;
+	uint64_t end = ctx.segmentEnd;
+	if (!bUnknownSize && header.size < end - p) end = p + header.size;
+
+	int64_t clusterTime = 0;
+	while (peekElement(ctx, p, end, buf, n, header)) {
+		// a cluster of unknown size ends where the next top level element starts
+		if (bUnknownSize && isTopLevelId(header.id)) return p;
+		if (header.size == MKV_UNKNOWN_SIZE || header.size > end - p - header.headerSize) break;
+		uint64_t data = p + header.headerSize;
+		const unsigned char * payload = buf + header.headerSize;
+		size_t payloadSize = n - header.headerSize;
+
+		if (header.id == MKV_ID_TIMECODE) {
+			clusterTime = (int64_t)readUInt(payload, header.size < payloadSize ? (size_t)header.size : payloadSize);
+		}
+		else if (header.id == MKV_ID_SIMPLEBLOCK) {
+			addBlock(ctx, payload, payloadSize, data, header.size, clusterTime, walk);
+		}
+		else if (header.id == MKV_ID_BLOCKGROUP) {
+			uint64_t groupEnd = data + header.size;
+			unsigned char blockBuf[MKV_PEEK_SIZE];
+			size_t blockN;
+			MkvHeader block;
+			for (uint64_t q = data; peekElement(ctx, q, groupEnd, blockBuf, blockN, block); q += block.headerSize + block.size) {
+				if (block.size == MKV_UNKNOWN_SIZE || block.size > groupEnd - q - block.headerSize) break;
+				if (block.id == MKV_ID_BLOCK) {
+					addBlock(ctx, blockBuf + block.headerSize, blockN - block.headerSize, q + block.headerSize, block.size, clusterTime, walk);
+				}
+			}
+		}
+		p = data + header.size;
+	}
+	return end;
+}
+
+// clusters from position until the first element starting at or after stop
+static void walkClusters(const MkvContext & ctx, uint64_t position, uint64_t stop, MkvWalk & walk) {
+	unsigned char buf[MKV_PEEK_SIZE];
+	size_t n;
+	MkvHeader header;
+	while (position < stop && peekElement(ctx, position, ctx.segmentEnd, buf, n, header)) {
+		if (header.id == MKV_ID_CLUSTER) {
+			if (walk.firstCluster == MKV_NO_POSITION) walk.firstCluster = position;
+			uint64_t end = walkCluster(ctx, position, walk);
+			if (end <= position) break;
+			position = end;
+		}
+		else {
+			// Cues, Tags, Void, ... between the clusters
+			if (header.size == MKV_UNKNOWN_SIZE || header.size > ctx.segmentEnd - position - header.headerSize) break;
+			position += header.headerSize + header.size;
+		}
+	}
+	walk.next = position;
+}
+
+// the first position at or after start that looks like a cluster, a cluster id with a sane
+// size whose first child is a Timecode or CRC-32
+static uint64_t resync(const MkvContext & ctx, uint64_t start, uint64_t stop) {
+	static const unsigned char clusterId[4] = { 0x1F, 0x43, 0xB6, 0x75 };
+	std::vector<unsigned char> buf(MKV_RESYNC_READ + MKV_PEEK_SIZE);
+
+	for (uint64_t position = start; position < stop; position += MKV_RESYNC_READ) {
+		size_t n = ctx.segmentEnd - position < buf.size() ? (size_t)(ctx.segmentEnd - position) : buf.size();
+		if (n < 4 || !ctx.file->read(position, buf.data(), n)) break;
+
+		size_t searchEnd = n - 3 < MKV_RESYNC_READ ? n - 3 : MKV_RESYNC_READ;
+		for (size_t i = 0; i < searchEnd && position + i < stop; i++) {
+			const unsigned char * hit = (const unsigned char*)memchr(&buf[i], clusterId[0], searchEnd - i);
+			if (hit == NULL) break;
+			i = hit - buf.data();
+			if (position + i >= stop || memcmp(hit, clusterId, 4) != 0) continue;
+
+			unsigned char peek[MKV_PEEK_SIZE];
+			size_t peekN;
+			MkvHeader cluster, child;
+			uint64_t candidate = position + i;
+			if (!peekElement(ctx, candidate, ctx.segmentEnd, peek, peekN, cluster)) continue;
+			if (cluster.size != MKV_UNKNOWN_SIZE && cluster.size > ctx.segmentEnd - candidate - cluster.headerSize) continue;
+			if (!parseHeader(peek + cluster.headerSize, peekN - cluster.headerSize, child)) continue;
+			if ((child.id == MKV_ID_TIMECODE && child.size <= 8) || (child.id == MKV_ID_CRC32 && child.size == 4)) return candidate;
+		}
+	}
+	return MKV_NO_POSITION;
+}
+
+struct MkvScanJob {
+	const MkvContext * ctx;
+	std::vector<uint64_t> starts;	// one per task, the region of task i ends where task i + 1's starts
+	std::vector<MkvWalk> walks;
+};
+
+static void scanRegionTask(void * arg, int index) {
+	MkvScanJob * job = (MkvScanJob*)arg;
+	uint64_t start = job->starts[index];
+	uint64_t stop = index + 1 < (int)job->starts.size() ? job->starts[index + 1] : job->ctx->segmentEnd;
+
+	// the first region starts on a known cluster, the others have to find one
+	if (index > 0) start = resync(*job->ctx, start, stop);
+	if (start != MKV_NO_POSITION) walkClusters(*job->ctx, start, stop, job->walks[index]);
+}
+
+// Cues don't always point at every cluster, the gaps are walked serially when the walks are joined
+struct MkvCueJob {
+	const MkvContext * ctx;
+	const std::vector<uint64_t> * clusters;
+	size_t clustersPerTask;
+	std::vector<MkvWalk> walks;		// one per cluster, next is the cluster's end
+};
+
+static void walkCuedClustersTask(void * arg, int index) {
+	MkvCueJob * job = (MkvCueJob*)arg;
+	size_t first = (size_t)index * job->clustersPerTask;
+	size_t end = std::min(first + job->clustersPerTask, job->clusters->size());
+	for (size_t i = first; i < end; i++) {
+		MkvWalk & walk = job->walks[i];
+		uint64_t position = (*job->clusters)[i];
+		walk.next = walkCluster(*job->ctx, position, walk);
+		if (walk.next > position) walk.firstCluster = position;
+	}
+}
+
+static void appendWalk(MkvWalk & walk, MkvWalk & result) {
+	result.frames.insert(result.frames.end(), walk.frames.begin(), walk.frames.end());
+	result.bUnsupported = result.bUnsupported || walk.bUnsupported;
+	std::vector<HapIndexEntry>().swap(walk.frames);
+}
+
+static void submitTasks(DXTThreadPool * pool, int tasks, DXTTaskProc proc, void * arg) {
+	if (!pool) {
+		for (int i = 0; i < tasks; i++) proc(arg, i);
+		return;
+	}
+	// the scans read tens of MB each, behind the decoding of the clips that are playing
+	DXTTaskClient client(DXTTaskPriority_Low);
+	DXTTaskGroup group(&client);
+	for (int i = 0; i < tasks; i++) pool->submit(group, proc, arg, i);
+	pool->wait(group);
+}
+
+static void walkCuedClusters(const MkvContext & ctx, uint64_t firstCluster, const std::vector<uint64_t> & clusters, DXTThreadPool * pool, MkvWalk & result) {
+	int threads = pool ? pool->getNumThreads() + 1 : 1;
+	MkvCueJob job;
+	job.ctx = &ctx;
+	job.clusters = &clusters;
+	job.clustersPerTask = (clusters.size() + threads * 4 - 1) / (threads * 4);
+	if (job.clustersPerTask == 0) job.clustersPerTask = 1;
+	job.walks.resize(clusters.size());
+	submitTasks(pool, (int)((clusters.size() + job.clustersPerTask - 1) / job.clustersPerTask), walkCuedClustersTask, &job);
+
+	uint64_t position = firstCluster;
+	for (size_t i = 0; i < clusters.size(); i++) {
+		MkvWalk & walk = job.walks[i];
+		// no cluster where the cue said, or one the walks already passed
+		if (walk.firstCluster == MKV_NO_POSITION || clusters[i] < position) continue;
+		if (position < clusters[i]) {
+			MkvWalk gap;
+			walkClusters(ctx, position, clusters[i], gap);
+			appendWalk(gap, result);
+			if (gap.next != clusters[i]) {
+				position = gap.next;
+				continue;
+			}
+		}
+		appendWalk(walk, result);
+		position = walk.next;
+	}
+
+	// clusters after the last cue
+	MkvWalk tail;
+	walkClusters(ctx, position, ctx.segmentEnd, tail);
+	appendWalk(tail, result);
+}
+
+static void scanClusters(const MkvContext & ctx, uint64_t firstCluster, DXTThreadPool * pool, MkvWalk & result) {
+	int threads = pool ? pool->getNumThreads() + 1 : 1;
+	uint64_t length = ctx.segmentEnd - firstCluster;
+	uint64_t regions = std::min<uint64_t>(threads > 1 ? threads * 2 : 1, length / MKV_MIN_SCAN_REGION);
+	if (regions < 1) regions = 1;
+
+	MkvScanJob job;
+	job.ctx = &ctx;
+	for (uint64_t i = 0; i < regions; i++) job.starts.push_back(firstCluster + length / regions * i);
+	job.walks.resize(job.starts.size());
+	submitTasks(pool, (int)job.starts.size(), scanRegionTask, &job);
+
+	// a region's walk is used if it starts where the one before stopped, else it could have
+	// synced on a cluster id inside a frame and the region is walked again from there
+	uint64_t position = firstCluster;
+	for (size_t i = 0; i < job.walks.size(); i++) {
+		uint64_t stop = i + 1 < job.starts.size() ? job.starts[i + 1] : ctx.segmentEnd;
+		if (position >= stop) continue;
+		if (job.walks[i].firstCluster == position) {
+			appendWalk(job.walks[i], result);
+			position = job.walks[i].next;
+		}
+		else {
+			MkvWalk walk;
+			walkClusters(ctx, position, stop, walk);
+			appendWalk(walk, result);
+			position = walk.next;
+		}
+	}
+}
+
+/////////////////////// scan cache //////////////////////////
+
+struct MkvCachedScan {
+	std::string path;
+	uint64_t size;
+	int64_t modifiedTime;
+	HapFrameIndex index;
+};
+
+static std::mutex s_scanCacheMutex;
+static std::deque<MkvCachedScan> s_scanCache;
+
+static bool findCachedScan(const HapMediaFile & file, HapFrameIndex & index) {
+	std::lock_guard<std::mutex> lock(s_scanCacheMutex);
+	for (size_t i = 0; i < s_scanCache.size(); i++) {
+		const MkvCachedScan & scan = s_scanCache[i];
+		if (scan.path == file.getPath() && scan.size == file.getSize() && scan.modifiedTime == file.getModifiedTime()) {
+			index = scan.index;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void addCachedScan(const HapMediaFile & file, const HapFrameIndex & index) {
+	std::lock_guard<std::mutex> lock(s_scanCacheMutex);
+	for (size_t i = 0; i < s_scanCache.size(); i++) {
+		if (s_scanCache[i].path == file.getPath()) {
+			s_scanCache.erase(s_scanCache.begin() + i);
+			break;
+		}
+	}
+	if (s_scanCache.size() >= MKV_MAX_CACHED_SCANS) s_scanCache.pop_front();
+
+	MkvCachedScan scan;
+	scan.path = file.getPath();
+	scan.size = file.getSize();
+	scan.modifiedTime = file.getModifiedTime();
+	scan.index = index;
+	s_scanCache.push_back(scan);
+}
+
+/////////////////////// HapMkvDemuxer //////////////////////////
+
+static bool parseTracks(const MkvElement & tracks, HapFrameIndex & index, uint64_t & videoTrack) {
+	videoTrack = 0;
+	const unsigned char * p = tracks.data;
+	const unsigned char * end = tracks.data + tracks.size;
+	MkvElement entry;
+	while (nextElement(p, end, entry)) {
+		if (entry.id != MKV_ID_TRACKENTRY) continue;
+
+		uint64_t type = findUInt(entry, MKV_ID_TRACKTYPE, 0);
+		std::string codecId = findString(entry, MKV_ID_CODECID);
+		MkvElement element;
+
+		if (type == MKV_TRACK_VIDEO && videoTrack == 0) {
+			// HAP has no Matroska codec id, it's stored as a VfW fourcc with a BITMAPINFOHEADER
+			MkvElement codecPrivate;
+			if (codecId != "V_MS/VFW/FOURCC" || !findElement(entry, MKV_ID_CODECPRIVATE, codecPrivate) || codecPrivate.size < 40) continue;
+			if (findElement(entry, MKV_ID_CONTENTENCODINGS, element)) continue;
+
+			const unsigned char * bih = codecPrivate.data;
+			index.codec = HAP_FOURCC(bih[16], bih[17], bih[18], bih[19]);
+			DXTTextureFormat format;
+			if (!index.getTextureFormat(format)) continue;
+
+			index.width = (int)(bih[4] | (bih[5] << 8) | (bih[6] << 16) | ((uint32_t)bih[7] << 24));
+			int height = (int)(bih[8] | (bih[9] << 8) | (bih[10] << 16) | ((uint32_t)bih[11] << 24));
+			index.height = height < 0 ? -height : height;
+			if (findElement(entry, MKV_ID_VIDEO, element)) {
+				index.width = (int)findUInt(element, MKV_ID_PIXELWIDTH, index.width);
+				index.height = (int)findUInt(element, MKV_ID_PIXELHEIGHT, index.height);
+			}
+			index.frameDuration = (int64_t)(findUInt(entry, MKV_ID_DEFAULTDURATION, 0) / 100);
+			videoTrack = findUInt(entry, MKV_ID_TRACKNUMBER, 0);
+		}
+		else if (type == MKV_TRACK_AUDIO && !index.audio.bPresent) {
+			HapAudioTrack & audio = index.audio;
+			audio.bPresent = true;
+			if (findElement(entry, MKV_ID_AUDIO, element)) {
+				MkvElement frequency;
+				if (findElement(element, MKV_ID_SAMPLINGFREQUENCY, frequency)) audio.sampleRate = (int)(readFloat(frequency) + 0.5);
+				audio.channels = (int)findUInt(element, MKV_ID_CHANNELS, 1);
+				audio.bitsPerSample = (int)findUInt(element, MKV_ID_BITDEPTH, 0);
+			}
+			audio.bFloat = codecId == "A_PCM/FLOAT/IEEE";
+			audio.bBigEndian = codecId == "A_PCM/INT/BIG";
+		}
+	}
+	return videoTrack != 0;
+}
+
+bool HapMkvDemuxer::isMkvFile(const unsigned char * header, size_t size) {
+	return size >= 4 && header[0] == 0x1A && header[1] == 0x45 && header[2] == 0xDF && header[3] == 0xA3;
+}
+
+HapDemuxResult HapMkvDemuxer::buildIndex(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool) {
+	index.clear();
+
+	MkvContext ctx;
+	ctx.file = &file;
+	ctx.fileSize = file.getSize();
+
+	// the EBML header, then the segment
+	MkvMappedElement ebml;
+	if (!mapElement(file, 0, ctx.fileSize, MKV_ID_EBML, ebml)) return HapDemuxResult_BadFile;
+	std::string docType = findString(ebml.element, MKV_ID_DOCTYPE);
+	if (docType != "matroska" && docType != "webm") return HapDemuxResult_UnknownContainer;
+
+	unsigned char buf[MKV_PEEK_SIZE];
+	size_t n;
+	MkvHeader header;
+	ctx.segmentEnd = ctx.fileSize;
+	if (!peekElement(ctx, 0, ctx.fileSize, buf, n, header)) return HapDemuxResult_BadFile;
+	uint64_t position = header.headerSize + header.size;
+	if (!peekElement(ctx, position, ctx.fileSize, buf, n, header) || header.id != MKV_ID_SEGMENT) return HapDemuxResult_BadFile;
+	ctx.segmentData = position + header.headerSize;
+	if (header.size != MKV_UNKNOWN_SIZE && header.size < ctx.fileSize - ctx.segmentData) ctx.segmentEnd = ctx.segmentData + header.size;
+
+	// the segment's children up to the first cluster, only their headers are read
+	uint64_t seekHead = MKV_NO_POSITION, info = MKV_NO_POSITION, tracks = MKV_NO_POSITION, cues = MKV_NO_POSITION;
+	uint64_t firstCluster = MKV_NO_POSITION;
+	for (position = ctx.segmentData; peekElement(ctx, position, ctx.segmentEnd, buf, n, header); position += header.headerSize + header.size) {
+		if (header.id == MKV_ID_CLUSTER) {
+			firstCluster = position;
+			break;
+		}
+		if (header.id == MKV_ID_SEEKHEAD && seekHead == MKV_NO_POSITION) seekHead = position;
+		else if (header.id == MKV_ID_INFO) info = position;
+		else if (header.id == MKV_ID_TRACKS) tracks = position;
+		else if (header.id == MKV_ID_CUES) cues = position;
+		if (header.size == MKV_UNKNOWN_SIZE || header.size > ctx.segmentEnd - position - header.headerSize) break;
+	}
+
+	// Cues usually come after the clusters, the SeekHead says where
+	MkvMappedElement seek;
+	if (seekHead != MKV_NO_POSITION && mapElement(file, seekHead, ctx.segmentEnd, MKV_ID_SEEKHEAD, seek)) {
+		const unsigned char * p = seek.element.data;
+		const unsigned char * end = p + seek.element.size;
+		MkvElement entry, id;
+		while (nextElement(p, end, entry)) {
+			if (entry.id != MKV_ID_SEEK || !findElement(entry, MKV_ID_SEEKID, id)) continue;
+			uint64_t target = ctx.segmentData + findUInt(entry, MKV_ID_SEEKPOSITION, 0);
+			uint32_t targetId = (uint32_t)readUInt(id);
+			if (targetId == MKV_ID_INFO && info == MKV_NO_POSITION) info = target;
+			else if (targetId == MKV_ID_TRACKS && tracks == MKV_NO_POSITION) tracks = target;
+			else if (targetId == MKV_ID_CUES && cues == MKV_NO_POSITION) cues = target;
+		}
+	}
+
+	ctx.timecodeScale = 1000000;
+	double duration = 0.0;
+	MkvMappedElement infoElement;
+	if (info != MKV_NO_POSITION && mapElement(file, info, ctx.segmentEnd, MKV_ID_INFO, infoElement)) {
+		ctx.timecodeScale = findUInt(infoElement.element, MKV_ID_TIMECODESCALE, 1000000);
+		MkvElement element;
+		if (findElement(infoElement.element, MKV_ID_DURATION, element)) duration = readFloat(element);
+	}
+
+	MkvMappedElement tracksElement;
+	if (tracks == MKV_NO_POSITION || !mapElement(file, tracks, ctx.segmentEnd, MKV_ID_TRACKS, tracksElement)) return HapDemuxResult_BadFile;
+	if (!parseTracks(tracksElement.element, index, ctx.videoTrack) || firstCluster == MKV_NO_POSITION || ctx.timecodeScale == 0) {
+		HapAudioTrack audio = index.audio;
+		index.clear();
+		index.audio = audio;
+		return firstCluster == MKV_NO_POSITION ? HapDemuxResult_BadFile : HapDemuxResult_NoHapTrack;
+	}
+
+	// clusters of the video track from the Cues, in file order
+	std::vector<uint64_t> cuedClusters;
+	MkvMappedElement cuesElement;
+	if (cues != MKV_NO_POSITION && mapElement(file, cues, ctx.segmentEnd, MKV_ID_CUES, cuesElement)) {
+		const unsigned char * p = cuesElement.element.data;
+		const unsigned char * end = p + cuesElement.element.size;
+		MkvElement point;
+		while (nextElement(p, end, point)) {
+			if (point.id != MKV_ID_CUEPOINT) continue;
+			const unsigned char * q = point.data;
+			const unsigned char * pointEnd = point.data + point.size;
+			MkvElement positions;
+			while (nextElement(q, pointEnd, positions)) {
+				if (positions.id != MKV_ID_CUETRACKPOSITIONS || findUInt(positions, MKV_ID_CUETRACK, 0) != ctx.videoTrack) continue;
+				uint64_t cluster = findUInt(positions, MKV_ID_CUECLUSTERPOSITION, MKV_NO_POSITION);
+				if (cluster < ctx.segmentEnd - ctx.segmentData) cuedClusters.push_back(ctx.segmentData + cluster);
+			}
+		}
+		std::sort(cuedClusters.begin(), cuedClusters.end());
+		cuedClusters.erase(std::unique(cuedClusters.begin(), cuedClusters.end()), cuedClusters.end());
+	}
+
+	MkvWalk walk;
+	bool bScanned = cuedClusters.empty();
+	HapFrameIndex cached;
+	if (bScanned && findCachedScan(file, cached)) {
+		index.frames.swap(cached.frames);
+	}
+	else {
+		if (bScanned) scanClusters(ctx, firstCluster, pool, walk);
+		else walkCuedClusters(ctx, firstCluster, cuedClusters, pool, walk);
+		if (walk.bUnsupported) walk.frames.clear();
+		index.frames.swap(walk.frames);
+
+		// blocks are stored in decode order, which is presentation order for intra only HAP
+		std::stable_sort(index.frames.begin(), index.frames.end(), [](const HapIndexEntry & a, const HapIndexEntry & b) { return a.time < b.time; });
+	}
+
+	if (index.frames.empty()) {
+		HapAudioTrack audio = index.audio;
+		index.clear();
+		index.audio = audio;
+		return walk.bUnsupported ? HapDemuxResult_NoHapTrack : HapDemuxResult_BadFile;
+	}
+
+	int64_t lastTime = index.frames.back().time;
+	if (index.frameDuration <= 0) {
+		index.frameDuration = index.frames.size() > 1 ? (lastTime - index.frames.front().time) / (int64_t)(index.frames.size() - 1) : 0;
+	}
+	index.duration = (int64_t)(duration * ctx.timecodeScale / 100);
+	if (index.duration <= lastTime) index.duration = lastTime + index.frameDuration;
+
+	if (bScanned) addCachedScan(file, index);
+	return HapDemuxResult_OK;
+}
@@ -0,0 +1,30 @@
+// HapMkvDemuxer - Matroska (.mkv) blocks of the HAP track to a HapFrameIndex
+//
+// Portable. Reads the segment's SeekHead, Info, Tracks and Cues, then walks the clusters
+// the Cues point at, reading only element headers, in parallel on a thread pool. Clusters
+// the Cues miss are found by walking the gaps between them. Files without Cues are split
+// into regions scanned in parallel, each resyncing on the next cluster id, the results are
+// checked against each other and redone serially where they don't line up. Scanned indexes
+// are kept for the life of the process, keyed by path, size and modification time.
+// Laced and content-encoded (e.g. header stripped) video is left to a splitter, audio is
+// described but its blocks aren't indexed.
+// See https://www.matroska.org/technical/elements.html
+
+#pragma once
+
+#include <stddef.h>
+
+#include "HapDemuxer.h"
+
+class DXTThreadPool;
+
+class HapMkvDemuxer {
+
+public:
+
+	// whether the first bytes of a file are an EBML header
+	static bool isMkvFile(const unsigned char * header, size_t size);
+
+	// pool NULL walks the clusters on the calling thread
+	static HapDemuxResult buildIndex(const HapMediaFile & file, HapFrameIndex & index, DXTThreadPool * pool = NULL);
+};
@@ -0,0 +1,424 @@
+#include "HapMovDemuxer.h"
+
+#include <string.h>
+
+// atom types as read big endian from the file
+#define MOV_TYPE(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define MOV_FLAG_FLOAT 0x1
+#define MOV_FLAG_BIG_ENDIAN 0x2
+
+static uint16_t readBE16(const unsigned char * p) {
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t readBE32(const unsigned char * p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t readBE64(const unsigned char * p) {
+	return ((uint64_t)readBE32(p) << 32) | readBE32(p + 4);
+}
+
+static int64_t ticksToTime(uint64_t ticks, uint32_t timescale) {
+	return (int64_t)((ticks / timescale) * 10000000 + (ticks % timescale) * 10000000 / timescale);
+}
+
+struct MovAtom {
+	uint32_t type;
+	const unsigned char * data;		// payload, after the header
+	size_t size;
+};
+
+// the atom at p, moves p past it
+static bool nextAtom(const unsigned char *& p, const unsigned char * end, MovAtom & atom) {
+	if (end - p < 8) return false;
+
+	uint64_t size = readBE32(p);
+	size_t headerSize = 8;
+	if (size == 1) {
+		if (end - p < 16) return false;
+		size = readBE64(p + 8);
+		headerSize = 16;
+	}
+	else if (size == 0) {
+		size = end - p;
+	}
+	if (size < headerSize || size > (uint64_t)(end - p)) return false;
+
+	atom.type = readBE32(p + 4);
+	atom.data = p + headerSize;
+	atom.size = (size_t)size - headerSize;
+	p += (size_t)size;
+	return true;
+}
+
+static bool findAtom(const unsigned char * data, size_t size, uint32_t type, MovAtom & atom) {
+	const unsigned char * p = data;
+	const unsigned char * end = data + size;
+	while (nextAtom(p, end, atom)) {
+		if (atom.type == type) return true;
+	}
+	return false;
+}
+
+static bool findAtom(const MovAtom & parent, uint32_t type, MovAtom & atom) {
+	return findAtom(parent.data, parent.size, type, atom);
+}
+
+// the tables of one trak atom, still in the mapped moov
+struct MovTrack {
+	uint32_t handler;		// 'vide', 'soun', ...
+	uint32_t timescale;
+	MovAtom stsd;
+	MovAtom stts;
+	MovAtom stsc;
+	MovAtom stsz;
+	MovAtom stco;
+	bool b64BitOffsets;		// co64 instead of stco
+};
+
+static bool parseTrack(const MovAtom & trak, MovTrack & track) {
+	MovAtom mdia, mdhd, hdlr, minf, stbl;
+	if (!findAtom(trak, MOV_TYPE('m', 'd', 'i', 'a'), mdia)) return false;
+	if (!findAtom(mdia, MOV_TYPE('m', 'd', 'h', 'd'), mdhd) || mdhd.size < 24) return false;
+	if (!findAtom(mdia, MOV_TYPE('h', 'd', 'l', 'r'), hdlr) || hdlr.size < 12) return false;
+	if (!findAtom(mdia, MOV_TYPE('m', 'i', 'n', 'f'), minf)) return false;
+	if (!findAtom(minf, MOV_TYPE('s', 't', 'b', 'l'), stbl)) return false;
+
+	// version 1 has 64 bit creation and modification times
+	if (mdhd.data[0] == 1) {
+		if (mdhd.size < 32) return false;
+		track.timescale = readBE32(mdhd.data + 20);
+	}
+	else {
+		track.timescale = readBE32(mdhd.data + 12);
+	}
+	track.handler = readBE32(hdlr.data + 8);
+
+	if (!findAtom(stbl, MOV_TYPE('s', 't', 's', 'd'), track.stsd) || track.stsd.size < 8) return false;
+	if (!findAtom(stbl, MOV_TYPE('s', 't', 't', 's'), track.stts) || track.stts.size < 8) return false;
+	if (!findAtom(stbl, MOV_TYPE('s', 't', 's', 'c'), track.stsc) || track.stsc.size < 8) return false;
+	if (!findAtom(stbl, MOV_TYPE('s', 't', 's', 'z'), track.stsz) || track.stsz.size < 12) return false;
+	track.b64BitOffsets = false;
+	if (!findAtom(stbl, MOV_TYPE('s', 't', 'c', 'o'), track.stco)) {
+		if (!findAtom(stbl, MOV_TYPE('c', 'o', '6', '4'), track.stco)) return false;
+		track.b64BitOffsets = true;
+	}
+	if (track.stco.size < 8) return false;
+
+	// every table has to hold the entries it claims to
+	uint32_t offsetSize = track.b64BitOffsets ? 8 : 4;
+	if ((uint64_t)readBE32(track.stts.data + 4) * 8 > track.stts.size - 8) return false;
+	if ((uint64_t)readBE32(track.stsc.data + 4) * 12 > track.stsc.size - 8) return false;
+	if ((uint64_t)readBE32(track.stco.data + 4) * offsetSize > track.stco.size - 8) return false;
+	if (readBE32(track.stsz.data + 4) == 0 && (uint64_t)readBE32(track.stsz.data + 8) * 4 > track.stsz.size - 12) return false;
+
+	return track.timescale > 0;
+}
+
+// first sample description of a track, the format and its size
+static bool getSampleDescription(const MovTrack & track, const unsigned char *& entry, size_t & entrySize) {
+	if (readBE32(track.stsd.data + 4) == 0 || track.stsd.size < 16) return false;
+	entry = track.stsd.data + 8;
+	entrySize = readBE32(entry);
+	return entrySize >= 16 && entrySize <= track.stsd.size - 8;
+}
+
+// sample times from the run length coded stts table
+class MovTimeToSample {
+
+public:
+
+	MovTimeToSample(const MovAtom & stts) {
+		m_entries = stts.data + 8;
+		m_numEntries = readBE32(stts.data + 4);
+		m_entry = 0;
+		m_left = m_numEntries > 0 ? readBE32(m_entries) : 0;
+		m_delta = m_numEntries > 0 ? readBE32(m_entries + 4) : 0;
+		m_ticks = 0;
+	}
+
+	// ticks at the start of the next sample, then moves past count samples
+	uint64_t skip(uint64_t count) {
+		uint64_t ticks = m_ticks;
+		while (count > 0) {
+			if (m_left == 0 && m_entry + 1 < m_numEntries) {
+				m_entry++;
+				m_left = readBE32(m_entries + 8 * m_entry);
+				m_delta = readBE32(m_entries + 8 * m_entry + 4);
+				continue;
+			}
+			// past the table the last duration repeats
+			uint64_t n = m_left > 0 && m_left < count ? m_left : count;
+			m_ticks += n * m_delta;
+			m_left = m_left > n ? m_left - n : 0;
+			count -= n;
+		}
+		return ticks;
+	}
+
+	uint64_t getTicks() const { return m_ticks; }
+
+private:
+
+	const unsigned char * m_entries;
+	uint32_t m_numEntries;
+	uint32_t m_entry;
+	uint64_t m_left;		// samples left in the current entry
+	uint32_t m_delta;
+	uint64_t m_ticks;
+};
+
+// chunks with their offset and the samples they hold, from stco/co64 and the stsc runs
+struct MovChunk {
+	uint64_t offset;
+	uint64_t firstSample;
+	uint32_t samples;
+};
+
+static void getChunks(const MovTrack & track, std::vector<MovChunk> & chunks) {
+	uint32_t numChunks = readBE32(track.stco.data + 4);
+	uint32_t numRuns = readBE32(track.stsc.data + 4);
+	const unsigned char * offsets = track.stco.data + 8;
+	const unsigned char * runs = track.stsc.data + 8;
+
+	chunks.resize(numChunks);
+	uint64_t sample = 0;
+	uint32_t run = 0;
+	for (uint32_t i = 0; i < numChunks; i++) {
+		// runs start at a 1 based chunk number and last until the next run
+		while (run + 1 < numRuns && readBE32(runs + 12 * (run + 1)) <= i + 1) run++;
+
+		MovChunk & chunk = chunks[i];
+		chunk.offset = track.b64BitOffsets ? readBE64(offsets + 8 * i) : readBE32(offsets + 4 * i);
+		chunk.firstSample = sample;
+		chunk.samples = numRuns > 0 ? readBE32(runs + 12 * run + 4) : 0;
+		sample += chunk.samples;
+	}
+}
+
+static HapDemuxResult indexVideo(const MovTrack & track, uint64_t fileSize, HapFrameIndex & index) {
+	uint32_t constantSize = readBE32(track.stsz.data + 4);
+	uint32_t numSamples = readBE32(track.stsz.data + 8);
+	const unsigned char * sizes = track.stsz.data + 12;
+
+	std::vector<MovChunk> chunks;
+	getChunks(track, chunks);
+	MovTimeToSample times(track.stts);
+
+	// a damaged constant size could claim billions of samples, they can't be more than the file holds
+	uint64_t maxSamples = constantSize ? fileSize / constantSize : numSamples;
+	index.frames.reserve((size_t)(numSamples < maxSamples ? numSamples : maxSamples));
+	bool bTruncated = false;
+	for (size_t c = 0; c < chunks.size() && !bTruncated; c++) {
+		uint64_t offset = chunks[c].offset;
+		for (uint32_t s = 0; s < chunks[c].samples; s++) {
+			uint64_t sample = chunks[c].firstSample + s;
+			if (sample >= numSamples) break;
+
+			HapIndexEntry entry;
+			entry.offset = offset;
+			entry.size = constantSize ? constantSize : readBE32(sizes + 4 * sample);
+			entry.time = ticksToTime(times.skip(1), track.timescale);
+
+			// a file that is still being written (or was cut) plays up to where its data ends
+			if (entry.offset > fileSize || entry.size > fileSize - entry.offset) {
+				bTruncated = true;
+				break;
+			}
+			index.frames.push_back(entry);
+			offset += entry.size;
+		}
+	}
+
+	if (index.frames.empty()) return HapDemuxResult_BadFile;
+
+	index.duration = ticksToTime(times.getTicks(), track.timescale);
+	index.frameDuration = index.duration / (int64_t)index.frames.size();
+	return HapDemuxResult_OK;
+}
+
+// little endian flag of in24/in32/fl32/fl64, in an enda atom either directly in the description or inside wave
+static bool isLittleEndianExtension(const unsigned char * extensions, size_t size) {
+	MovAtom enda, wave;
+	if (findAtom(extensions, size, MOV_TYPE('e', 'n', 'd', 'a'), enda) && enda.size >= 2) {
+		return readBE16(enda.data) != 0;
+	}
+	if (findAtom(extensions, size, MOV_TYPE('w', 'a', 'v', 'e'), wave) && findAtom(wave, MOV_TYPE('e', 'n', 'd', 'a'), enda) && enda.size >= 2) {
+		return readBE16(enda.data) != 0;
+	}
+	return false;
+}
+
+static void indexAudio(const MovTrack & track, uint64_t fileSize, HapAudioTrack & audio) {
+	audio.bPresent = true;
+
+	const unsigned char * entry;
+	size_t entrySize;
+	if (!getSampleDescription(track, entry, entrySize) || entrySize < 36) return;
+	audio.codec = HAP_FOURCC(entry[4], entry[5], entry[6], entry[7]);
+	uint32_t format = readBE32(entry + 4);
+
+	int version = readBE16(entry + 16);
+	int bytesPerFrame = 0;
+	uint32_t flags = 0;
+	size_t extensionsOffset = 36;
+	if (version == 2) {
+		if (entrySize < 72) return;
+		double sampleRate;
+		uint64_t bits = readBE64(entry + 40);
+		memcpy(&sampleRate, &bits, sizeof(sampleRate));
+		audio.sampleRate = (int)(sampleRate + 0.5);
+		audio.channels = (int)readBE32(entry + 48);
+		audio.bitsPerSample = (int)readBE32(entry + 56);
+		flags = readBE32(entry + 60);
+		bytesPerFrame = (int)readBE32(entry + 64);
+		extensionsOffset = 72;
+	}
+	else {
+		audio.channels = readBE16(entry + 24);
+		audio.bitsPerSample = readBE16(entry + 26);
+		audio.sampleRate = (int)(readBE32(entry + 32) >> 16);
+		if (version == 1 && entrySize >= 52) {
+			bytesPerFrame = (int)readBE32(entry + 44);
+			extensionsOffset = 52;
+		}
+	}
+	bool bLittleEndianExtension = isLittleEndianExtension(entry + extensionsOffset, entrySize - extensionsOffset);
+
+	switch (format) {
+	case MOV_TYPE('r', 'a', 'w', ' '): audio.bitsPerSample = 8; break;
+	case MOV_TYPE('t', 'w', 'o', 's'): audio.bBigEndian = audio.bitsPerSample > 8; break;
+	case MOV_TYPE('s', 'o', 'w', 't'): break;
+	case MOV_TYPE('i', 'n', '2', '4'): audio.bitsPerSample = 24; audio.bBigEndian = !bLittleEndianExtension; break;
+	case MOV_TYPE('i', 'n', '3', '2'): audio.bitsPerSample = 32; audio.bBigEndian = !bLittleEndianExtension; break;
+	case MOV_TYPE('f', 'l', '3', '2'): audio.bitsPerSample = 32; audio.bFloat = true; audio.bBigEndian = !bLittleEndianExtension; break;
+	case MOV_TYPE('f', 'l', '6', '4'): audio.bitsPerSample = 64; audio.bFloat = true; audio.bBigEndian = !bLittleEndianExtension; break;
+	case MOV_TYPE('l', 'p', 'c', 'm'):
+		if (version != 2) return;
+		audio.bFloat = (flags & MOV_FLAG_FLOAT) != 0;
+		audio.bBigEndian = (flags & MOV_FLAG_BIG_ENDIAN) != 0;
+		break;
+	default:
+		// compressed, a splitter has to handle it
+		return;
+	}
+
+	if (audio.channels <= 0 || audio.sampleRate <= 0 || audio.bitsPerSample <= 0 || audio.bitsPerSample % 8) return;
+	if (bytesPerFrame <= 0) bytesPerFrame = audio.channels * audio.bitsPerSample / 8;
+
+	// old files count single bytes as samples with a size of 1, newer ones give the frame size
+	uint32_t constantSize = readBE32(track.stsz.data + 4);
+	if (constantSize > 1) bytesPerFrame = (int)constantSize;
+	else if (constantSize == 0) return;
+
+	std::vector<MovChunk> chunks;
+	getChunks(track, chunks);
+	MovTimeToSample times(track.stts);
+
+	audio.chunks.reserve(chunks.size());
+	for (size_t c = 0; c < chunks.size(); c++) {
+		HapIndexEntry chunk;
+		uint64_t size = (uint64_t)chunks[c].samples * bytesPerFrame;
+		chunk.offset = chunks[c].offset;
+		chunk.time = ticksToTime(times.skip(chunks[c].samples), track.timescale);
+		if (size > 0xFFFFFFFF || chunk.offset > fileSize || size > fileSize - chunk.offset) break;
+		chunk.size = (uint32_t)size;
+		audio.chunks.push_back(chunk);
+	}
+	audio.bPCM = true;
+}
+
+bool HapMovDemuxer::isMovFile(const unsigned char * header, size_t size) {
+	if (size < 8) return false;
+
+	uint32_t atomSize = readBE32(header);
+	if (atomSize != 0 && atomSize != 1 && atomSize < 8) return false;
+
+	switch (readBE32(header + 4)) {
+	case MOV_TYPE('f', 't', 'y', 'p'):
+	case MOV_TYPE('m', 'o', 'o', 'v'):
+	case MOV_TYPE('m', 'd', 'a', 't'):
+	case MOV_TYPE('w', 'i', 'd', 'e'):
+	case MOV_TYPE('f', 'r', 'e', 'e'):
+	case MOV_TYPE('s', 'k', 'i', 'p'):
+	case MOV_TYPE('p', 'n', 'o', 't'):
+		return true;
+	}
+	return false;
+}
+
+HapDemuxResult HapMovDemuxer::buildIndex(const HapMediaFile & file, HapFrameIndex & index) {
+	index.clear();
+
+	// top level atoms, only their headers are read
+	uint64_t fileSize = file.getSize();
+	uint64_t position = 0;
+	uint64_t moovOffset = 0;
+	uint64_t moovSize = 0;
+	while (fileSize - position >= 8) {
+		unsigned char header[16];
+		if (!file.read(position, header, 8)) return HapDemuxResult_ReadError;
+
+		uint64_t size = readBE32(header);
+		uint64_t headerSize = 8;
+		if (size == 1) {
+			if (fileSize - position < 16 || !file.read(position + 8, header + 8, 8)) return HapDemuxResult_BadFile;
+			size = readBE64(header + 8);
+			headerSize = 16;
+		}
+		else if (size == 0) {
+			size = fileSize - position;
+		}
+		if (size < headerSize || size > fileSize - position) break;
+
+		if (readBE32(header + 4) == MOV_TYPE('m', 'o', 'o', 'v')) {
+			moovOffset = position + headerSize;
+			moovSize = size - headerSize;
+			break;
+		}
+		position += size;
+	}
+	if (moovSize == 0) return HapDemuxResult_BadFile;
+
+	HapFileView moovView;
+	if (!file.map(moovOffset, moovSize, moovView)) return HapDemuxResult_ReadError;
+	MovAtom moov;
+	moov.type = MOV_TYPE('m', 'o', 'o', 'v');
+	moov.data = moovView.getData();
+	moov.size = moovView.getSize();
+
+	HapDemuxResult result = HapDemuxResult_NoHapTrack;
+	const unsigned char * p = moov.data;
+	const unsigned char * end = moov.data + moov.size;
+	MovAtom trak;
+	while (nextAtom(p, end, trak)) {
+		MovTrack track;
+		if (trak.type != MOV_TYPE('t', 'r', 'a', 'k') || !parseTrack(trak, track)) continue;
+
+		if (track.handler == MOV_TYPE('v', 'i', 'd', 'e') && index.frames.empty()) {
+			const unsigned char * entry;
+			size_t entrySize;
+			if (!getSampleDescription(track, entry, entrySize) || entrySize < 36) continue;
+
+			index.codec = HAP_FOURCC(entry[4], entry[5], entry[6], entry[7]);
+			DXTTextureFormat format;
+			if (!index.getTextureFormat(format)) continue;
+			index.width = readBE16(entry + 32);
+			index.height = readBE16(entry + 34);
+
+			result = indexVideo(track, fileSize, index);
+		}
+		else if (track.handler == MOV_TYPE('s', 'o', 'u', 'n') && !index.audio.bPresent) {
+			indexAudio(track, fileSize, index.audio);
+		}
+	}
+
+	if (result != HapDemuxResult_OK) {
+		HapAudioTrack audio = index.audio;
+		index.clear();
+		index.audio = audio;
+	}
+	return result;
+}
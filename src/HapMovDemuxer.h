@@ -0,0 +1,22 @@
+// HapMovDemuxer - QuickTime (.mov) and MP4 sample tables to a HapFrameIndex
+//
+// Portable. Walks the top level atoms to the moov atom (skipping mdat with a single seek,
+// however large), maps it and reads the stsd, stts, stsc, stsz and stco/co64 tables of the
+// HAP video track and of the audio track, if it is PCM. Edit lists are ignored.
+// See https://developer.apple.com/documentation/quicktime-file-format
+
+#pragma once
+
+#include <stddef.h>
+
+#include "HapDemuxer.h"
+
+class HapMovDemuxer {
+
+public:
+
+	// whether the first bytes of a file look like a QuickTime/MP4 atom
+	static bool isMovFile(const unsigned char * header, size_t size);
+
+	static HapDemuxResult buildIndex(const HapMediaFile & file, HapFrameIndex & index);
+};
@@ -0,0 +1,71 @@
+#include "HapPlayhead.h"
+
+HapPlayhead::HapPlayhead() {
+	m_frameCount = 0;
+	m_mode = HapLoopMode_None;
+	m_inFrame = 0;
+	m_outFrame = -1;
+	m_direction = 1;
+	m_frame = 0;
+	m_lastFrame = -1;
+}
+
+void HapPlayhead::setFrameCount(int frameCount) {
+	m_frameCount = frameCount > 0 ? frameCount : 0;
+	setLoop(m_mode, m_inFrame, m_outFrame);
+}
+
+void HapPlayhead::setLoop(HapLoopMode mode, int inFrame, int outFrame) {
+	int last = m_frameCount - 1;
+	if (outFrame < 0 || outFrame > last) outFrame = last;
+	if (inFrame < 0) inFrame = 0;
+	if (inFrame > outFrame) inFrame = outFrame;
+	m_mode = mode;
+	m_inFrame = inFrame;
+	m_outFrame = outFrame;
+}
+
+void HapPlayhead::setDirection(int direction) {
+	direction = direction < 0 ? -1 : 1;
+	if (direction != m_direction && m_lastFrame >= 0) m_frame = m_lastFrame + direction;
+	m_direction = direction;
+}
+
+void HapPlayhead::seek(int frame) {
+	m_frame = frame;
+	m_lastFrame = -1;
+}
+
+int HapPlayhead::next(bool * pbWrapped) {
+	if (pbWrapped) *pbWrapped = false;
+	if (m_frameCount <= 0) return -1;
+
+	if (m_mode == HapLoopMode_None) {
+		if (m_frame < 0 || m_frame >= m_frameCount) return -1;
+		m_lastFrame = m_frame;
+		m_frame += m_direction;
+		return m_lastFrame;
+	}
+
+	// past a region end in the direction of play
+	if ((m_direction > 0 && m_frame > m_outFrame) || (m_direction < 0 && m_frame < m_inFrame)) {
+		bool bForward = m_direction > 0;
+		if (m_mode == HapLoopMode_Palindrome && m_outFrame > m_inFrame) {
+			// the frame at the end was the last one delivered, step back from it
+			m_direction = -m_direction;
+			m_frame = bForward ? m_outFrame - 1 : m_inFrame + 1;
+		}
+		else {
+			m_frame = bForward ? m_inFrame : m_outFrame;
+		}
+		if (pbWrapped) *pbWrapped = true;
+	}
+	// entering the region from outside against the direction of play, e.g. after a seek
+	else if (m_frame < 0 || m_frame >= m_frameCount) {
+		m_frame = m_direction > 0 ? m_inFrame : m_outFrame;
+	}
+
+	m_lastFrame = m_frame;
+	m_frame += m_direction;
+	return m_lastFrame;
+}
@@ -0,0 +1,53 @@
+// HapPlayhead - the order a source delivers frames in: forward or backward, looping over a region
+//
+// Portable. HAP frames are all keyframes, so any frame can follow any other at the same cost and
+// loops and turns need no seek. The region is inclusive and only used while looping; a clip
+// that doesn't loop plays to its first or last frame. A palindrome turns at the region ends
+// without showing the end frame twice. Copies are cheap, so a copy can be stepped ahead to
+// find out which frames come next.
+
+#pragma once
+
+enum HapLoopMode {
+	HapLoopMode_None,
+	HapLoopMode_Loop,
+	HapLoopMode_Palindrome
+};
+
+class HapPlayhead {
+
+public:
+
+	HapPlayhead();
+
+	void setFrameCount(int frameCount);
+	int getFrameCount() const { return m_frameCount; }
+
+	// clamped to the clip, outFrame < 0 = the last frame
+	void setLoop(HapLoopMode mode, int inFrame = 0, int outFrame = -1);
+	HapLoopMode getLoopMode() const { return m_mode; }
+	int getInFrame() const { return m_inFrame; }
+	int getOutFrame() const { return m_outFrame; }
+
+	// 1 = forward, -1 = backward, carries on from the frame delivered last
+	void setDirection(int direction);
+	int getDirection() const { return m_direction; }
+
+	// the next frame, may lie outside the region, which is entered at the next boundary
+	void seek(int frame);
+	int getFrame() const { return m_frame; }
+
+	// the frame to deliver, -1 at the end of a clip that doesn't loop. bWrapped is set when a
+	// loop restarted or a palindrome turned
+	int next(bool * pbWrapped = 0);
+
+private:
+
+	int m_frameCount;
+	HapLoopMode m_mode;
+	int m_inFrame;
+	int m_outFrame;
+	int m_direction;
+	int m_frame;
+	int m_lastFrame;		// delivered since the last seek, -1 = none
+};
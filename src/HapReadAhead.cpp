@@ -0,0 +1,119 @@
+#include "HapReadAhead.h"
+
+#include <string.h>
+
+#include "HapFrameIndex.h"
+#include "HapMediaFile.h"
+
+HapReadAhead::HapReadAhead() : m_client(DXTTaskPriority_Low), m_hits(0), m_misses(0), m_wasted(0) {
+	m_file = NULL;
+	m_index = NULL;
+	m_pool = NULL;
+	m_depth = 0;
+	for (int i = 0; i < HAP_READAHEAD_MAX_FRAMES; i++) {
+		m_slots[i].frame = -1;
+		m_slots[i].bOK = false;
+		m_slots[i].group.setClient(&m_client);
+	}
+}
+
+HapReadAhead::~HapReadAhead() {
+	clear();
+}
+
+void HapReadAhead::setSource(const HapMediaFile * file, const HapFrameIndex * index, DXTThreadPool * pool) {
+	clear();
+	m_file = file;
+	m_index = index;
+	m_pool = pool;
+}
+
+void HapReadAhead::setDepth(int frames) {
+	clear();
+	if (frames < 0) frames = 0;
+	if (frames > HAP_READAHEAD_MAX_FRAMES) frames = HAP_READAHEAD_MAX_FRAMES;
+	m_depth = frames;
+	for (int i = m_depth; i < HAP_READAHEAD_MAX_FRAMES; i++) {
+		std::vector<unsigned char>().swap(m_slots[i].data);
+	}
+}
+
+void HapReadAhead::schedule(const int * frames, int count) {
+	if (m_depth <= 0 || !m_pool || !m_index) return;
+	if (count > m_depth) count = m_depth;
+
+	for (int i = 0; i < count; i++) {
+		int frame = frames[i];
+		if (frame < 0 || frame >= m_index->getFrameCount() || findSlot(frame)) continue;
+
+		// a buffer whose read has finished and that holds none of the upcoming frames
+		Slot * slot = NULL;
+		for (int s = 0; s < m_depth && !slot; s++) {
+			Slot & candidate = m_slots[s];
+			if (!candidate.group.isDone()) continue;
+			bool bNeeded = false;
+			for (int j = 0; j < count && !bNeeded; j++) {
+				bNeeded = candidate.frame >= 0 && candidate.frame == frames[j];
+			}
+			if (!bNeeded) slot = &candidate;
+		}
+		if (!slot) break;
+
+		if (slot->frame >= 0) m_wasted++;
+		uint32_t size = m_index->getFrame(frame).size;
+		if (slot->data.size() < size) slot->data.resize(size);
+		slot->frame = frame;
+		slot->bOK = false;
+		m_pool->submit(slot->group, readSlot, this, (int)(slot - m_slots));
+	}
+}
+
+bool HapReadAhead::read(int frame, void * dst, size_t capacity) {
+	if (!m_index || frame < 0 || frame >= m_index->getFrameCount()) return false;
+
+	Slot * slot = findSlot(frame);
+	if (slot) {
+		m_pool->wait(slot->group);
+		uint32_t size = m_index->getFrame(frame).size;
+		bool bOK = slot->bOK && size <= capacity;
+		if (bOK) memcpy(dst, slot->data.data(), size);
+		slot->frame = -1;
+		if (bOK) {
+			m_hits++;
+			return true;
+		}
+	}
+
+	m_misses++;
+	return m_index->readFrame(*m_file, frame, dst, capacity);
+}
+
+void HapReadAhead::clear() {
+	for (int i = 0; i < HAP_READAHEAD_MAX_FRAMES; i++) {
+		Slot & slot = m_slots[i];
+		if (m_pool) m_pool->wait(slot.group);
+		if (slot.frame >= 0) m_wasted++;
+		slot.frame = -1;
+	}
+}
+
+HapReadAheadStats HapReadAhead::getStats() const {
+	HapReadAheadStats stats;
+	stats.hits = m_hits.load();
+	stats.misses = m_misses.load();
+	stats.wasted = m_wasted.load();
+	return stats;
+}
+
+void HapReadAhead::readSlot(void * arg, int index) {
+	HapReadAhead * self = (HapReadAhead*)arg;
+	Slot & slot = self->m_slots[index];
+	slot.bOK = self->m_index->readFrame(*self->m_file, slot.frame, slot.data.data(), slot.data.size());
+}
+
+HapReadAhead::Slot * HapReadAhead::findSlot(int frame) {
+	for (int i = 0; i < m_depth; i++) {
+		if (m_slots[i].frame == frame) return &m_slots[i];
+	}
+	return NULL;
+}
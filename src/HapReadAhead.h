@@ -0,0 +1,79 @@
+// HapReadAhead - reads the frames a source will ask for next on the thread pool
+//
+// Portable. The source tells it which frames come next, in whatever order it plays them
+// (backward, palindrome, loop regions), and each one is read into a buffer of its own on the
+// pool, at low priority, while the current frame is delivered. The OS only reads ahead for
+// forward sequential access, this covers the rest. A frame that wasn't read ahead is read
+// directly. All methods except getStats() belong to one thread (the streaming thread).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#include "DXTThreadPool.h"
+
+class HapMediaFile;
+struct HapFrameIndex;
+
+#define HAP_READAHEAD_MAX_FRAMES 8
+
+struct HapReadAheadStats {
+	uint64_t hits;			// frames that were read ahead
+	uint64_t misses;		// read when they were asked for
+	uint64_t wasted;		// read ahead and never asked for, e.g. after a seek
+};
+
+class HapReadAhead {
+
+public:
+
+	HapReadAhead();
+	~HapReadAhead();
+
+	// the file and index must outlive the reads, waits for the ones in flight
+	void setSource(const HapMediaFile * file, const HapFrameIndex * index, DXTThreadPool * pool);
+	// 0 = off, the buffers are released
+	void setDepth(int frames);
+	int getDepth() const { return m_depth; }
+
+	// frames that come next, the first one first. Frames that are buffered or being read stay,
+	// the others start reading into buffers no longer needed
+	void schedule(const int * frames, int count);
+
+	// copies frame into dst, waiting if it is still being read, else reads it from the file
+	bool read(int frame, void * dst, size_t capacity);
+
+	// waits for the reads in flight and forgets all buffered frames
+	void clear();
+
+	HapReadAheadStats getStats() const;
+
+private:
+
+	struct Slot {
+		int frame;					// -1 = free
+		std::vector<unsigned char> data;
+		bool bOK;
+		DXTTaskGroup group;
+	};
+
+	static void readSlot(void * arg, int index);
+	Slot * findSlot(int frame);
+
+	const HapMediaFile * m_file;
+	const HapFrameIndex * m_index;
+	DXTThreadPool * m_pool;
+	DXTTaskClient m_client;
+	int m_depth;
+	Slot m_slots[HAP_READAHEAD_MAX_FRAMES];
+
+	std::atomic<uint64_t> m_hits;
+	std::atomic<uint64_t> m_misses;
+	std::atomic<uint64_t> m_wasted;
+
+	HapReadAhead(const HapReadAhead &);
+	HapReadAhead & operator=(const HapReadAhead &);
+};
@@ -0,0 +1,219 @@
+#include "ofxDirectShowDXTPlayerPool.h"
+
+// switches kept for getSwitches()
+#define MAX_SWITCH_HISTORY 256
+
+ofxDirectShowDXTPlayerPool::ofxDirectShowDXTPlayerPool(){
+	m_memoryBudget = 0;
+	m_useCounter = 0;
+	resetStats();
+}
+
+ofxDirectShowDXTPlayerPool::~ofxDirectShowDXTPlayerPool(){
+	close();
+}
+
+void ofxDirectShowDXTPlayerPool::setup(int maxPlayers, size_t memoryBudget){
+	close();
+	m_memoryBudget = memoryBudget;
+	m_slots.resize(MAX(maxPlayers, 1));
+	for (size_t i = 0; i < m_slots.size(); i++){
+		Slot & slot = m_slots[i];
+		slot.player = new ofxDirectShowDXTVideoPlayer();
+		slot.bAcquired = false;
+		slot.lastUsed = 0;
+		slot.bSwitchPending = false;
+		slot.switchStart = 0;
+	}
+}
+
+void ofxDirectShowDXTPlayerPool::close(){
+	for (size_t i = 0; i < m_slots.size(); i++){
+		delete m_slots[i].player;
+	}
+	m_slots.clear();
+}
+
+void ofxDirectShowDXTPlayerPool::preload(string path){
+	path = ofToDataPath(path);
+	Slot * slot = findSlot(path);
+	if (slot){
+		slot->lastUsed = ++m_useCounter;
+		return;
+	}
+
+	slot = takeSlot();
+	if (!slot){
+		ofLogWarning("ofxDirectShowDXTPlayerPool") << "All players are acquired, can't preload " << path;
+		return;
+	}
+	slot->path = path;
+	slot->lastUsed = ++m_useCounter;
+	// waiting clips decode behind the ones on screen
+	slot->player->setDecodePriority(DXTTaskPriority_Low);
+	slot->player->loadAsync(path);
+	m_stats.preloads++;
+}
+
+bool ofxDirectShowDXTPlayerPool::isPreloaded(string path) const {
+	const Slot * slot = findSlot(ofToDataPath(path));
+	return slot && slot->player->isReady();
+}
+
+ofxDirectShowDXTVideoPlayer * ofxDirectShowDXTPlayerPool::acquire(string path){
+	uint64_t start = ofGetElapsedTimeMicros();
+	path = ofToDataPath(path);
+
+	Slot * slot = findSlot(path);
+	if (!slot){
+		preload(path);
+		slot = findSlot(path);
+		if (!slot) return NULL;
+	}
+
+	slot->bAcquired = true;
+	slot->lastUsed = ++m_useCounter;
+	slot->player->setDecodePriority(DXTTaskPriority_High);
+	if (slot->player->isReady()){
+		recordSwitch(path, true, (double)(ofGetElapsedTimeMicros() - start));
+	}
+	else {
+		// measured when update() sees its first frame in the texture
+		slot->bSwitchPending = true;
+		slot->switchStart = start;
+	}
+	return slot->player;
+}
+
+void ofxDirectShowDXTPlayerPool::release(ofxDirectShowDXTVideoPlayer * player){
+	for (size_t i = 0; i < m_slots.size(); i++){
+		Slot & slot = m_slots[i];
+		if (slot.player != player) continue;
+
+		slot.bAcquired = false;
+		slot.bSwitchPending = false;
+		slot.lastUsed = ++m_useCounter;
+		slot.player->setDecodePriority(DXTTaskPriority_Low);
+		if (slot.player->isLoaded()){
+			// a paused graph prerolls the frame it was moved to, the next cue starts there
+			slot.player->setPaused(true);
+			slot.player->setPosition(0.0);
+		}
+		return;
+	}
+}
+
+void ofxDirectShowDXTPlayerPool::update(){
+	for (size_t i = 0; i < m_slots.size(); i++){
+		Slot & slot = m_slots[i];
+		if (slot.path.empty()) continue;
+
+		slot.player->update();
+
+		// the player logged why, an acquired one stays with its owner
+		DXTLoadState state = slot.player->getLoadState();
+		if ((state == DXTLoadState_Failed || state == DXTLoadState_Cancelled) && !slot.bAcquired){
+			evict(slot);
+			continue;
+		}
+		if (slot.bSwitchPending && slot.player->isReady()){
+			slot.bSwitchPending = false;
+			recordSwitch(slot.path, false, (double)(ofGetElapsedTimeMicros() - slot.switchStart));
+		}
+	}
+
+	// a clip's size is only known once it's loaded, so the budget is enforced afterwards.
+	// Textures kept by free players go first, then the least recently used clips
+	while (m_memoryBudget > 0 && getMemoryUsage() > m_memoryBudget){
+		Slot * victim = NULL;
+		for (size_t i = 0; i < m_slots.size(); i++){
+			Slot & slot = m_slots[i];
+			if (slot.bAcquired || slot.player->getMemoryUsage() == 0) continue;
+			if (slot.path.empty()){
+				victim = &slot;
+				break;
+			}
+			if (!victim || slot.lastUsed < victim->lastUsed) victim = &slot;
+		}
+		if (!victim) break;
+		if (victim->path.empty()) victim->player->clearTexture();
+		else evict(*victim);
+	}
+}
+
+size_t ofxDirectShowDXTPlayerPool::getMemoryUsage() const {
+	size_t bytes = 0;
+	for (size_t i = 0; i < m_slots.size(); i++){
+		bytes += m_slots[i].player->getMemoryUsage();
+	}
+	return bytes;
+}
+
+DXTPlayerPoolStats ofxDirectShowDXTPlayerPool::getStats() const {
+	DXTPlayerPoolStats stats = m_stats;
+	stats.memoryUsage = getMemoryUsage();
+	return stats;
+}
+
+void ofxDirectShowDXTPlayerPool::resetStats(){
+	m_stats.switches = 0;
+	m_stats.warmSwitches = 0;
+	m_stats.preloads = 0;
+	m_stats.evictions = 0;
+	m_stats.lastLatencyMicros = 0.0;
+	m_stats.averageLatencyMicros = 0.0;
+	m_stats.maxLatencyMicros = 0.0;
+	m_stats.memoryUsage = 0;
+	m_switches.clear();
+}
+
+ofxDirectShowDXTPlayerPool::Slot * ofxDirectShowDXTPlayerPool::findSlot(const string & path){
+	for (size_t i = 0; i < m_slots.size(); i++){
+		if (m_slots[i].path == path) return &m_slots[i];
+	}
+	return NULL;
+}
+
+const ofxDirectShowDXTPlayerPool::Slot * ofxDirectShowDXTPlayerPool::findSlot(const string & path) const {
+	for (size_t i = 0; i < m_slots.size(); i++){
+		if (m_slots[i].path == path) return &m_slots[i];
+	}
+	return NULL;
+}
+
+// a free slot, else the least recently used one that isn't acquired
+ofxDirectShowDXTPlayerPool::Slot * ofxDirectShowDXTPlayerPool::takeSlot(){
+	Slot * victim = NULL;
+	for (size_t i = 0; i < m_slots.size(); i++){
+		Slot & slot = m_slots[i];
+		if (slot.path.empty()) return &slot;
+		if (slot.bAcquired) continue;
+		if (!victim || slot.lastUsed < victim->lastUsed) victim = &slot;
+	}
+	if (victim) evict(*victim);
+	return victim;
+}
+
+void ofxDirectShowDXTPlayerPool::evict(Slot & slot){
+	// the player and its texture stay for the next clip, unless the budget needs the memory
+	slot.player->close();
+	slot.path.clear();
+	slot.bAcquired = false;
+	slot.bSwitchPending = false;
+	m_stats.evictions++;
+}
+
+void ofxDirectShowDXTPlayerPool::recordSwitch(const string & path, bool bWarm, double latencyMicros){
+	m_stats.switches++;
+	if (bWarm) m_stats.warmSwitches++;
+	m_stats.lastLatencyMicros = latencyMicros;
+	m_stats.averageLatencyMicros += (latencyMicros - m_stats.averageLatencyMicros) / m_stats.switches;
+	m_stats.maxLatencyMicros = MAX(m_stats.maxLatencyMicros, latencyMicros);
+
+	DXTPlayerSwitch record;
+	record.path = path;
+	record.bWarm = bWarm;
+	record.latencyMicros = latencyMicros;
+	m_switches.push_back(record);
+	if (m_switches.size() > MAX_SWITCH_HISTORY) m_switches.pop_front();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxDirectShowDXTVideoPlayer.h"
+
+// one cue: how long from acquire() until the clip's first frame was in its texture
+struct DXTPlayerSwitch {
+	string path;
+	bool bWarm;			// preloaded and ready when it was acquired
+	double latencyMicros;
+};
+
+struct DXTPlayerPoolStats {
+	uint64_t switches;
+	uint64_t warmSwitches;
+	uint64_t preloads;		// loads started, by preload() or a cold acquire()
+	uint64_t evictions;
+	double lastLatencyMicros;
+	double averageLatencyMicros;
+	double maxLatencyMicros;
+	size_t memoryUsage;		// bytes held by all players
+};
+
+// keeps clips loaded up to their first frame, so switching to one is a pointer handover.
+// Players are reused, a clip of the same size keeps the texture of the one before it while the
+// memory budget allows. The least recently used clips that aren't acquired are closed to stay
+// within the player count and the memory budget. All players are updated by the pool, don't call update() on them.
+class ofxDirectShowDXTPlayerPool {
+
+	public:
+
+		ofxDirectShowDXTPlayerPool();
+		~ofxDirectShowDXTPlayerPool();
+
+		// memoryBudget 0 = only limited by the number of players
+		void setup(int maxPlayers, size_t memoryBudget = 0);
+		void close();
+
+		// starts loading a clip on the loader thread, nothing to do if it's loaded or loading already
+		void preload(string path);
+		bool isPreloaded(string path) const; // first frame in the texture
+
+		// the clip's player, ready right away if it was preloaded, else check isReady() before drawing it.
+		// Acquired players are never evicted, NULL if every player is acquired
+		ofxDirectShowDXTVideoPlayer * acquire(string path);
+		// pauses the player back at the clip's first frame, the clip stays loaded for the next cue
+		void release(ofxDirectShowDXTVideoPlayer * player);
+
+		// finishes loads, updates all players and evicts what's over the budget, call once per frame
+		void update();
+
+		int getMaxPlayers() const { return (int)m_slots.size(); }
+		size_t getMemoryBudget() const { return m_memoryBudget; }
+		size_t getMemoryUsage() const;
+
+		DXTPlayerPoolStats getStats() const;
+		const deque<DXTPlayerSwitch> & getSwitches() const { return m_switches; } // the most recent, oldest first
+		void resetStats();
+
+	protected:
+
+		struct Slot {
+			ofxDirectShowDXTVideoPlayer * player;
+			string path;		// empty when the slot is free
+			bool bAcquired;
+			uint64_t lastUsed;
+			bool bSwitchPending;	// acquired before it was ready
+			uint64_t switchStart;
+		};
+
+		Slot * findSlot(const string & path);
+		const Slot * findSlot(const string & path) const;
+		Slot * takeSlot();
+		void evict(Slot & slot);
+		void recordSwitch(const string & path, bool bWarm, double latencyMicros);
+
+		vector<Slot> m_slots;
+		size_t m_memoryBudget;
+		uint64_t m_useCounter;
+		DXTPlayerPoolStats m_stats;
+		deque<DXTPlayerSwitch> m_switches;
+};
@@ -10,34 +10,171 @@
 
 #include "ofxDirectShowDXTVideoPlayer.h"
 #include "DirectShowDXTVideo.h"
+#include "DXTBlockDecoder.h"
+#include "DXTSerialQueue.h"
 
 #define STRINGIFY(x) #x
 
+// how long an asynchronous load waits for the first decoded frame
+#define FIRST_FRAME_TIMEOUT_MS 5000
+
+struct DXTLoadJob {
+	DXTLoadJob() : player(NULL), firstFrame(NULL), state(DXTLoadState_Queued), bCancel(false) {}
+
+	string path;
+	DirectShowDXTVideo * player;
+	const DXTFrame * firstFrame;
+	std::atomic<int> state;			// DXTLoadState, Ready, Failed or Cancelled once the loader is done
+	std::atomic<bool> bCancel;
+	std::mutex mutex;
+	std::condition_variable done;
+};
+
+// never destroyed, like the decode pool. Graphs of all players are built one after the other
+static DXTSerialQueue & loadQueue() {
+	static DXTSerialQueue * queue = new DXTSerialQueue();
+	return *queue;
+}
+
+static bool isLoadFinished(const DXTLoadJob & job) {
+	return job.state.load() >= DXTLoadState_Ready;
+}
+
+static void waitForLoad(DXTLoadJob & job) {
+	std::unique_lock<std::mutex> lock(job.mutex);
+	job.done.wait(lock, [&job] { return isLoadFinished(job); });
+}
+
+static void runLoadJob(shared_ptr<DXTLoadJob> job) {
+	// the loader thread stays in the multithreaded apartment, the graph is used from the GL thread
+	// afterwards, which works as the filter graph manager and the filters are all free threaded
+	static thread_local bool bComInitialized = false;
+	if (!bComInitialized) {
+		CoInitializeEx(NULL, COINIT_MULTITHREADED);
+		bComInitialized = true;
+	}
+
+	DXTLoadState result = DXTLoadState_Cancelled;
+	if (!job->bCancel.load()) {
+		job->state = DXTLoadState_Opening;
+		if (!job->player->loadMovieManualGraph(job->path)) {
+			result = DXTLoadState_Failed;
+		}
+		else if (!job->bCancel.load()) {
+			job->state = DXTLoadState_Prerolling;
+			// no frame in time isn't an error, it shows up with the first update() after play()
+			job->firstFrame = job->player->prerollFirstFrame(FIRST_FRAME_TIMEOUT_MS, job->bCancel);
+			result = job->bCancel.load() ? DXTLoadState_Cancelled : DXTLoadState_Ready;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->state = result;
+	job->done.notify_all();
+}
+
 ofxDirectShowDXTVideoPlayer::ofxDirectShowDXTVideoPlayer(){
 	m_player = NULL;
+	m_frame = NULL;
+	m_bPixelsDirty = false;
+	m_bPixelsUsed = false;
 	m_bShaderInitialized = false;
+	m_bUseSampleLeasing = false;
+	m_bFrameScheduling = false;
+	m_displayLatency = 0.0;
 	m_width = 0;
 	m_height = 0;
+	m_compressedSize = 0;
+	m_textureFormat = TextureFormat_RGBA_DXT5;
+	m_uploadStats.uploads = 0;
+	m_uploadStats.skips = 0;
+	m_uploadStats.lastUploadMicros = 0.0;
+	m_uploadStats.averageUploadMicros = 0.0;
+	m_bUsePboUpload = false;
+	m_decodePriority = DXTTaskPriority_Normal;
+	m_decodeAheadFrames = 1;
+	m_decodeAheadBudget = 0;
+	m_loadState = DXTLoadState_Idle;
 }
 
 ofxDirectShowDXTVideoPlayer::~ofxDirectShowDXTVideoPlayer(){
 	close();
+	// the loader may still be using the players of cancelled loads
+	for (size_t i = 0; i < m_abandonedLoads.size(); i++) {
+		waitForLoad(*m_abandonedLoads[i]);
+		discardLoad(*m_abandonedLoads[i]);
+	}
 }
 
 bool ofxDirectShowDXTVideoPlayer::load(string path) {
 
 	path = ofToDataPath(path);
 
-	ofTextureData texData;
-
 	close();
-	m_player = new DirectShowDXTVideo();
-	bool bOK = m_player->loadMovieManualGraph(path);
-	if (!bOK) {
+	DirectShowDXTVideo * player = createPlayer();
+	if (!player->loadMovieManualGraph(path)) {
 		ofLogError("ofxDirectShowDXTVideoPlayer") << "Could not load video file";
-		goto error;
+		delete player;
+		m_loadState = DXTLoadState_Failed;
+		return false;
 	}
 
+	bool bOK = setupPlayer(player);
+	m_loadState = bOK ? DXTLoadState_Loaded : DXTLoadState_Failed;
+	return bOK;
+}
+
+void ofxDirectShowDXTVideoPlayer::loadAsync(string path, std::function<void(bool)> onLoaded) {
+
+	path = ofToDataPath(path);
+
+	close();
+	shared_ptr<DXTLoadJob> job = make_shared<DXTLoadJob>();
+	job->path = path;
+	// created here, COM is initialized for the player's lifetime on this thread
+	job->player = createPlayer();
+	m_loadJob = job;
+	m_onLoaded = onLoaded;
+
+	loadQueue().post([job] { runLoadJob(job); });
+}
+
+void ofxDirectShowDXTVideoPlayer::cancelLoad() {
+	if (m_loadJob) {
+		// the loader stops at its next check, update() or the destructor deletes the player afterwards
+		m_loadJob->bCancel = true;
+		m_abandonedLoads.push_back(m_loadJob);
+		m_loadJob.reset();
+		m_onLoaded = nullptr;
+		m_loadState = DXTLoadState_Cancelled;
+	}
+}
+
+DXTLoadState ofxDirectShowDXTVideoPlayer::getLoadState() const {
+	return m_loadJob ? (DXTLoadState)m_loadJob->state.load() : m_loadState;
+}
+
+bool ofxDirectShowDXTVideoPlayer::isReady() const {
+	return isLoaded() && m_uploadStats.uploads > 0;
+}
+
+DirectShowDXTVideo * ofxDirectShowDXTVideoPlayer::createPlayer() {
+	DirectShowDXTVideo * player = new DirectShowDXTVideo();
+	player->setUseSampleLeasing(m_bUseSampleLeasing);
+	player->setFrameScheduling(m_bFrameScheduling);
+	player->setDecodePriority(m_decodePriority);
+	player->setDecodeAhead(m_decodeAheadFrames, m_decodeAheadBudget);
+	return player;
+}
+
+// takes over a player with a loaded graph and allocates what lives on the GL thread, deletes the player on errors
+bool ofxDirectShowDXTVideoPlayer::setupPlayer(DirectShowDXTVideo * player) {
+
+	ofTextureData texData;
+	bool bPaused = false;
+
+	m_player = player;
+
 	m_width = m_player->getWidth();
 	m_height = m_player->getHeight();
 
@@ -70,7 +207,39 @@ bool ofxDirectShowDXTVideoPlayer::load(string path) {
 		goto error;
 	}
 
-	m_tex.allocate(texData, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+	m_compressedSize = DXTCompressedSize(m_textureFormat, m_width, m_height);
+
+	// a player reused for a clip of the same size and format keeps its texture
+	if (!m_tex.isAllocated() || m_tex.getTextureData().width != texData.width || m_tex.getTextureData().height != texData.height ||
+		m_tex.getTextureData().glInternalFormat != texData.glInternalFormat) {
+		m_tex.allocate(texData, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+	}
+
+	// the first frame of an asynchronous load goes to the texture right away
+	if (m_frame) {
+		writeToTexture(m_tex);
+	}
+
+	if (m_bUsePboUpload) {
+		if (m_player->isUsingSampleLeasing()) {
+			ofLogNotice("ofxDirectShowDXTVideoPlayer") << "Sample leasing is active, not using pixel buffer uploads";
+		}
+		else {
+			// the frame ring gets new slots, a prerolled graph prerolls again into them
+			bPaused = m_player->isPaused();
+			if (m_frame) {
+				m_player->releaseFrame(m_frame);
+				m_frame = NULL;
+				m_bPixelsDirty = false;
+			}
+			if (!m_pbo.setup(m_player->getFrameRingSize(), m_player->getFrameSize(), m_bPixelsUsed) ||
+				!m_player->setFrameStorage(m_pbo.getSlotData(), m_player->getFrameSize())) {
+				ofLogNotice("ofxDirectShowDXTVideoPlayer") << "Pixel buffer uploads not available, using client memory uploads";
+				m_pbo.clear(m_player);
+			}
+			if (bPaused) m_player->setPaused(true);
+		}
+	}
 
 //	GLenum err = glGetError();
 //	if (err != GL_NO_ERROR) {
@@ -175,38 +344,139 @@ bool ofxDirectShowDXTVideoPlayer::load(string path) {
 	return true;
 
 error:
+	 m_pbo.clear(m_player);
 	 if (m_player) {
+		 if (m_frame) m_player->releaseFrame(m_frame);
 		 delete m_player;
 		 m_player = NULL;
 	 }
+	 m_frame = NULL;
+	 m_bPixelsDirty = false;
 
 	return false;
 }
 
+// finishes the load that's done on the loader thread, deletes the players of cancelled ones
+void ofxDirectShowDXTVideoPlayer::updateLoads() {
+	for (size_t i = 0; i < m_abandonedLoads.size();) {
+		if (isLoadFinished(*m_abandonedLoads[i])) {
+			discardLoad(*m_abandonedLoads[i]);
+			m_abandonedLoads.erase(m_abandonedLoads.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+
+	if (!m_loadJob || !isLoadFinished(*m_loadJob)) return;
+
+	shared_ptr<DXTLoadJob> job = m_loadJob;
+	m_loadJob.reset();
+
+	bool bOK = false;
+	if (job->state.load() == DXTLoadState_Ready) {
+		m_frame = job->firstFrame;
+		m_bPixelsDirty = m_frame != NULL;
+		DirectShowDXTVideo * player = job->player;
+		job->player = NULL;
+		job->firstFrame = NULL;
+		bOK = setupPlayer(player);
+	}
+	else {
+		ofLogError("ofxDirectShowDXTVideoPlayer") << "Could not load video file " << job->path;
+		discardLoad(*job);
+	}
+	m_loadState = bOK ? DXTLoadState_Loaded : DXTLoadState_Failed;
+
+	// the callback may start the next load
+	std::function<void(bool)> onLoaded;
+	onLoaded.swap(m_onLoaded);
+	if (onLoaded) onLoaded(bOK);
+}
+
+void ofxDirectShowDXTVideoPlayer::discardLoad(DXTLoadJob & job) {
+	if (job.player) {
+		if (job.firstFrame) job.player->releaseFrame(job.firstFrame);
+		delete job.player;
+	}
+	job.player = NULL;
+	job.firstFrame = NULL;
+}
+
 void ofxDirectShowDXTVideoPlayer::close(){
+	cancelLoad();
+	m_loadState = DXTLoadState_Idle;
 	stop();
+	// graph is stopped now, nothing writes into the pixel buffer anymore
+	m_pbo.clear(m_player);
+	if (m_player && m_frame){
+		m_player->releaseFrame(m_frame);
+	}
+	m_frame = NULL;
+	m_bPixelsDirty = false;
+	m_uploadedVersions.clear();
+	m_uploadStats.uploads = 0;
+	m_uploadStats.skips = 0;
+	m_uploadStats.lastUploadMicros = 0.0;
+	m_uploadStats.averageUploadMicros = 0.0;
 	if (m_player){
 		delete m_player;
 		m_player = NULL;
 	}
 }
 
+void ofxDirectShowDXTVideoPlayer::clearTexture(){
+	// an open or loading player draws from them
+	if (m_player || m_loadJob) return;
+	m_tex.clear();
+	m_pix.clear();
+	m_uploadedVersions.clear();
+}
+
 ofTexture * ofxDirectShowDXTVideoPlayer::getTexture() {
     return &this->m_tex;
 }
 
 void ofxDirectShowDXTVideoPlayer::update(){
+	updateLoads();
 	if(m_player && m_player->isLoaded() ){
         this->writeToTexture(this->m_tex);
 		m_player->update();
+
+		DXTGraphEvent event;
+		while (m_player && m_player->pollGraphEvent(event)){
+			ofNotifyEvent(graphEvent, event, this);
+		}
 	}
 }
 
 void ofxDirectShowDXTVideoPlayer::writeToTexture(ofTexture &texture) {
 
-	m_player->getPixels(m_pix.getData());
+	// hold on to the newest frame until a newer one arrives, the ring never blocks the streaming thread
+	if (m_pbo.isAllocated()) m_pbo.collect(m_player);
+
+	const DXTFrame * frame = m_bFrameScheduling ? m_player->acquireFrameForDisplay(m_displayLatency) : m_player->acquireFrame();
+	if (frame) {
+		if (m_frame) releaseFrame(m_frame);
+		m_frame = frame;
+		m_bPixelsDirty = true;
+	}
+	if (!m_frame) return;
+
     ofTextureData texData = texture.getTextureData();
 
+	// every texture remembers which frame it holds, only stale ones get uploaded
+	uint64_t & uploadedVersion = m_uploadedVersions[texData.textureID];
+	if (uploadedVersion == m_frame->sequence) {
+		m_uploadStats.skips++;
+		return;
+	}
+	if (m_frame->size < m_compressedSize) {
+		ofLogVerbose("ofxDirectShowDXTVideoPlayer") << "Incomplete frame " << m_frame->frameIndex << ", not uploaded";
+		uploadedVersion = m_frame->sequence;
+		return;
+	}
+
     if (!ofIsGLProgrammableRenderer())
     {
         glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
@@ -215,16 +485,16 @@ void ofxDirectShowDXTVideoPlayer::writeToTexture(ofTexture &texture) {
 
     glBindTexture(GL_TEXTURE_2D, texData.textureID);
 
-    GLint dataLength = 0;
+    uint64_t uploadStart = ofGetElapsedTimeMicros();
 
-    if (m_textureFormat == TextureFormat_RGB_DXT1){
-        dataLength = m_width * m_height / 2;
-    }
-    else {
-        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &dataLength);
+    if (!m_pbo.isAllocated() || !m_pbo.upload(m_frame, m_width, m_height, texData.glInternalFormat, m_compressedSize)) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, texData.glInternalFormat, m_compressedSize, m_frame->data);
     }
 
-    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, texData.glInternalFormat, dataLength, m_pix.getData());
+    uploadedVersion = m_frame->sequence;
+    m_uploadStats.uploads++;
+    m_uploadStats.lastUploadMicros = (double)(ofGetElapsedTimeMicros() - uploadStart);
+    m_uploadStats.averageUploadMicros += (m_uploadStats.lastUploadMicros - m_uploadStats.averageUploadMicros) / m_uploadStats.uploads;
 
 //    GLenum err = glGetError();
 //    if (err != GL_NO_ERROR){
@@ -273,11 +543,42 @@ bool ofxDirectShowDXTVideoPlayer::isFrameNew() const {
 	return (m_player && m_player->isFrameNew() );
 }
 
+// frames uploaded from the pixel buffer stay reserved until the GPU is done with them
+void ofxDirectShowDXTVideoPlayer::releaseFrame(const DXTFrame * frame) {
+	if (m_pbo.isAllocated()) {
+		m_pbo.retire(frame);
+	}
+	else {
+		m_player->releaseFrame(frame);
+	}
+}
+
+void ofxDirectShowDXTVideoPlayer::updatePixels() const {
+	if (m_pbo.isAllocated() && !m_pbo.isReadable()) {
+		// the frame is in a write only mapping, the pixels stay as they are until the next load maps it readable
+		if (!m_bPixelsUsed) {
+			ofLogWarning("ofxDirectShowDXTVideoPlayer") << "Pixels aren't updated while streaming through a write only pixel buffer, "
+				"call setUsePboUpload(true, true) before loading";
+		}
+		m_bPixelsUsed = true;
+		return;
+	}
+	m_bPixelsUsed = true;
+	if (m_bPixelsDirty && m_frame && m_frame->size >= m_compressedSize) {
+		// decoded on the CPU only when somebody asks for the pixels
+		DXTBlockDecoder::decode(m_textureFormat, m_frame->data, m_width, m_height,
+			m_pix.getData(), m_pix.getWidth() * m_pix.getNumChannels(), m_pix.getNumChannels(), &DXTThreadPool::shared());
+		m_bPixelsDirty = false;
+	}
+}
+
 ofPixels & ofxDirectShowDXTVideoPlayer::getPixels(){
+	updatePixels();
 	return m_pix;
 }
 
 const ofPixels & ofxDirectShowDXTVideoPlayer::getPixels() const {
+	updatePixels();
 	return m_pix;
 }
 
@@ -312,11 +613,11 @@ bool ofxDirectShowDXTVideoPlayer::isPlaying() const  {
 }
 
 bool ofxDirectShowDXTVideoPlayer::setPixelFormat(ofPixelFormat pixelFormat){
-	return (pixelFormat == OF_PIXELS_RGBA);
+	return (pixelFormat == getPixelFormat());
 }
 
 ofPixelFormat ofxDirectShowDXTVideoPlayer::getPixelFormat() const  {
-	return OF_PIXELS_RGBA;
+	return m_textureFormat == TextureFormat_RGBA_DXT5 ? OF_PIXELS_RGBA : OF_PIXELS_RGB;
 }
 
 //should implement!
@@ -366,12 +667,12 @@ void ofxDirectShowDXTVideoPlayer::setVolume(float volume){
 void ofxDirectShowDXTVideoPlayer::setLoopState(ofLoopType state){
 	if(m_player){
 		if( state == OF_LOOP_NONE ){
-			m_player->setLoop(false);
+			m_player->setLoopMode(HapLoopMode_None);
 		}
 		else if( state == OF_LOOP_NORMAL ){
-			m_player->setLoop(true);
+			m_player->setLoopMode(HapLoopMode_Loop);
 		}else{
-			ofLogError("ofDirectShowPlayer") << " cannot set loop of type palindrome " << endl;
+			m_player->setLoopMode(HapLoopMode_Palindrome);
 		}
 	}
 }
@@ -389,6 +690,13 @@ int	ofxDirectShowDXTVideoPlayer::getCurrentFrame() const {
 	return 0;
 }
 
+double ofxDirectShowDXTVideoPlayer::getCurrentFrameTime() const {
+	if(m_player && m_player->isLoaded() ){
+		return m_player->getCurrentFrameTime();
+	}
+	return 0.0;
+}
+
 int	ofxDirectShowDXTVideoPlayer::getTotalFrames() const {
 	if(m_player && m_player->isLoaded() ){
 		return m_player->getTotalFrames();
@@ -398,6 +706,9 @@ int	ofxDirectShowDXTVideoPlayer::getTotalFrames() const {
 
 ofLoopType ofxDirectShowDXTVideoPlayer::getLoopState() const {
 	if(m_player){
+		if(m_player->getLoopMode() == HapLoopMode_Palindrome ){
+			return OF_LOOP_PALINDROME;
+		}
 		if(m_player->isLooping() ){
 			return OF_LOOP_NORMAL;
 		}
@@ -406,6 +717,20 @@ ofLoopType ofxDirectShowDXTVideoPlayer::getLoopState() const {
 	return OF_LOOP_NONE;
 }
 
+void ofxDirectShowDXTVideoPlayer::setLoopPoints(int inFrame, int outFrame){
+	if(m_player){
+		m_player->setLoopRegion(inFrame, outFrame);
+	}
+}
+
+int ofxDirectShowDXTVideoPlayer::getLoopInFrame() const {
+	return m_player ? m_player->getLoopInFrame() : 0;
+}
+
+int ofxDirectShowDXTVideoPlayer::getLoopOutFrame() const {
+	return m_player ? m_player->getLoopOutFrame() : -1;
+}
+
 void ofxDirectShowDXTVideoPlayer::setFrame(int frame){
 	if(m_player && m_player->isLoaded() ){
 		frame = ofClamp(frame, 0, getTotalFrames());
@@ -429,3 +754,152 @@ void ofxDirectShowDXTVideoPlayer::previousFrame(){
 	}
 }
 
+void ofxDirectShowDXTVideoPlayer::setUseSampleLeasing(bool bUseLeasing){
+	m_bUseSampleLeasing = bUseLeasing;
+}
+
+bool ofxDirectShowDXTVideoPlayer::isUsingSampleLeasing() const {
+	return (m_player && m_player->isUsingSampleLeasing() );
+}
+
+void ofxDirectShowDXTVideoPlayer::setFrameScheduling(bool bScheduling){
+	m_bFrameScheduling = bScheduling;
+	if(m_player){
+		m_player->setFrameScheduling(bScheduling);
+	}
+}
+
+bool ofxDirectShowDXTVideoPlayer::isFrameScheduling() const {
+	return m_bFrameScheduling;
+}
+
+void ofxDirectShowDXTVideoPlayer::setDisplayLatency(float seconds){
+	m_displayLatency = MAX(seconds, 0.0f);
+}
+
+DXTPlaybackState ofxDirectShowDXTVideoPlayer::getPlaybackState() const {
+	if(m_player){
+		return m_player->getPlaybackState();
+	}
+	DXTPlaybackState state;
+	memset(&state, 0, sizeof(state));
+	state.rate = 1.0;
+	state.frameIndex = -1;
+	return state;
+}
+
+DXTGraphEventStats ofxDirectShowDXTVideoPlayer::getGraphEventStats() const {
+	if(m_player){
+		return m_player->getGraphEventStats();
+	}
+	DXTGraphEventStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+DXTSchedulerStats ofxDirectShowDXTVideoPlayer::getSchedulerStats() const {
+	if(m_player){
+		return m_player->getSchedulerStats();
+	}
+	DXTSchedulerStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+HapSourceStats ofxDirectShowDXTVideoPlayer::getSourceStats() const {
+	if(m_player){
+		return m_player->getSourceStats();
+	}
+	HapSourceStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+size_t ofxDirectShowDXTVideoPlayer::getMemoryUsage() const {
+	// a closed player's texture and pixels are kept for the next clip, they count until cleared
+	size_t bytes = 0;
+	if (m_player) bytes += (size_t)m_player->getFrameRingSize() * m_player->getFrameSize();
+	if (m_tex.isAllocated()) bytes += m_compressedSize;
+	if (m_pix.isAllocated()) bytes += m_pix.getTotalBytes();
+	return bytes;
+}
+
+DXTUploadStats ofxDirectShowDXTVideoPlayer::getUploadStats() const {
+	return m_uploadStats;
+}
+
+void ofxDirectShowDXTVideoPlayer::setUsePboUpload(bool bUsePbo, bool bReadPixels){
+	m_bUsePboUpload = bUsePbo;
+	if (bReadPixels) m_bPixelsUsed = true;
+}
+
+bool ofxDirectShowDXTVideoPlayer::isUsingPboUpload() const {
+	return m_pbo.isAllocated();
+}
+
+void ofxDirectShowDXTVideoPlayer::setDecodeThreads(int threads, uint64_t affinityMask){
+	DXTThreadPool::shared().start(threads, affinityMask);
+}
+
+int ofxDirectShowDXTVideoPlayer::getDecodeThreads(){
+	return DXTThreadPool::shared().getNumThreads();
+}
+
+DXTThreadPoolStats ofxDirectShowDXTVideoPlayer::getDecodePoolStats(){
+	return DXTThreadPool::shared().getStats();
+}
+
+HapProbeInfo ofxDirectShowDXTVideoPlayer::probe(string path){
+	return HapMediaProbe::probe(ofToDataPath(path), &DXTThreadPool::shared());
+}
+
+vector<HapProbeInfo> ofxDirectShowDXTVideoPlayer::probe(const vector<string> & paths){
+	vector<string> dataPaths;
+	for(size_t i = 0; i < paths.size(); i++){
+		dataPaths.push_back(ofToDataPath(paths[i]));
+	}
+	return HapMediaProbe::probeBatch(dataPaths, &DXTThreadPool::shared());
+}
+
+void ofxDirectShowDXTVideoPlayer::setDecodePriority(DXTTaskPriority priority){
+	m_decodePriority = priority;
+	if(m_player){
+		m_player->setDecodePriority(priority);
+	}
+}
+
+DXTTaskPriority ofxDirectShowDXTVideoPlayer::getDecodePriority() const {
+	return m_decodePriority;
+}
+
+HapDecodeStats ofxDirectShowDXTVideoPlayer::getDecodeStats() const {
+	if(m_player){
+		return m_player->getDecodeStats();
+	}
+	HapDecodeStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+void ofxDirectShowDXTVideoPlayer::setDecodeAhead(int frames, size_t memoryBudget){
+	m_decodeAheadFrames = frames;
+	m_decodeAheadBudget = memoryBudget;
+}
+
+HapPipelineStats ofxDirectShowDXTVideoPlayer::getDecodePipelineStats() const {
+	if(m_player){
+		return m_player->getDecodePipelineStats();
+	}
+	HapPipelineStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+DXTTaskClientStats ofxDirectShowDXTVideoPlayer::getDecodeSchedulingStats() const {
+	if(m_player){
+		return m_player->getDecodeSchedulingStats();
+	}
+	DXTTaskClientStats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
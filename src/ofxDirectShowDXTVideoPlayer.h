@@ -2,8 +2,33 @@
 
 #include "ofMain.h"
 #include "DXTShared.h"
+#include "DXTFrameScheduler.h"
+#include "DXTPboUploader.h"
+#include "HapDecodeEngine.h"
+#include "HapDecodePipeline.h"
+#include "HapMediaProbe.h"
 
 class DirectShowDXTVideo;
+struct DXTFrame;
+struct DXTLoadJob;
+
+enum DXTLoadState {
+	DXTLoadState_Idle = 0,
+	DXTLoadState_Queued,		// waiting for earlier loads on the loader thread
+	DXTLoadState_Opening,		// building and connecting the filter graph
+	DXTLoadState_Prerolling,	// waiting for the first decoded frame
+	DXTLoadState_Ready,			// done off-thread, the next update() allocates the texture
+	DXTLoadState_Loaded,
+	DXTLoadState_Failed,
+	DXTLoadState_Cancelled
+};
+
+struct DXTUploadStats {
+	uint64_t uploads;	// compressed frames sent to a texture
+	uint64_t skips;		// writeToTexture calls where the texture already had the newest frame
+	double lastUploadMicros;	// render thread time spent in the last upload
+	double averageUploadMicros;
+};
 
 class ofxDirectShowDXTVideoPlayer : public ofBaseVideoPlayer {
 
@@ -13,17 +38,24 @@ class ofxDirectShowDXTVideoPlayer : public ofBaseVideoPlayer {
 		~ofxDirectShowDXTVideoPlayer();
 
 		bool load(string path);
+		// builds the graph and decodes the first frame on a loader thread, update() finishes the
+		// load on the GL thread (texture, shader) and then calls onLoaded. Closes the current clip
+		void loadAsync(string path, std::function<void(bool)> onLoaded = nullptr);
+		void cancelLoad();
+		DXTLoadState getLoadState() const;
+		bool isReady() const; // loaded and a frame is in the texture
 		void update();
 		void writeToTexture(ofTexture& texture);
 		void draw(int x, int y, int w, int h);
 		void draw(int x, int y) { draw(x, y, getWidth(), getHeight()); }
 		void close();
+		void clearTexture(); // frees the texture and pixels a closed player keeps for the next clip
 		void play();
 		void pause();
 		void stop();
 
 		bool isFrameNew() const ;
-		ofPixels & getPixels(); // @NOTE: return uncompressed pixels
+		ofPixels & getPixels(); // decoded RGB (DXT1, YCoCg) or RGBA (DXT5) pixels
 		const ofPixels & getPixels() const;
 
 		float getWidth() const;
@@ -47,25 +79,110 @@ class ofxDirectShowDXTVideoPlayer : public ofBaseVideoPlayer {
 		void setPosition(float pct);
 		void setVolume(float volume); // 0..1
 		void setLoopState(ofLoopType state);
-		void setSpeed(float speed);
+		void setSpeed(float speed); // negative plays backward (Hap files), without a seek
 		void setFrame(int frame);  // frame 0 = first frame...
 
 		int getCurrentFrame() const;
 		int getTotalFrames() const;
+		double getCurrentFrameTime() const; // media time in seconds of the frame on screen
+		// all of the above in one consistent copy, without asking the graph
+		DXTPlaybackState getPlaybackState() const;
 		ofLoopType getLoopState() const;
+		// loops and palindromes turn at these frames (inclusive) instead of the clip's ends, sample
+		// accurate and without a seek. outFrame -1 = the last frame
+		void setLoopPoints(int inFrame, int outFrame);
+		int getLoopInFrame() const;
+		int getLoopOutFrame() const;
 
 		void firstFrame();
 		void nextFrame();
 		void previousFrame();
 
+		// upload straight from the decoder's samples instead of copying each frame, takes effect on next load
+		void setUseSampleLeasing(bool bUseLeasing);
+		bool isUsingSampleLeasing() const;
+
+		// buffer a few frames ahead and show the one due at the next vsync instead of the newest one
+		void setFrameScheduling(bool bScheduling);
+		bool isFrameScheduling() const;
+		void setDisplayLatency(float seconds); // time from update() until the frame is on screen, e.g. one refresh interval
+		DXTSchedulerStats getSchedulerStats() const;
+		// frames read and skipped by the Hap source. With frame scheduling on it skips the frames no
+		// refresh would show, compare framesSkipped with getDecodeStats().frames at high speeds
+		HapSourceStats getSourceStats() const;
+
+		// loops, end of stream, errors and rate changes, handled right away on the clip's event thread and
+		// notified here from update(). latencyMicros tells how long e.g. a loop restart took
+		ofEvent<DXTGraphEvent> graphEvent;
+		DXTGraphEventStats getGraphEventStats() const;
+
+		DXTUploadStats getUploadStats() const;
+
+		// bytes held for the clip: texture, pixels and the frames buffered between decoder and texture.
+		// A closed player still holds its texture and pixels until clearTexture()
+		size_t getMemoryUsage() const;
+
+		// stream frames through a persistently mapped pixel buffer (GL 4.4), takes effect on next load.
+		// getPixels() needs the buffer readable: bReadPixels, or pixels asked for during an earlier load
+		void setUsePboUpload(bool bUsePbo, bool bReadPixels = false);
+		bool isUsingPboUpload() const;
+
+		// HAP frames of all players are decompressed on one shared set of worker threads.
+		// threads: -1 = one per extra core, 0 = streaming threads only. affinityMask: cores to pin the workers to, 0 = any
+		static void setDecodeThreads(int threads, uint64_t affinityMask = 0);
+		static int getDecodeThreads();
+		static DXTThreadPoolStats getDecodePoolStats();
+
+		// e.g. high for players on screen, low for players preloading
+		void setDecodePriority(DXTTaskPriority priority);
+		DXTTaskPriority getDecodePriority() const;
+		HapDecodeStats getDecodeStats() const;
+		DXTTaskClientStats getDecodeSchedulingStats() const; // this player's share of the workers
+
+		// size, format, frame rate, frames, duration and audio of a clip from its container, without loading it.
+		// The batch probes on the shared decode threads behind the playing clips, results in the order of paths
+		static HapProbeInfo probe(string path);
+		static vector<HapProbeInfo> probe(const vector<string> & paths);
+
+		// decode up to this many frames ahead on the worker threads, limited to memoryBudget bytes of
+		// samples in flight (0 = only limited by the buffers DirectShow grants), takes effect on next load
+		void setDecodeAhead(int frames, size_t memoryBudget = 0);
+		HapPipelineStats getDecodePipelineStats() const;
+
 	protected:
 
+		DirectShowDXTVideo * createPlayer();
+		bool setupPlayer(DirectShowDXTVideo * player);
+		void updateLoads();
+		void discardLoad(DXTLoadJob & job);
+
+		void updatePixels() const;
+		void releaseFrame(const DXTFrame * frame);
+
 		int	m_height;
 		int	m_width;
 		DirectShowDXTVideo * m_player;
 		ofShader m_shader;
 		bool m_bShaderInitialized;
-		ofPixels m_pix; // copy of compressed pixels
+		bool m_bUseSampleLeasing;
+		bool m_bFrameScheduling;
+		float m_displayLatency;
+		const DXTFrame * m_frame; // frame currently held from the player's frame ring
+		mutable ofPixels m_pix; // decoded pixels, filled on demand
+		mutable bool m_bPixelsDirty;
+		mutable bool m_bPixelsUsed; // getPixels() was called, the pixel buffer is mapped readable
 		ofTexture m_tex; // texture for pix
 		DXTTextureFormat m_textureFormat;
+		GLsizei m_compressedSize; // bytes per frame, fixed once loaded
+		map<GLuint, uint64_t> m_uploadedVersions; // texture id -> sequence of the frame it holds
+		DXTUploadStats m_uploadStats;
+		bool m_bUsePboUpload;
+		DXTPboUploader m_pbo;
+		DXTTaskPriority m_decodePriority;
+		int m_decodeAheadFrames;
+		size_t m_decodeAheadBudget;
+		shared_ptr<DXTLoadJob> m_loadJob; // load in progress
+		vector<shared_ptr<DXTLoadJob> > m_abandonedLoads; // cancelled, their players are deleted once the loader is done with them
+		DXTLoadState m_loadState; // when there's no load in progress
+		std::function<void(bool)> m_onLoaded;
 };
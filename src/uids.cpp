@@ -3,8 +3,11 @@
 #include <Windows.h>
 #include <initguid.h>
 
-DEFINE_GUID(CLSID_HapDecoder,
-	0x7a47fc31, 0x8a4d, 0x48b8, 0x86, 0x74, 0xf0, 0xd2, 0xf2, 0x3b, 0xb0, 0xba);
+DEFINE_GUID(CLSID_DSHapDecoder,
+	0x56e82b1f, 0x244b, 0x4cdf, 0xb4, 0xd1, 0x0b, 0xcd, 0x07, 0x76, 0x68, 0x8e);
+
+DEFINE_GUID(CLSID_DSHapSource,
+	0x385702da, 0xe273, 0x4f92, 0xb2, 0x8b, 0x12, 0x26, 0xa2, 0x82, 0xc0, 0xd3);
 
 DEFINE_GUID(CLSID_LAVSplitterSource,
 	0xB98D13E7, 0x55DB, 0x4385, 0xA3, 0x3D, 0x09, 0xFD, 0x1B, 0xA2, 0x63, 0x38);
@@ -31,3 +34,19 @@ DEFINE_GUID(MEDIASUBTYPE_DXT5,
 // DXTY
 DEFINE_GUID(MEDIASUBTYPE_DXTY,
 	MAKEFOURCC('D', 'X', 'T', 'Y'), 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
+
+//######################################
+// HAP TYPES
+//######################################
+
+// Hap1
+DEFINE_GUID(MEDIASUBTYPE_Hap1,
+	MAKEFOURCC('H', 'a', 'p', '1'), 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
+
+// Hap5
+DEFINE_GUID(MEDIASUBTYPE_Hap5,
+	MAKEFOURCC('H', 'a', 'p', '5'), 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
+
+// HapY
+DEFINE_GUID(MEDIASUBTYPE_HapY,
+	MAKEFOURCC('H', 'a', 'p', 'Y'), 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
@@ -1,9 +1,14 @@
 #pragma once
 
-EXTERN_C const CLSID CLSID_HapDecoder;
+EXTERN_C const CLSID CLSID_DSHapDecoder;
+EXTERN_C const CLSID CLSID_DSHapSource;
 EXTERN_C const CLSID CLSID_LAVSplitterSource;
 EXTERN_C const CLSID CLSID_RawSampleGrabber;
 
 EXTERN_C const CLSID MEDIASUBTYPE_DXT1;
 EXTERN_C const CLSID MEDIASUBTYPE_DXT5;
 EXTERN_C const CLSID MEDIASUBTYPE_DXTY;
+
+EXTERN_C const CLSID MEDIASUBTYPE_Hap1;
+EXTERN_C const CLSID MEDIASUBTYPE_Hap5;
+EXTERN_C const CLSID MEDIASUBTYPE_HapY;
@@ -0,0 +1,55 @@
+// DXTBlockDecoderBench - megapixels per second of the CPU block decoders
+//
+// Decodes 1080p and 4K frames of random blocks in each format with every instruction set the
+// CPU supports, on the calling thread alone and spread over the shared pool.
+
+#include <vector>
+
+#include "DXTBlockDecoder.h"
+#include "DXTThreadPool.h"
+#include "HapTestFrames.h"
+#include "TestUtil.h"
+
+static const char * formatName(DXTTextureFormat format) {
+	switch (format) {
+	case TextureFormat_RGB_DXT1: return "DXT1";
+	case TextureFormat_RGBA_DXT5: return "DXT5";
+	case TextureFormat_YCoCg_DXT5: return "YCoCg";
+	}
+	return "?";
+}
+
+static double measure(DXTTextureFormat format, int width, int height, DXTThreadPool * pool, int numFrames) {
+	HapTestBytes src = makeTestTextureData(DXTCompressedSize(format, width, height), 3);
+	int channels = DXTBlockDecoder::getChannels(format);
+	HapTestBytes dst((size_t)width * height * channels);
+
+	TestClock::time_point start = TestClock::now();
+	for (int i = 0; i < numFrames; i++) {
+		DXTBlockDecoder::decode(format, src.data(), width, height, dst.data(), (size_t)width * channels, channels, pool);
+	}
+	return (double)width * height * numFrames / elapsedMicros(start);
+}
+
+int main(int argc, char ** argv) {
+	int numFrames = isQuick(argc, argv) ? 2 : 50;
+	const DXTTextureFormat formats[] = { TextureFormat_RGB_DXT1, TextureFormat_RGBA_DXT5, TextureFormat_YCoCg_DXT5 };
+	const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	DXTInstructionSet supported = DXTBlockDecoder::getSupportedInstructionSet();
+
+	printf("%d cores, shared pool with %d workers\n", DXTThreadPool::getHardwareThreads(), DXTThreadPool::shared().getNumThreads());
+	printf("%-6s %-10s %-7s %12s %12s\n", "", "", "", "1 thread", "pool");
+	for (int s = 0; s < 2; s++) {
+		for (int f = 0; f < 3; f++) {
+			for (int set = DXTInstructionSet_Scalar; set <= supported; set++) {
+				DXTBlockDecoder::setInstructionSet((DXTInstructionSet)set);
+				double single = measure(formats[f], sizes[s][0], sizes[s][1], NULL, numFrames);
+				double pooled = measure(formats[f], sizes[s][0], sizes[s][1], &DXTThreadPool::shared(), numFrames);
+				printf("%-6s %4dx%-5d %-7s %7.0f MP/s %7.0f MP/s\n", formatName(formats[f]), sizes[s][0], sizes[s][1],
+					DXTBlockDecoder::getInstructionSetName((DXTInstructionSet)set), single, pooled);
+			}
+		}
+	}
+	DXTBlockDecoder::setInstructionSet(supported);
+	return 0;
+}
@@ -0,0 +1,150 @@
+// DXTBlockDecoderTest - SSE2 and AVX2 block decoders give exactly the scalar decoder's pixels
+//
+// Frames of random blocks, with uniform and extreme blocks mixed in, in all three formats and in
+// odd sizes whose edge blocks are cut off. Rows are padded, the padding must stay untouched. The
+// scalar decoder itself is checked against a straightforward decoder written from the format
+// description, for YCoCg against the player shader's float math, off by at most 1.
+
+#include <math.h>
+#include <vector>
+
+#include "DXTBlockDecoder.h"
+#include "DXTThreadPool.h"
+#include "HapTestFrames.h"
+#include "TestUtil.h"
+
+#define PADDING 5
+#define PADDING_BYTE 0xCD
+
+static void expand565(unsigned color, int rgb[3]) {
+	int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static int clampByte(float value) {
+	value *= 255.0f;
+	return value < 0.0f ? 0 : value > 255.0f ? 255 : (int)(value + 0.5f);
+}
+
+// one pixel at a time, as in the format description
+static void referencePixel(DXTTextureFormat format, const unsigned char * block, int pixel, int rgba[4]) {
+	const unsigned char * color = format == TextureFormat_RGB_DXT1 ? block : block + 8;
+	unsigned c0 = color[0] | (color[1] << 8), c1 = color[2] | (color[3] << 8);
+	int palette[4][4];
+	expand565(c0, palette[0]);
+	expand565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int k = 0; k < 3; k++) {
+		if (format != TextureFormat_RGB_DXT1 || c0 > c1) {
+			palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+			palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+		}
+		else {
+			palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+			palette[3][k] = 0;
+		}
+	}
+	int index = (color[4 + pixel / 4] >> (2 * (pixel % 4))) & 3;
+	for (int k = 0; k < 4; k++) rgba[k] = palette[index][k];
+	if (format == TextureFormat_RGB_DXT1) return;
+
+	int alphas[8];
+	alphas[0] = block[0];
+	alphas[1] = block[1];
+	if (alphas[0] > alphas[1]) {
+		for (int i = 1; i < 7; i++) alphas[i + 1] = ((7 - i) * alphas[0] + i * alphas[1]) / 7;
+	}
+	else {
+		for (int i = 1; i < 5; i++) alphas[i + 1] = ((5 - i) * alphas[0] + i * alphas[1]) / 5;
+		alphas[6] = 0;
+		alphas[7] = 255;
+	}
+	int alphaIndex = 0;
+	for (int k = 0; k < 3; k++) {
+		int bit = 3 * pixel + k;
+		alphaIndex |= ((block[2 + bit / 8] >> (bit % 8)) & 1) << k;
+	}
+	rgba[3] = alphas[alphaIndex];
+	if (format != TextureFormat_YCoCg_DXT5) return;
+
+	// the player's fragment shader
+	float scale = rgba[2] / 255.0f * (255.0f / 8.0f) + 1.0f;
+	float co = (rgba[0] / 255.0f - 0.50196078431373f) / scale;
+	float cg = (rgba[1] / 255.0f - 0.50196078431373f) / scale;
+	float y = rgba[3] / 255.0f;
+	rgba[0] = clampByte(y + co - cg);
+	rgba[1] = clampByte(y + cg);
+	rgba[2] = clampByte(y - co - cg);
+	rgba[3] = 255;
+}
+
+static void checkReference(DXTTextureFormat format, const HapTestBytes & src, int width, int height, const HapTestBytes & pixels, size_t stride) {
+	int channels = DXTBlockDecoder::getChannels(format);
+	int blockSize = format == TextureFormat_RGB_DXT1 ? 8 : 16;
+	int tolerance = format == TextureFormat_YCoCg_DXT5 ? 1 : 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const unsigned char * block = src.data() + ((size_t)(y / 4) * ((width + 3) / 4) + x / 4) * blockSize;
+			int rgba[4];
+			referencePixel(format, block, (y % 4) * 4 + x % 4, rgba);
+			for (int k = 0; k < channels; k++) {
+				CHECK(abs(pixels[y * stride + x * channels + k] - rgba[k]) <= tolerance);
+			}
+		}
+	}
+}
+
+static HapTestBytes makeBlocks(DXTTextureFormat format, int width, int height, uint32_t seed) {
+	HapTestBytes src = makeTestTextureData(DXTCompressedSize(format, width, height), seed);
+	int blockSize = format == TextureFormat_RGB_DXT1 ? 8 : 16;
+	const unsigned char fills[] = { 0x00, 0xFF, 0x80 };
+	for (size_t i = 0; i * blockSize < src.size(); i += 7) {
+		memset(&src[i * blockSize], fills[(i / 7) % 3], blockSize);
+	}
+	return src;
+}
+
+static HapTestBytes decode(DXTTextureFormat format, const HapTestBytes & src, int width, int height, size_t stride, DXTThreadPool * pool) {
+	HapTestBytes pixels(stride * height, PADDING_BYTE);
+	DXTBlockDecoder::decode(format, src.data(), width, height, pixels.data(), stride, DXTBlockDecoder::getChannels(format), pool);
+	return pixels;
+}
+
+int main() {
+	const DXTTextureFormat formats[] = { TextureFormat_RGB_DXT1, TextureFormat_RGBA_DXT5, TextureFormat_YCoCg_DXT5 };
+	const int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 4, 4 }, { 13, 7 }, { 65, 33 }, { 1921, 1081 } };
+	DXTInstructionSet supported = DXTBlockDecoder::getSupportedInstructionSet();
+	printf("supported: %s\n", DXTBlockDecoder::getInstructionSetName(supported));
+
+	uint32_t seed = 1;
+	for (int f = 0; f < 3; f++) {
+		for (int s = 0; s < 6; s++) {
+			int width = sizes[s][0], height = sizes[s][1];
+			int channels = DXTBlockDecoder::getChannels(formats[f]);
+			size_t stride = (size_t)width * channels + PADDING;
+			HapTestBytes src = makeBlocks(formats[f], width, height, seed++);
+
+			DXTBlockDecoder::setInstructionSet(DXTInstructionSet_Scalar);
+			HapTestBytes scalar = decode(formats[f], src, width, height, stride, NULL);
+			checkReference(formats[f], src, width, height, scalar, stride);
+			for (int y = 0; y < height; y++) {
+				for (int k = 0; k < PADDING; k++) CHECK(scalar[y * stride + width * channels + k] == PADDING_BYTE);
+			}
+
+			for (int set = DXTInstructionSet_SSE2; set <= supported; set++) {
+				DXTBlockDecoder::setInstructionSet((DXTInstructionSet)set);
+				CHECK(decode(formats[f], src, width, height, stride, NULL) == scalar);
+				CHECK(decode(formats[f], src, width, height, stride, &DXTThreadPool::shared()) == scalar);
+			}
+		}
+	}
+	DXTBlockDecoder::setInstructionSet(supported);
+
+	for (int set = supported + 1; set <= DXTInstructionSet_AVX2; set++) {
+		printf("%s not supported here, not compared\n", DXTBlockDecoder::getInstructionSetName((DXTInstructionSet)set));
+	}
+	printf("ok\n");
+	return 0;
+}
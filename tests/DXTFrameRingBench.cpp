@@ -0,0 +1,156 @@
+// DXTFrameRingBench - copy and lock time per frame, DXTFrameRing against one locked buffer
+//
+// A producer thread writes 4K HAP Q sized frames (8 MB) as fast as it can and a consumer thread
+// takes the newest one, like the streaming and render threads. The locked buffer is how frames
+// were passed before the ring: copied in under a lock, copied out again under the same lock.
+// Every frame the consumer gets is checked for being written completely.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DXTFrameRing.h"
+#include "TestUtil.h"
+
+struct SideTimes {
+	double copyMicros;
+	double lockMicros;
+	long frames;
+};
+
+static void fillFrame(unsigned char * data, long size, uint64_t tag) {
+	memset(data, (int)(tag & 0xff), size);
+}
+
+static bool isWhole(const unsigned char * data, long size) {
+	return data[0] == data[size / 2] && data[0] == data[size - 1];
+}
+
+static void report(const char * name, const SideTimes & producer, const SideTimes & consumer) {
+	printf("%-14s producer: copy %8.1f us lock %8.1f us per frame (%ld frames)\n", name,
+		producer.copyMicros / producer.frames, producer.lockMicros / producer.frames, producer.frames);
+	printf("%-14s consumer: copy %8.1f us lock %8.1f us per frame (%ld frames)\n", "",
+		consumer.frames ? consumer.copyMicros / consumer.frames : 0.0,
+		consumer.frames ? consumer.lockMicros / consumer.frames : 0.0, consumer.frames);
+}
+
+static void runLocked(long frameSize, int numFrames) {
+	std::vector<unsigned char> shared(frameSize), source(frameSize), pixels(frameSize);
+	std::mutex lock;
+	uint64_t sequence = 0;
+	std::atomic<bool> bDone(false);
+	SideTimes producer = { 0.0, 0.0, 0 }, consumer = { 0.0, 0.0, 0 };
+
+	std::thread thread([&]() {
+		for (int i = 1; i <= numFrames; i++) {
+			fillFrame(source.data(), frameSize, i);
+			TestClock::time_point start = TestClock::now();
+			lock.lock();
+			TestClock::time_point locked = TestClock::now();
+			memcpy(shared.data(), source.data(), frameSize);
+			sequence = i;
+			lock.unlock();
+			producer.lockMicros += elapsedMicros(start, locked);
+			producer.copyMicros += elapsedMicros(locked);
+			producer.frames++;
+		}
+		bDone = true;
+	});
+
+	uint64_t lastSequence = 0;
+	for (;;) {
+		bool bDoneBefore = bDone;
+		TestClock::time_point start = TestClock::now();
+		lock.lock();
+		TestClock::time_point locked = TestClock::now();
+		bool bNew = sequence != lastSequence;
+		if (bNew) {
+			memcpy(pixels.data(), shared.data(), frameSize);
+			lastSequence = sequence;
+		}
+		lock.unlock();
+		if (bNew) {
+			consumer.lockMicros += elapsedMicros(start, locked);
+			consumer.copyMicros += elapsedMicros(locked);
+			consumer.frames++;
+			CHECK(isWhole(pixels.data(), frameSize));
+		}
+		else if (bDoneBefore) {
+			break;
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	thread.join();
+	report("locked buffer", producer, consumer);
+}
+
+static void runRing(long frameSize, int numFrames) {
+	std::vector<unsigned char> source(frameSize);
+	DXTFrameRing ring;
+	CHECK(ring.allocate(4, frameSize));
+	std::atomic<bool> bDone(false);
+	SideTimes producer = { 0.0, 0.0, 0 }, consumer = { 0.0, 0.0, 0 };
+
+	std::thread thread([&]() {
+		for (int i = 1; i <= numFrames; i++) {
+			fillFrame(source.data(), frameSize, i);
+			TestClock::time_point start = TestClock::now();
+			DXTFrame * frame = ring.beginWrite();
+			TestClock::time_point claimed = TestClock::now();
+			if (!frame) continue;
+			memcpy(frame->data, source.data(), frameSize);
+			frame->size = frameSize;
+			TestClock::time_point copied = TestClock::now();
+			ring.commitWrite(frame);
+			producer.lockMicros += elapsedMicros(start, claimed) + elapsedMicros(copied);
+			producer.copyMicros += elapsedMicros(claimed, copied);
+			producer.frames++;
+		}
+		bDone = true;
+	});
+
+	uint64_t lastSequence = 0;
+	for (;;) {
+		bool bDoneBefore = bDone;
+		TestClock::time_point start = TestClock::now();
+		const DXTFrame * frame = ring.acquireLatest();
+		TestClock::time_point acquired = TestClock::now();
+		if (frame) {
+			// the consumer uploads straight from the slot, nothing to copy
+			CHECK(frame->sequence > lastSequence);
+			CHECK(isWhole(frame->data, frame->size));
+			lastSequence = frame->sequence;
+			TestClock::time_point checked = TestClock::now();
+			ring.release(frame);
+			consumer.lockMicros += elapsedMicros(start, acquired) + elapsedMicros(checked);
+			consumer.frames++;
+		}
+		else if (bDoneBefore) {
+			break;
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	thread.join();
+
+	DXTFrameRingStats stats = ring.getStats();
+	CHECK(stats.framesWritten == (uint64_t)producer.frames);
+	CHECK(stats.framesRead == (uint64_t)consumer.frames);
+	report("frame ring", producer, consumer);
+	printf("%-14s dropped %llu, rejected %llu\n", "", (unsigned long long)stats.framesDropped,
+		(unsigned long long)stats.framesRejected);
+}
+
+int main(int argc, char ** argv) {
+	// 4K DXT5, one byte per pixel
+	long frameSize = 3840L * 2160L;
+	int numFrames = isQuick(argc, argv) ? 40 : 400;
+
+	runLocked(frameSize, numFrames);
+	runRing(frameSize, numFrames);
+	return 0;
+}
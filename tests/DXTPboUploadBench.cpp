@@ -0,0 +1,210 @@
+// DXTPboUploadBench - render thread time per compressed upload, persistent pixel buffer against client memory
+//
+// Runs headless on whatever EGL offers, e.g. Mesa llvmpipe. A producer thread writes 4K DXT5
+// frames into a DXTFrameRing, the render thread uploads the newest one to a texture. With client
+// memory the ring owns its slots and the driver reads the frame during the upload call. With the
+// pixel buffer the ring's slots live in one persistently mapped GL_PIXEL_UNPACK_BUFFER, the upload
+// is issued from the bound buffer and a slot goes back to the ring once the fence of its upload has
+// signaled, the way DXTPboUploader does it. The last frame of each run is read back and compared.
+// Exits with 77 (skipped) without a GL 4.4 context, buffer storage or S3TC.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "DXTFrameRing.h"
+#include "TestUtil.h"
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#define SKIPPED 77
+
+static const int Width = 3840;
+static const int Height = 2160;
+static const int NumSlots = 4;
+static const long FrameSize = (long)Width * Height;	// DXT5, one byte per pixel
+
+static bool hasExtension(const char * name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++) {
+		if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+	}
+	return false;
+}
+
+static bool createContext() {
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = getPlatformDisplay ?
+		getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API)) return false;
+
+	// no surface, the uploads go to a texture
+	EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 4,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, (EGLConfig)0, EGL_NO_CONTEXT, attribs);
+	return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+// any bytes are valid DXT5 blocks, the tag tells the frames apart
+static void fillFrame(unsigned char * data, uint64_t tag) {
+	for (long i = 0; i < FrameSize; i += 4096) {
+		memset(data + i, (int)((tag + i / 4096) & 0xff), 4096);
+	}
+}
+
+class PixelBuffer {
+
+public:
+
+	PixelBuffer() : m_buffer(0), m_mapped(NULL), m_fences(NumSlots, (GLsync)0) {}
+
+	bool setup() {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)FrameSize * NumSlots, NULL, flags);
+		m_mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)FrameSize * NumSlots, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		for (int i = 0; i < NumSlots; i++) m_slots[i] = m_mapped + (size_t)i * FrameSize;
+		return m_mapped != NULL;
+	}
+
+	void clear(DXTFrameRing & ring) {
+		collect(ring, true);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	unsigned char ** getSlots() { return m_slots; }
+
+	void upload(DXTFrameRing & ring, const DXTFrame * frame) {
+		int slot = (int)((frame->data - m_mapped) / FrameSize);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+			FrameSize, (const void *)(frame->data - m_mapped));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_retired.push_back(frame);
+		collect(ring, false);
+	}
+
+private:
+
+	// frames whose uploads completed go back to the ring
+	void collect(DXTFrameRing & ring, bool bWait) {
+		for (size_t i = 0; i < m_retired.size();) {
+			int slot = (int)((m_retired[i]->data - m_mapped) / FrameSize);
+			GLenum result = glClientWaitSync(m_fences[slot], bWait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, bWait ? GL_TIMEOUT_IGNORED : 0);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+				glDeleteSync(m_fences[slot]);
+				m_fences[slot] = 0;
+				ring.release(m_retired[i]);
+				m_retired.erase(m_retired.begin() + i);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	GLuint m_buffer;
+	unsigned char * m_mapped;
+	unsigned char * m_slots[NumSlots];
+	std::vector<GLsync> m_fences;
+	std::vector<const DXTFrame *> m_retired;
+};
+
+static void run(bool bPbo, int numFrames) {
+	DXTFrameRing ring;
+	PixelBuffer pbo;
+	if (bPbo) {
+		CHECK(pbo.setup());
+		CHECK(ring.allocateExternal(NumSlots, FrameSize, pbo.getSlots()));
+	}
+	else {
+		CHECK(ring.allocate(NumSlots, FrameSize));
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, Width, Height);
+
+	// the producer writes the next frame once the render thread has taken the one before
+	std::atomic<int> taken(0);
+	std::thread producer([&]() {
+		for (int i = 1; i <= numFrames; i++) {
+			DXTFrame * frame;
+			while (!(frame = ring.beginWrite())) std::this_thread::yield();
+			fillFrame(frame->data, i);
+			frame->size = FrameSize;
+			ring.commitWrite(frame);
+			while (taken.load() < i) std::this_thread::yield();
+		}
+	});
+
+	double renderMicros = 0.0;
+	TestClock::time_point start = TestClock::now();
+	for (int i = 1; i <= numFrames; i++) {
+		const DXTFrame * frame;
+		while (!(frame = ring.acquireLatest())) std::this_thread::yield();
+		TestClock::time_point uploadStart = TestClock::now();
+		if (bPbo) {
+			pbo.upload(ring, frame);
+		}
+		else {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width, Height, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, FrameSize, frame->data);
+			ring.release(frame);
+		}
+		renderMicros += elapsedMicros(uploadStart);
+		taken = i;
+	}
+	producer.join();
+	glFinish();
+	double totalMicros = elapsedMicros(start);
+
+	std::vector<unsigned char> expected(FrameSize), uploaded(FrameSize);
+	fillFrame(expected.data(), numFrames);
+	glGetCompressedTexImage(GL_TEXTURE_2D, 0, uploaded.data());
+	CHECK(glGetError() == GL_NO_ERROR);
+	CHECK(memcmp(expected.data(), uploaded.data(), FrameSize) == 0);
+
+	if (bPbo) pbo.clear(ring);
+	glDeleteTextures(1, &texture);
+
+	printf("%-14s render thread %8.1f us per frame, %6.1f frames/s overall\n",
+		bPbo ? "pixel buffer" : "client memory", renderMicros / numFrames, numFrames * 1e6 / totalMicros);
+}
+
+int main(int argc, char ** argv) {
+	if (!createContext()) {
+		printf("no GL 4.4 context, skipped\n");
+		return SKIPPED;
+	}
+	printf("%s, %s\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+	if (!hasExtension("GL_ARB_buffer_storage") || !hasExtension("GL_EXT_texture_compression_s3tc")) {
+		printf("no buffer storage or S3TC, skipped\n");
+		return SKIPPED;
+	}
+
+	int numFrames = isQuick(argc, argv) ? 20 : 300;
+	run(false, numFrames);
+	run(true, numFrames);
+	return 0;
+}
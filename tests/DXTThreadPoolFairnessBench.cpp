@@ -0,0 +1,115 @@
+// DXTThreadPoolFairnessBench - throughput and fairness of many streams decoding on one pool
+//
+// Every stream is a thread that decodes 1080p HAP Q frames through a HapDecodePipeline as fast
+// as it can, half of them with high priority (on screen) and half with low (preloading). They
+// run on the shared pool and then on a pool each, the way every player had its own threads
+// before. Fairness is Jain's index over the frame rates of the streams of one priority, 1 = all
+// got the same. Every frame is compared with its data.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "DXTThreadPool.h"
+#include "HapDecodePipeline.h"
+#include "HapTestFrames.h"
+#include "TestUtil.h"
+
+struct StreamResult {
+	DXTTaskPriority priority;
+	long frames;
+	DXTTaskClientStats scheduling;
+};
+
+static void decodeStream(HapDecodeEngine & engine, const HapTestBytes & frame, const HapTestBytes & data,
+	TestClock::time_point deadline, StreamResult & result) {
+	HapDecodePipeline pipeline(engine);
+	pipeline.setDepth(3);
+	std::vector<HapTestBytes> outputs(4, HapTestBytes(data.size()));
+	int next = 0;
+	result.frames = 0;
+
+	while (TestClock::now() < deadline || !pipeline.isEmpty()) {
+		if (pipeline.isFull() || TestClock::now() >= deadline) {
+			HapPipelineFrame * done = pipeline.waitOldest();
+			CHECK(done->request.result == HapResult_OK);
+			CHECK(*(HapTestBytes *)done->dstOwner == data);
+			pipeline.pop();
+			result.frames++;
+			continue;
+		}
+		HapTestBytes & output = outputs[next++ % outputs.size()];
+		pipeline.push(frame.data(), frame.size(), output.data(), output.size(), NULL, &output);
+	}
+	result.scheduling = engine.getSchedulingStats();
+}
+
+static double jainIndex(const std::vector<StreamResult> & results, DXTTaskPriority priority) {
+	double sum = 0.0, squares = 0.0;
+	int count = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		if (results[i].priority != priority) continue;
+		sum += results[i].frames;
+		squares += (double)results[i].frames * results[i].frames;
+		count++;
+	}
+	return squares > 0.0 ? sum * sum / (count * squares) : 0.0;
+}
+
+static void run(const char * name, bool bShared, int numStreams, double seconds, const HapTestBytes & frame, const HapTestBytes & data) {
+	std::vector<DXTThreadPool *> pools;
+	std::vector<HapDecodeEngine *> engines;
+	for (int i = 0; i < numStreams; i++) {
+		if (bShared) {
+			engines.push_back(new HapDecodeEngine(DXTThreadPool::shared()));
+		}
+		else {
+			pools.push_back(new DXTThreadPool());
+			pools.back()->start(-1);
+			engines.push_back(new HapDecodeEngine(*pools.back()));
+		}
+		engines.back()->setPriority(i % 2 ? DXTTaskPriority_Low : DXTTaskPriority_High);
+	}
+
+	std::vector<StreamResult> results(numStreams);
+	std::vector<std::thread> threads;
+	TestClock::time_point start = TestClock::now();
+	TestClock::time_point deadline = start + std::chrono::microseconds((int64_t)(seconds * 1e6));
+	for (int i = 0; i < numStreams; i++) {
+		results[i].priority = engines[i]->getPriority();
+		threads.push_back(std::thread(decodeStream, std::ref(*engines[i]), std::cref(frame), std::cref(data), deadline, std::ref(results[i])));
+	}
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	double elapsed = elapsedMicros(start) / 1e6;
+
+	long total = 0;
+	for (int i = 0; i < numStreams; i++) {
+		CHECK(results[i].frames > 0);
+		total += results[i].frames;
+	}
+	printf("%s: %d streams, %.1f frames/s, fairness high %.3f low %.3f\n", name, numStreams, total / elapsed,
+		jainIndex(results, DXTTaskPriority_High), jainIndex(results, DXTTaskPriority_Low));
+	for (int i = 0; i < numStreams; i++) {
+		printf("  stream %2d %-4s %6.1f frames/s, tasks ran %8.0f ms, waited %7.0f us on average\n", i,
+			results[i].priority == DXTTaskPriority_High ? "high" : "low", results[i].frames / elapsed,
+			results[i].scheduling.runMicros / 1000.0, results[i].scheduling.averageQueueMicros);
+	}
+
+	for (size_t i = 0; i < engines.size(); i++) delete engines[i];
+	for (size_t i = 0; i < pools.size(); i++) delete pools[i];
+}
+
+int main(int argc, char ** argv) {
+	bool bQuick = isQuick(argc, argv);
+	int numStreams = bQuick ? 4 : 16;
+	double seconds = bQuick ? 0.3 : 3.0;
+
+	// 1080p YCoCg DXT5 in 16 chunks
+	HapTestBytes data = makeTestTextureData(1920 * 1080, 2);
+	HapTestBytes frame = makeTestHapFrame(data, HapTestFormat_YCoCg, 16);
+
+	printf("%d cores, shared pool with %d workers\n", DXTThreadPool::getHardwareThreads(), DXTThreadPool::shared().getNumThreads());
+	run("shared pool", true, numStreams, seconds, frame, data);
+	run("pool each", false, numStreams, seconds, frame, data);
+	return 0;
+}
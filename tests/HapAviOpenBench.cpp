@@ -0,0 +1,81 @@
+// HapAviOpenBench - open to first frame of OpenDML AVI files from 1 to 50 GB
+//
+// Writes sparse Hap1 AVIs of about 1 MB frames with PCM audio in between, RIFF AVIX lists of
+// 1 GB and an ix## standard index in each, then times opening the file, building the frame index
+// from the indx super index and reading the first frame. Cold is right after the file's pages
+// were dropped from the cache, warm is the same again. Both should stay flat as files grow,
+// only the index grows with them. The index is compared with what was written.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "HapDemuxer.h"
+#include "HapTestClips.h"
+#include "TestUtil.h"
+
+static void dropFromCache(const std::string & path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	CHECK(fd >= 0);
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+static double openToFirstFrame(const std::string & path, const HapTestClip & clip) {
+	TestClock::time_point start = TestClock::now();
+	HapMediaFile file;
+	CHECK(file.open(path));
+	HapFrameIndex index;
+	CHECK(HapDemuxer::buildIndex(file, index) == HapDemuxResult_OK);
+	std::vector<unsigned char> frame(index.getMaxFrameSize());
+	CHECK(index.readFrame(file, 0, frame.data(), frame.size()));
+	double micros = elapsedMicros(start);
+
+	CHECK(frame[0] == 0 && frame[1] == 0);
+	CHECK(index.getFrameCount() == (int)clip.frames.size());
+	CHECK(index.duration == clip.duration);
+	for (int i = 0; i < index.getFrameCount(); i++) {
+		CHECK(index.getFrame(i).offset == clip.frames[i].offset);
+		CHECK(index.getFrame(i).size == clip.frames[i].size);
+		CHECK(index.getFrame(i).time == clip.frames[i].time);
+	}
+	CHECK(index.audio.chunks.size() == clip.audioChunks.size());
+	for (size_t i = 0; i < clip.audioChunks.size(); i++) {
+		CHECK(index.audio.chunks[i].offset == clip.audioChunks[i].offset);
+		CHECK(index.audio.chunks[i].size == clip.audioChunks[i].size);
+	}
+	int last = index.getFrameCount() - 1;
+	CHECK(index.readFrame(file, last, frame.data(), frame.size()));
+	CHECK(frame[0] == (unsigned char)last && frame[1] == (unsigned char)(last >> 8));
+	return micros;
+}
+
+int main(int argc, char ** argv) {
+	std::vector<int> sizes;
+	sizes.push_back(1);
+	if (!isQuick(argc, argv)) sizes.push_back(10);
+	sizes.push_back(50);
+
+	for (size_t i = 0; i < sizes.size(); i++) {
+		char path[64];
+		snprintf(path, sizeof(path), "opendml-%dgb.avi", sizes[i]);
+		HapTestAviOptions options;
+		options.numFrames = sizes[i] * 1024;
+		options.frameSize = 1 << 20;
+		options.bOpenDML = true;
+		options.bAudio = true;
+		HapTestClip clip;
+		TestClock::time_point start = TestClock::now();
+		CHECK(writeTestAvi(path, options, clip));
+		double writeMicros = elapsedMicros(start);
+
+		dropFromCache(path);
+		double cold = openToFirstFrame(path, clip);
+		double warm = openToFirstFrame(path, clip);
+		printf("%2d GB, %6d frames: open to first frame %8.0f us cold, %8.0f us warm (written in %.1f s)\n",
+			sizes[i], options.numFrames, cold, warm, writeMicros / 1e6);
+		remove(path);
+	}
+	return 0;
+}
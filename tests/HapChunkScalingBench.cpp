@@ -0,0 +1,51 @@
+// HapChunkScalingBench - decode time of chunked 4K HAP Q frames on 1 to N cores
+//
+// HapDecodeEngine fans a frame's chunks out over a pool's workers, the decoding thread helps.
+// Each run uses a pool of its own with one worker more than the one before, from 0 (the decoding
+// thread alone) to one per core besides it, or --threads N. Every frame is compared with its data.
+
+#include "DXTThreadPool.h"
+#include "HapDecodeEngine.h"
+#include "HapTestFrames.h"
+#include "TestUtil.h"
+
+int main(int argc, char ** argv) {
+	bool bQuick = isQuick(argc, argv);
+	int maxWorkers = DXTThreadPool::getHardwareThreads() - 1;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0) maxWorkers = atoi(argv[i + 1]);
+	}
+	if (maxWorkers < 1) maxWorkers = 1;
+
+	// 4K YCoCg DXT5 in 64 chunks
+	const size_t size = 3840 * 2160;
+	const int numChunks = 64;
+	const int numFrames = bQuick ? 5 : 100;
+	HapTestBytes data = makeTestTextureData(size, 1);
+	HapTestBytes frame = makeTestHapFrame(data, HapTestFormat_YCoCg, numChunks);
+	HapTestBytes out(size);
+	printf("%d chunks, %.1f MB compressed to %.1f MB\n", numChunks, size / 1e6, frame.size() / 1e6);
+
+	double serialMicros = 0.0;
+	for (int workers = 0; workers <= maxWorkers; workers++) {
+		DXTThreadPool pool;
+		pool.start(workers);
+		HapDecodeEngine engine(pool);
+
+		for (int i = 0; i < numFrames; i++) {
+			HapFrameInfo info;
+			memset(out.data(), 0, size);
+			CHECK(engine.decode(frame.data(), frame.size(), out.data(), out.size(), info) == HapResult_OK);
+			CHECK(info.chunks.size() == (size_t)numChunks);
+			CHECK(out == data);
+		}
+
+		HapDecodeStats stats = engine.getStats();
+		CHECK(stats.frames == (uint64_t)numFrames && stats.failures == 0);
+		if (workers == 0) serialMicros = stats.averageDecodeMicros;
+		printf("%2d cores: %8.0f us per frame (max %8.0f), %7.1f MB/s, %.2fx\n", workers + 1,
+			stats.averageDecodeMicros, stats.maxDecodeMicros, size / stats.averageDecodeMicros,
+			serialMicros / stats.averageDecodeMicros);
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+// HapLoopTest - no display refresh misses its frame at the loop point, over 10,000 loops
+//
+// Plays clips the way DSHapSource and the player do, without DirectShow: the playhead and the
+// frame stepper time the frames, a producer publishes them into a DXTFrameRing a little ahead
+// of the display, and a 60 Hz render loop picks them with the DXTFrameScheduler. At every
+// refresh the frame on screen must be the one whose interval covers the refresh, also right
+// after the playhead wrapped, and no delivered frame may be dropped unseen.
+
+#include <stdio.h>
+
+#include "DXTFrameRing.h"
+#include "DXTFrameScheduler.h"
+#include "HapFrameIndex.h"
+#include "HapFrameStepper.h"
+#include "TestUtil.h"
+
+#define REFRESH_INTERVAL 166667		// 60 Hz in 100 ns units
+#define LOOPS 10000
+
+struct LoopCase {
+	const char * name;
+	int numFrames;
+	int rateNumerator;		// frames per second as a fraction
+	int rateDenominator;
+	HapLoopMode mode;
+	int inFrame;
+	int outFrame;
+	double speed;
+};
+
+static void checkLoop(const LoopCase & loop) {
+	HapFrameIndex index;
+	index.codec = HAP_CODEC_HAP1;
+	for (int i = 0; i < loop.numFrames; i++) {
+		HapIndexEntry entry = { 0, 0, (int64_t)i * loop.rateDenominator * 10000000 / loop.rateNumerator };
+		index.frames.push_back(entry);
+	}
+	index.duration = (int64_t)loop.numFrames * loop.rateDenominator * 10000000 / loop.rateNumerator;
+	index.frameDuration = index.duration / loop.numFrames;
+
+	HapPlayhead playhead;
+	playhead.setFrameCount(loop.numFrames);
+	playhead.setLoop(loop.mode, loop.inFrame, loop.outFrame);
+	HapFrameStepper stepper;
+	stepper.setRate(loop.speed);
+	stepper.setRefreshInterval(REFRESH_INTERVAL);
+	stepper.restart(0);
+
+	DXTFrameRing ring;
+	CHECK(ring.allocate(8, 16));
+	DXTFrameScheduler scheduler;
+
+	HapFrameStep step;
+	CHECK(stepper.next(playhead, index, step));
+	long loops = 0;
+	uint64_t refreshes = 0, missed = 0, missedAtLoop = 0;
+	const DXTFrame * onScreen = NULL;
+	int64_t lastWrap = -1;		// start of the first frame after the latest wrap
+
+	while (loops < LOOPS) {
+		int64_t displayTime = (int64_t)refreshes * REFRESH_INTERVAL;
+
+		// the producer stays two refreshes ahead, like the source and decoder working ahead
+		while (step.start <= displayTime + 2 * REFRESH_INTERVAL) {
+			DXTFrame * frame = ring.beginWrite();
+			CHECK(frame != NULL);
+			frame->size = 0;
+			frame->startTime = step.start;
+			frame->stopTime = step.stop;
+			frame->frameIndex = step.frame;
+			ring.commitWrite(frame);
+			CHECK(stepper.next(playhead, index, step));
+			if (step.bWrapped) {
+				loops++;
+				lastWrap = step.start;
+			}
+		}
+
+		const DXTFrame * frame = scheduler.selectFrame(ring, displayTime);
+		if (frame) {
+			if (onScreen) ring.release(onScreen);
+			onScreen = frame;
+		}
+		if (!onScreen || onScreen->startTime > displayTime || onScreen->stopTime <= displayTime) {
+			missed++;
+			if (lastWrap >= 0 && displayTime - lastWrap < 2 * REFRESH_INTERVAL) missedAtLoop++;
+		}
+		refreshes++;
+	}
+
+	DXTSchedulerStats stats = scheduler.getStats();
+	DXTFrameRingStats ringStats = ring.getStats();
+	printf("%-12s %6d loops, %8llu refreshes, %llu missed (%llu at the loop point), %llu frames shown, cadence %.3f, judder %.3f\n",
+		loop.name, (int)loops, (unsigned long long)refreshes, (unsigned long long)missed, (unsigned long long)missedAtLoop,
+		(unsigned long long)stats.framesShown, stats.averageCadence, stats.judder);
+	CHECK(missed == 0);
+	CHECK(stats.refreshesWithoutFrame == 0);
+	CHECK(stats.timelineResets == 0);
+	CHECK(ringStats.framesDropped == 0);
+	CHECK(ringStats.framesRejected == 0);
+	if (onScreen) ring.release(onScreen);
+}
+
+int main() {
+	const LoopCase cases[] = {
+		{ "ntsc",        37, 30000, 1001, HapLoopMode_Loop,       0, -1, 1.0 },
+		{ "film",        25,    24,    1, HapLoopMode_Loop,       0, -1, 1.0 },
+		{ "region",      50,    25,    1, HapLoopMode_Loop,       7, 31, 1.0 },
+		{ "palindrome",  20, 30000, 1001, HapLoopMode_Palindrome, 0, -1, 1.0 },
+		{ "fast",        41,    60,    1, HapLoopMode_Loop,       0, -1, 2.5 },
+		{ "slow",        11, 30000, 1001, HapLoopMode_Loop,       0, -1, 0.4 },
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		checkLoop(cases[i]);
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,123 @@
+// HapMovDemuxerTest - frame indexes of generated QuickTime clips
+//
+// 32 and 64 bit chunk offsets, uneven samples per chunk, varying frame durations, moov before
+// and after mdat, the PCM audio descriptions (version 1, version 2 lpcm, enda) and a clip of
+// more than 5 GB whose frames all lie beyond 4 GB. Every frame is read back through the index.
+
+#include <stdio.h>
+
+#include "HapDemuxer.h"
+#include "HapTestClips.h"
+#include "TestUtil.h"
+
+struct ExpectedAudio {
+	int channels;
+	int sampleRate;
+	int bitsPerSample;
+	bool bFloat;
+	bool bBigEndian;
+};
+
+static void checkClip(const char * name, const HapTestMovOptions & options, const ExpectedAudio * audio) {
+	std::string path = std::string(name) + ".mov";
+	HapTestClip clip;
+	CHECK(writeTestMov(path, options, clip));
+
+	HapMediaFile file;
+	CHECK(file.open(path));
+	HapFrameIndex index;
+	TestClock::time_point start = TestClock::now();
+	HapDemuxResult result = HapDemuxer::buildIndex(file, index);
+	double micros = elapsedMicros(start);
+	CHECK(result == HapDemuxResult_OK);
+
+	CHECK(index.codec == clip.codec);
+	CHECK(index.width == clip.width && index.height == clip.height);
+	CHECK(index.duration == clip.duration);
+	CHECK(index.getFrameCount() == (int)clip.frames.size());
+
+	std::vector<unsigned char> frame(index.getMaxFrameSize());
+	for (int i = 0; i < index.getFrameCount(); i++) {
+		const HapIndexEntry & entry = index.getFrame(i);
+		CHECK(entry.offset == clip.frames[i].offset);
+		CHECK(entry.size == clip.frames[i].size);
+		CHECK(entry.time == clip.frames[i].time);
+		CHECK(index.findFrame(entry.time) == i);
+		CHECK(index.readFrame(file, i, frame.data(), frame.size()));
+		CHECK(frame[0] == (unsigned char)i && frame[1] == (unsigned char)(i >> 8));
+	}
+
+	CHECK(index.audio.bPresent == (audio != NULL));
+	if (audio) {
+		CHECK(index.audio.bPCM);
+		CHECK(index.audio.channels == audio->channels);
+		CHECK(index.audio.sampleRate == audio->sampleRate);
+		CHECK(index.audio.bitsPerSample == audio->bitsPerSample);
+		CHECK(index.audio.bFloat == audio->bFloat);
+		CHECK(index.audio.bBigEndian == audio->bBigEndian);
+		CHECK(index.audio.chunks.size() == clip.audioChunks.size());
+		for (size_t i = 0; i < clip.audioChunks.size(); i++) {
+			CHECK(index.audio.chunks[i].offset == clip.audioChunks[i].offset);
+			CHECK(index.audio.chunks[i].size == clip.audioChunks[i].size);
+		}
+	}
+
+	printf("%-10s %4d frames, %6.2f GB, last frame at %llu, index built in %.0f us\n", name, index.getFrameCount(),
+		file.getSize() / 1e9, (unsigned long long)index.getFrame(index.getFrameCount() - 1).offset, micros);
+	file.close();
+	remove(path.c_str());
+}
+
+int main() {
+	HapTestMovOptions plain;
+	checkClip("plain", plain, NULL);
+
+	HapTestMovOptions moovFirst;
+	moovFirst.bMoovFirst = true;
+	moovFirst.samplesPerChunk.assign(1, 1);
+	checkClip("faststart", moovFirst, NULL);
+
+	// NTSC rate, 64 bit tables, little endian 16 bit audio
+	HapTestMovOptions ntsc;
+	ntsc.numFrames = 301;
+	ntsc.timescale = 30000;
+	ntsc.frameDuration = 1001;
+	ntsc.bVaryingDuration = true;
+	ntsc.bCo64 = true;
+	ntsc.bMdhdVersion1 = true;
+	ntsc.audioFormat = HAP_FOURCC('s', 'o', 'w', 't');
+	ExpectedAudio sowt = { 2, 48000, 16, false, false };
+	checkClip("ntsc", ntsc, &sowt);
+
+	HapTestMovOptions lpcm;
+	lpcm.numFrames = 20;
+	lpcm.samplesPerChunk.assign(1, 1);
+	lpcm.audioFormat = HAP_FOURCC('l', 'p', 'c', 'm');
+	lpcm.audioChannels = 6;
+	lpcm.audioBits = 24;
+	lpcm.audioRate = 44100;
+	ExpectedAudio lpcmAudio = { 6, 44100, 24, false, false };
+	checkClip("lpcm", lpcm, &lpcmAudio);
+
+	HapTestMovOptions in24;
+	in24.numFrames = 10;
+	in24.audioFormat = HAP_FOURCC('i', 'n', '2', '4');
+	in24.audioBits = 24;
+	in24.audioEnda = 1;
+	ExpectedAudio in24Audio = { 2, 48000, 24, false, false };
+	checkClip("in24", in24, &in24Audio);
+
+	// past 4 GB, a hole in a sparse file
+	HapTestMovOptions large;
+	large.numFrames = 40;
+	large.bCo64 = true;
+	large.gap = 5ULL << 30;
+	large.audioFormat = HAP_FOURCC('t', 'w', 'o', 's');
+	large.audioChannels = 1;
+	large.audioRate = 22050;
+	ExpectedAudio twos = { 1, 22050, 16, false, true };
+	checkClip("large", large, &twos);
+
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,678 @@
+#include "HapTestClips.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// sample frames per audio chunk, one chunk after each video chunk
+#define AUDIO_CHUNK_FRAMES 100
+
+static uint32_t nextRandom(uint32_t & state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static std::vector<std::vector<unsigned char> > makeFrames(int numFrames, uint32_t seed) {
+	std::vector<std::vector<unsigned char> > frames(numFrames);
+	uint32_t state = seed;
+	for (int i = 0; i < numFrames; i++) {
+		frames[i].resize(16 + nextRandom(state) % 3985);
+		for (size_t k = 0; k < frames[i].size(); k++) frames[i][k] = (unsigned char)nextRandom(state);
+		for (int k = 0; k < 4; k++) frames[i][k] = (unsigned char)(i >> (8 * k));
+	}
+	return frames;
+}
+
+// data at an offset of the file, anything in between stays a hole
+struct Placed {
+	uint64_t offset;
+	std::vector<unsigned char> data;
+};
+
+static bool writeFile(const std::string & path, const std::vector<Placed> & placed) {
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	bool bOK = true;
+	for (size_t i = 0; i < placed.size() && bOK; i++) {
+		bOK = fseeko(file, (off_t)placed[i].offset, SEEK_SET) == 0 &&
+			fwrite(placed[i].data.data(), 1, placed[i].data.size(), file) == placed[i].data.size();
+	}
+	return fclose(file) == 0 && bOK;
+}
+
+//////////////////////////////// MOV ////////////////////////////////
+
+typedef std::vector<unsigned char> Bytes;
+
+static void be16(Bytes & out, uint32_t value) {
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void be32(Bytes & out, uint32_t value) {
+	be16(out, value >> 16);
+	be16(out, value & 0xffff);
+}
+
+static void be64(Bytes & out, uint64_t value) {
+	be32(out, (uint32_t)(value >> 32));
+	be32(out, (uint32_t)value);
+}
+
+static void fourcc(Bytes & out, uint32_t code) {
+	for (int i = 0; i < 4; i++) out.push_back((unsigned char)(code >> (8 * i)));
+}
+
+static void zeros(Bytes & out, size_t count) {
+	out.insert(out.end(), count, 0);
+}
+
+static Bytes atom(const char * type, const Bytes & payload) {
+	Bytes out;
+	be32(out, (uint32_t)(8 + payload.size()));
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), payload.begin(), payload.end());
+	return out;
+}
+
+static Bytes fullAtom(const char * type, int version, const Bytes & payload) {
+	Bytes body;
+	be32(body, (uint32_t)version << 24);
+	body.insert(body.end(), payload.begin(), payload.end());
+	return atom(type, body);
+}
+
+static Bytes concat(const Bytes & a, const Bytes & b) {
+	Bytes out = a;
+	out.insert(out.end(), b.begin(), b.end());
+	return out;
+}
+
+static Bytes chunkOffsets(bool bCo64, const std::vector<uint64_t> & offsets) {
+	Bytes payload;
+	be32(payload, (uint32_t)offsets.size());
+	for (size_t i = 0; i < offsets.size(); i++) {
+		if (bCo64) be64(payload, offsets[i]);
+		else be32(payload, (uint32_t)offsets[i]);
+	}
+	return fullAtom(bCo64 ? "co64" : "stco", 0, payload);
+}
+
+static Bytes mediaHeader(int version, uint32_t timescale, uint64_t duration) {
+	Bytes payload;
+	if (version == 1) {
+		be64(payload, 0);
+		be64(payload, 0);
+		be32(payload, timescale);
+		be64(payload, duration);
+	}
+	else {
+		be32(payload, 0);
+		be32(payload, 0);
+		be32(payload, timescale);
+		be32(payload, (uint32_t)duration);
+	}
+	zeros(payload, 4);
+	return fullAtom("mdhd", version, payload);
+}
+
+static Bytes handler(const char * type) {
+	Bytes payload;
+	payload.insert(payload.end(), { 'm', 'h', 'l', 'r' });
+	payload.insert(payload.end(), type, type + 4);
+	zeros(payload, 13);
+	return fullAtom("hdlr", 0, payload);
+}
+
+static Bytes audioDescription(const HapTestMovOptions & options) {
+	int bytesPerFrame = options.audioChannels * options.audioBits / 8;
+	Bytes entry;
+	fourcc(entry, options.audioFormat);
+	zeros(entry, 6);
+	be16(entry, 1);
+	if (options.audioFormat == HAP_FOURCC('l', 'p', 'c', 'm')) {
+		// version 2
+		be16(entry, 2);
+		be16(entry, 0);
+		zeros(entry, 4);
+		be16(entry, 3);
+		be16(entry, 16);
+		be16(entry, 0xfffe);
+		be16(entry, 0);
+		be32(entry, 65536);
+		be32(entry, 72);
+		double rate = options.audioRate;
+		uint64_t rateBits;
+		memcpy(&rateBits, &rate, 8);
+		be64(entry, rateBits);
+		be32(entry, options.audioChannels);
+		be32(entry, 0x7f000000);
+		be32(entry, options.audioBits);
+		be32(entry, options.audioFlags);
+		be32(entry, bytesPerFrame);
+		be32(entry, 1);
+	}
+	else {
+		// version 1
+		be16(entry, 1);
+		be16(entry, 0);
+		zeros(entry, 4);
+		be16(entry, options.audioChannels);
+		be16(entry, options.audioBits);
+		be16(entry, 0xfffe);
+		be16(entry, 0);
+		be32(entry, (uint32_t)options.audioRate << 16);
+		be32(entry, 1);
+		be32(entry, options.audioBits / 8);
+		be32(entry, bytesPerFrame);
+		be32(entry, options.audioBits / 8);
+		if (options.audioEnda >= 0) {
+			Bytes enda;
+			be16(enda, options.audioEnda);
+			entry = concat(entry, atom("wave", atom("enda", enda)));
+		}
+	}
+	Bytes description;
+	be32(description, (uint32_t)(4 + entry.size()));
+	return concat(description, entry);
+}
+
+static Bytes buildMoov(const HapTestMovOptions & options, const std::vector<std::vector<unsigned char> > & frames,
+	const std::vector<int> & chunkSamples, const std::vector<uint64_t> & videoChunks, const std::vector<uint64_t> & audioChunks,
+	const std::vector<int> & durations) {
+
+	// stts, runs of equal durations
+	Bytes stts;
+	std::vector<std::pair<uint32_t, uint32_t> > runs;
+	for (size_t i = 0; i < durations.size(); i++) {
+		if (!runs.empty() && runs.back().second == (uint32_t)durations[i]) runs.back().first++;
+		else runs.push_back(std::make_pair(1u, (uint32_t)durations[i]));
+	}
+	be32(stts, (uint32_t)runs.size());
+	for (size_t i = 0; i < runs.size(); i++) {
+		be32(stts, runs[i].first);
+		be32(stts, runs[i].second);
+	}
+
+	// stsc, a new entry where the samples per chunk change
+	Bytes stsc;
+	std::vector<uint32_t> stscEntries;
+	for (size_t i = 0; i < chunkSamples.size(); i++) {
+		if (i == 0 || chunkSamples[i] != chunkSamples[i - 1]) {
+			stscEntries.push_back((uint32_t)i + 1);
+			stscEntries.push_back(chunkSamples[i]);
+			stscEntries.push_back(1);
+		}
+	}
+	be32(stsc, (uint32_t)stscEntries.size() / 3);
+	for (size_t i = 0; i < stscEntries.size(); i++) be32(stsc, stscEntries[i]);
+
+	Bytes stsz;
+	be32(stsz, 0);
+	be32(stsz, (uint32_t)frames.size());
+	for (size_t i = 0; i < frames.size(); i++) be32(stsz, (uint32_t)frames[i].size());
+
+	Bytes videoEntry;
+	be32(videoEntry, 86);
+	videoEntry.insert(videoEntry.end(), { 'H', 'a', 'p', '5' });
+	zeros(videoEntry, 6);
+	be16(videoEntry, 1);
+	be32(videoEntry, 0);
+	videoEntry.insert(videoEntry.end(), { 'a', 'p', 'p', 'l' });
+	be32(videoEntry, 0);
+	be32(videoEntry, 512);
+	be16(videoEntry, 1920);
+	be16(videoEntry, 1080);
+	zeros(videoEntry, 86 - videoEntry.size());
+	Bytes stsd;
+	be32(stsd, 1);
+	stsd = concat(stsd, videoEntry);
+
+	uint64_t duration = 0;
+	for (size_t i = 0; i < durations.size(); i++) duration += durations[i];
+
+	Bytes stbl = fullAtom("stsd", 0, stsd);
+	stbl = concat(stbl, fullAtom("stts", 0, stts));
+	stbl = concat(stbl, fullAtom("stsc", 0, stsc));
+	stbl = concat(stbl, fullAtom("stsz", 0, stsz));
+	stbl = concat(stbl, chunkOffsets(options.bCo64, videoChunks));
+	Bytes vmhd;
+	zeros(vmhd, 12);
+	Bytes minf = concat(atom("vmhd", vmhd), atom("stbl", stbl));
+	Bytes mdia = concat(mediaHeader(options.bMdhdVersion1 ? 1 : 0, options.timescale, duration), handler("vide"));
+	mdia = concat(mdia, atom("minf", minf));
+	Bytes tkhd;
+	zeros(tkhd, 84);
+	Bytes tracks = atom("trak", concat(atom("tkhd", tkhd), atom("mdia", mdia)));
+
+	if (options.audioFormat) {
+		uint32_t total = (uint32_t)audioChunks.size() * AUDIO_CHUNK_FRAMES;
+		Bytes audioStsd, audioStts, audioStsc, audioStsz;
+		be32(audioStsd, 1);
+		audioStsd = concat(audioStsd, audioDescription(options));
+		be32(audioStts, 1);
+		be32(audioStts, total);
+		be32(audioStts, 1);
+		be32(audioStsc, 1);
+		be32(audioStsc, 1);
+		be32(audioStsc, AUDIO_CHUNK_FRAMES);
+		be32(audioStsc, 1);
+		be32(audioStsz, 1);
+		be32(audioStsz, total);
+		Bytes audioStbl = fullAtom("stsd", 0, audioStsd);
+		audioStbl = concat(audioStbl, fullAtom("stts", 0, audioStts));
+		audioStbl = concat(audioStbl, fullAtom("stsc", 0, audioStsc));
+		audioStbl = concat(audioStbl, fullAtom("stsz", 0, audioStsz));
+		audioStbl = concat(audioStbl, chunkOffsets(options.bCo64, audioChunks));
+		Bytes audioMdia = concat(mediaHeader(0, options.audioRate, total), handler("soun"));
+		audioMdia = concat(audioMdia, atom("minf", atom("stbl", audioStbl)));
+		tracks = concat(tracks, atom("trak", atom("mdia", audioMdia)));
+	}
+
+	Bytes mvhd;
+	zeros(mvhd, 96);
+	return atom("moov", concat(fullAtom("mvhd", 0, mvhd), tracks));
+}
+
+HapTestMovOptions::HapTestMovOptions() {
+	numFrames = 50;
+	timescale = 600;
+	frameDuration = 20;
+	bVaryingDuration = false;
+	samplesPerChunk.push_back(3);
+	samplesPerChunk.push_back(5);
+	samplesPerChunk.push_back(1);
+	bCo64 = false;
+	bMdhdVersion1 = false;
+	bMoovFirst = false;
+	gap = 0;
+	audioFormat = 0;
+	audioChannels = 2;
+	audioBits = 16;
+	audioRate = 48000;
+	audioFlags = 0;
+	audioEnda = -1;
+}
+
+bool writeTestMov(const std::string & path, const HapTestMovOptions & options, HapTestClip & clip) {
+	std::vector<std::vector<unsigned char> > frames = makeFrames(options.numFrames, (uint32_t)options.numFrames);
+	std::vector<int> durations(options.numFrames);
+	for (int i = 0; i < options.numFrames; i++) {
+		durations[i] = options.bVaryingDuration && i % 2 ? 2 * options.frameDuration : options.frameDuration;
+	}
+	std::vector<int> chunkSamples;
+	for (int first = 0, i = 0; first < options.numFrames; i++) {
+		int count = options.samplesPerChunk[i % options.samplesPerChunk.size()];
+		if (count > options.numFrames - first) count = options.numFrames - first;
+		chunkSamples.push_back(count);
+		first += count;
+	}
+	long audioChunkSize = options.audioFormat ? AUDIO_CHUNK_FRAMES * options.audioChannels * options.audioBits / 8 : 0;
+
+	Bytes ftyp;
+	ftyp.insert(ftyp.end(), { 'q', 't', ' ', ' ' });
+	be32(ftyp, 0x200);
+	ftyp.insert(ftyp.end(), { 'q', 't', ' ', ' ' });
+	ftyp = atom("ftyp", ftyp);
+
+	// a moov in front has to be built twice, the offsets in it depend on its size
+	std::vector<uint64_t> videoChunks, audioChunks;
+	std::vector<Placed> placed;
+	uint64_t mdatStart = ftyp.size(), dataEnd = 0;
+	Bytes moov;
+	for (int pass = 0; pass < (options.bMoovFirst ? 2 : 1); pass++) {
+		if (options.bMoovFirst) mdatStart = ftyp.size() + moov.size();
+		videoChunks.clear();
+		audioChunks.clear();
+		placed.clear();
+		uint64_t offset = mdatStart + 16 + options.gap;
+		for (size_t c = 0, frame = 0; c < chunkSamples.size(); c++) {
+			Placed chunk;
+			chunk.offset = offset;
+			for (int k = 0; k < chunkSamples[c]; k++, frame++) {
+				chunk.data.insert(chunk.data.end(), frames[frame].begin(), frames[frame].end());
+			}
+			videoChunks.push_back(offset);
+			offset += chunk.data.size();
+			placed.push_back(chunk);
+			if (audioChunkSize) {
+				Placed audio;
+				audio.offset = offset;
+				for (long k = 0; k < audioChunkSize; k++) audio.data.push_back((unsigned char)(k * 7));
+				audioChunks.push_back(offset);
+				offset += audioChunkSize;
+				placed.push_back(audio);
+			}
+		}
+		dataEnd = offset;
+		moov = buildMoov(options, frames, chunkSamples, videoChunks, audioChunks, durations);
+	}
+
+	Placed head;
+	head.offset = 0;
+	head.data = options.bMoovFirst ? concat(ftyp, moov) : ftyp;
+	Bytes mdatHeader;
+	be32(mdatHeader, 1);
+	mdatHeader.insert(mdatHeader.end(), { 'm', 'd', 'a', 't' });
+	be64(mdatHeader, dataEnd - mdatStart);
+	head.data = concat(head.data, mdatHeader);
+	placed.insert(placed.begin(), head);
+	if (!options.bMoovFirst) {
+		Placed tail;
+		tail.offset = dataEnd;
+		tail.data = moov;
+		placed.push_back(tail);
+	}
+	if (!writeFile(path, placed)) return false;
+
+	clip.width = 1920;
+	clip.height = 1080;
+	clip.codec = HAP_CODEC_HAP5;
+	clip.frames.clear();
+	clip.audioChunks.clear();
+	int64_t time = 0;
+	for (size_t c = 0, frame = 0; c < chunkSamples.size(); c++) {
+		uint64_t offset = videoChunks[c];
+		for (int k = 0; k < chunkSamples[c]; k++, frame++) {
+			HapIndexEntry entry;
+			entry.offset = offset;
+			entry.size = (uint32_t)frames[frame].size();
+			entry.time = time * 10000000 / options.timescale;
+			clip.frames.push_back(entry);
+			offset += entry.size;
+			time += durations[frame];
+		}
+	}
+	clip.duration = time * 10000000 / options.timescale;
+	for (size_t c = 0; c < audioChunks.size(); c++) {
+		HapIndexEntry entry;
+		entry.offset = audioChunks[c];
+		entry.size = (uint32_t)audioChunkSize;
+		entry.time = 0;
+		clip.audioChunks.push_back(entry);
+	}
+	return true;
+}
+
+//////////////////////////////// AVI ////////////////////////////////
+
+#define AVI_SCALE 1001
+#define AVI_RATE 30000
+#define AVI_INDX_ENTRIES 256
+#define AVI_INDX_SIZE (24 + 16 * AVI_INDX_ENTRIES)
+#define AVI_AUDIO_BYTES_PER_FRAME 4
+
+static void le16(Bytes & out, uint32_t value) {
+	out.push_back((unsigned char)value);
+	out.push_back((unsigned char)(value >> 8));
+}
+
+static void le32(Bytes & out, uint32_t value) {
+	le16(out, value & 0xffff);
+	le16(out, value >> 16);
+}
+
+static void le64(Bytes & out, uint64_t value) {
+	le32(out, (uint32_t)value);
+	le32(out, (uint32_t)(value >> 32));
+}
+
+static void chars(Bytes & out, const char * id) {
+	out.insert(out.end(), id, id + 4);
+}
+
+static Bytes riffChunk(const char * id, const Bytes & data) {
+	Bytes out;
+	chars(out, id);
+	le32(out, (uint32_t)data.size());
+	out.insert(out.end(), data.begin(), data.end());
+	if (data.size() & 1) out.push_back(0);
+	return out;
+}
+
+static Bytes riffList(const char * type, const Bytes & data) {
+	Bytes body;
+	chars(body, type);
+	return riffChunk("LIST", concat(body, data));
+}
+
+static int64_t aviTime(int64_t slot) {
+	int64_t t = slot * AVI_SCALE;
+	return t / AVI_RATE * 10000000 + t % AVI_RATE * 10000000 / AVI_RATE;
+}
+
+static Bytes streamList(bool bVideo, bool bOpenDML) {
+	Bytes strh, strf;
+	if (bVideo) {
+		chars(strh, "vids");
+		chars(strh, "Hap1");
+		zeros(strh, 12);
+		le32(strh, AVI_SCALE);
+		le32(strh, AVI_RATE);
+		zeros(strh, 28);
+		le32(strf, 40);
+		le32(strf, 1920);
+		le32(strf, (uint32_t)-1080);
+		le16(strf, 1);
+		le16(strf, 24);
+		chars(strf, "Hap1");
+		zeros(strf, 20);
+	}
+	else {
+		chars(strh, "auds");
+		zeros(strh, 16);
+		le32(strh, AVI_AUDIO_BYTES_PER_FRAME);
+		le32(strh, 48000 * AVI_AUDIO_BYTES_PER_FRAME);
+		zeros(strh, 28);
+		le16(strf, 1);
+		le16(strf, 2);
+		le32(strf, 48000);
+		le32(strf, 48000 * AVI_AUDIO_BYTES_PER_FRAME);
+		le16(strf, AVI_AUDIO_BYTES_PER_FRAME);
+		le16(strf, 16);
+	}
+	Bytes list = concat(riffChunk("strh", strh), riffChunk("strf", strf));
+	if (bOpenDML) {
+		// filled in at the end
+		Bytes indx(AVI_INDX_SIZE, 0);
+		list = concat(list, riffChunk("indx", indx));
+	}
+	return riffList("strl", list);
+}
+
+// writes at a position of its own, leaving holes where it skips
+class AviWriter {
+
+public:
+
+	AviWriter(const std::string & path) : m_pos(0), m_bOK(true) {
+		m_file = fopen(path.c_str(), "wb");
+		if (!m_file) m_bOK = false;
+	}
+
+	bool close() {
+		if (!m_file) return false;
+		return fclose(m_file) == 0 && m_bOK;
+	}
+
+	uint64_t getPos() const { return m_pos; }
+	void skip(uint64_t size) { m_pos += size; }
+
+	void write(const Bytes & data) {
+		patch(m_pos, data);
+		m_pos += data.size();
+	}
+
+	void patch(uint64_t pos, const Bytes & data) {
+		if (!m_file || fseeko(m_file, (off_t)pos, SEEK_SET) != 0 || fwrite(data.data(), 1, data.size(), m_file) != data.size()) {
+			m_bOK = false;
+		}
+	}
+
+	void patch32(uint64_t pos, uint64_t value) {
+		Bytes data;
+		le32(data, (uint32_t)value);
+		patch(pos, data);
+	}
+
+private:
+
+	FILE * m_file;
+	uint64_t m_pos;
+	bool m_bOK;
+};
+
+struct AviStream {
+	const char * id;			// 00dc, 01wb
+	uint64_t indxPos;			// where its super index goes
+	std::vector<std::pair<uint64_t, uint32_t> > chunks;	// not in a standard index yet
+	Bytes superEntries;
+	uint32_t numSuperEntries;
+};
+
+static void flushStandardIndex(AviWriter & writer, AviStream & stream, int number) {
+	if (stream.chunks.empty()) return;
+	uint64_t base = stream.chunks[0].first;
+	Bytes index;
+	le16(index, 2);
+	index.push_back(0);
+	index.push_back(1);
+	le32(index, (uint32_t)stream.chunks.size());
+	chars(index, stream.id);
+	le64(index, base);
+	le32(index, 0);
+	for (size_t i = 0; i < stream.chunks.size(); i++) {
+		le32(index, (uint32_t)(stream.chunks[i].first - base));
+		le32(index, stream.chunks[i].second);
+	}
+	char id[5];
+	snprintf(id, sizeof(id), "ix%02d", number);
+	le64(stream.superEntries, writer.getPos());
+	le32(stream.superEntries, (uint32_t)(8 + index.size()));
+	le32(stream.superEntries, (uint32_t)stream.chunks.size());
+	stream.numSuperEntries++;
+	writer.write(riffChunk(id, index));
+	stream.chunks.clear();
+}
+
+HapTestAviOptions::HapTestAviOptions() {
+	numFrames = 100;
+	frameSize = 100000;
+	bOpenDML = false;
+	riffSize = 1ULL << 30;
+	bAudio = false;
+}
+
+bool writeTestAvi(const std::string & path, const HapTestAviOptions & options, HapTestClip & clip) {
+	AviWriter writer(path);
+	clip.width = 1920;
+	clip.height = 1080;
+	clip.codec = HAP_CODEC_HAP1;
+	clip.duration = aviTime(options.numFrames);
+	clip.frames.clear();
+	clip.audioChunks.clear();
+
+	Bytes riff;
+	chars(riff, "RIFF");
+	le32(riff, 0);
+	chars(riff, "AVI ");
+	writer.write(riff);
+
+	Bytes avih;
+	zeros(avih, 56);
+	Bytes hdrl = concat(riffChunk("avih", avih), streamList(true, options.bOpenDML));
+	if (options.bAudio) hdrl = concat(hdrl, streamList(false, options.bOpenDML));
+	uint64_t hdrlPos = writer.getPos() + 12;
+	writer.write(riffList("hdrl", hdrl));
+
+	AviStream streams[2] = { { "00dc", 0, {}, {}, 0 }, { "01wb", 0, {}, {}, 0 } };
+	for (size_t i = 0, n = 0; i + 4 <= hdrl.size() && n < 2; i++) {
+		if (memcmp(&hdrl[i], "indx", 4) == 0) streams[n++].indxPos = hdrlPos + i + 8;
+	}
+
+	uint64_t riffStart = 0;
+	uint64_t moviStart = writer.getPos() + 8;
+	Bytes movi;
+	chars(movi, "LIST");
+	le32(movi, 0);
+	chars(movi, "movi");
+	writer.write(movi);
+
+	Bytes idx1;
+	bool bFirstRiff = true;
+	for (int slot = 0; slot < options.numFrames; slot++) {
+		if (options.bOpenDML && writer.getPos() - riffStart > options.riffSize) {
+			for (int s = 0; s < 2; s++) flushStandardIndex(writer, streams[s], s);
+			writer.patch32(moviStart - 4, writer.getPos() - moviStart);
+			if (bFirstRiff) writer.write(riffChunk("idx1", idx1));
+			writer.patch32(riffStart + 4, writer.getPos() - riffStart - 8);
+			bFirstRiff = false;
+
+			riffStart = writer.getPos();
+			Bytes avix;
+			chars(avix, "RIFF");
+			le32(avix, 0);
+			chars(avix, "AVIX");
+			writer.write(avix);
+			moviStart = writer.getPos() + 8;
+			writer.write(movi);
+		}
+
+		// a chunk's data is left as a hole, only a frame's number is written
+		if (options.bAudio) {
+			uint32_t size = (1600 + slot % 3) * AVI_AUDIO_BYTES_PER_FRAME;
+			Bytes header;
+			chars(header, "01wb");
+			le32(header, size);
+			uint64_t pos = writer.getPos();
+			writer.write(header);
+			writer.skip(size);
+			if (bFirstRiff) {
+				chars(idx1, "01wb");
+				le32(idx1, 0);
+				le32(idx1, (uint32_t)(pos - moviStart));
+				le32(idx1, size);
+			}
+			streams[1].chunks.push_back(std::make_pair(pos + 8, size));
+			HapIndexEntry entry = { pos + 8, size, 0 };
+			clip.audioChunks.push_back(entry);
+		}
+
+		uint32_t size = options.frameSize + (uint32_t)slot * 131 % 9999;
+		Bytes header;
+		chars(header, "00dc");
+		le32(header, size);
+		le32(header, (uint32_t)slot);
+		uint64_t pos = writer.getPos();
+		writer.write(header);
+		writer.skip(size - 4 + (size & 1));
+		if (bFirstRiff) {
+			chars(idx1, "00dc");
+			le32(idx1, 0x10);
+			le32(idx1, (uint32_t)(pos - moviStart));
+			le32(idx1, size);
+		}
+		streams[0].chunks.push_back(std::make_pair(pos + 8, size));
+		HapIndexEntry entry = { pos + 8, size, aviTime(slot) };
+		clip.frames.push_back(entry);
+	}
+
+	if (options.bOpenDML) {
+		for (int s = 0; s < 2; s++) flushStandardIndex(writer, streams[s], s);
+	}
+	writer.patch32(moviStart - 4, writer.getPos() - moviStart);
+	if (bFirstRiff) writer.write(riffChunk("idx1", idx1));
+	writer.patch32(riffStart + 4, writer.getPos() - riffStart - 8);
+
+	for (int s = 0; s < (options.bAudio ? 2 : 1) && options.bOpenDML; s++) {
+		if (streams[s].numSuperEntries > AVI_INDX_ENTRIES) return false;
+		Bytes indx;
+		le16(indx, 4);
+		indx.push_back(0);
+		indx.push_back(0);
+		le32(indx, streams[s].numSuperEntries);
+		chars(indx, streams[s].id);
+		zeros(indx, 12);
+		writer.patch(streams[s].indxPos, concat(indx, streams[s].superEntries));
+	}
+	return writer.close();
+}
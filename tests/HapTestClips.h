@@ -0,0 +1,58 @@
+// HapTestClips - small HAP movies written for the demuxer tests, with what their index must say
+//
+// Every frame starts with its number (32 bit little endian), so a read can be checked without
+// the index. MOV frames are 16 to 4000 random bytes. AVI frames are about as large as asked for,
+// but only their number is written, the rest is a hole in a sparse file like the gaps in a MOV,
+// so even a clip of 50 GB costs little disk.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "HapFrameIndex.h"
+
+struct HapTestClip {
+	int width;
+	int height;
+	uint32_t codec;
+	int64_t duration;						// 100 ns units
+	std::vector<HapIndexEntry> frames;
+	std::vector<HapIndexEntry> audioChunks;	// offset and size only
+};
+
+struct HapTestMovOptions {
+	HapTestMovOptions();
+
+	int numFrames;
+	int timescale;
+	int frameDuration;				// in timescale units
+	bool bVaryingDuration;			// every other frame lasts twice as long
+	std::vector<int> samplesPerChunk;	// repeated over the chunks
+	bool bCo64;						// 64 bit chunk offsets
+	bool bMdhdVersion1;				// 64 bit media header
+	bool bMoovFirst;				// moov before mdat, as written for streaming
+	uint64_t gap;					// bytes of hole at the start of mdat
+
+	uint32_t audioFormat;			// 0 = no audio, else e.g. 'sowt', 'twos', 'in24', 'lpcm'
+	int audioChannels;
+	int audioBits;
+	int audioRate;
+	uint32_t audioFlags;			// lpcm format flags
+	int audioEnda;					// in24 and the like: -1 = no enda atom, else its value
+};
+
+struct HapTestAviOptions {
+	HapTestAviOptions();
+
+	int numFrames;					// 29.97 fps, Hap1
+	uint32_t frameSize;				// bytes, each frame is up to 10 KB larger
+	bool bOpenDML;					// indx super indexes and ix## chunks, RIFF AVIX lists after riffSize
+	uint64_t riffSize;
+	bool bAudio;					// 16 bit stereo PCM chunks between the frames
+};
+
+// fill clip with what the index of the file has to say
+bool writeTestMov(const std::string & path, const HapTestMovOptions & options, HapTestClip & clip);
+bool writeTestAvi(const std::string & path, const HapTestAviOptions & options, HapTestClip & clip);
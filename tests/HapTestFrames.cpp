@@ -0,0 +1,101 @@
+#include "HapTestFrames.h"
+
+#include <algorithm>
+
+#define HAP_COMPRESSOR_SNAPPY 0xB0
+#define HAP_COMPRESSOR_COMPLEX 0xC0
+#define HAP_CHUNK_SNAPPY 0x0B
+
+// how far back the compressor looks for a repeat, makeTestTextureData repeats at this distance
+#define REPEAT_DISTANCE 64
+
+static uint32_t nextRandom(uint32_t & state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+HapTestBytes makeTestTextureData(size_t size, uint32_t seed) {
+	HapTestBytes data(size);
+	uint32_t state = seed;
+	for (size_t i = 0; i < size; i++) {
+		uint32_t r = nextRandom(state);
+		data[i] = (i >= REPEAT_DISTANCE && (r & 7)) ? data[i - REPEAT_DISTANCE] : (unsigned char)(r >> 8);
+	}
+	return data;
+}
+
+static void appendLE32(HapTestBytes & out, size_t value) {
+	for (int i = 0; i < 4; i++) out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+// always the long form, a 0 size and the size in 4 bytes after the type
+static void appendSection(HapTestBytes & out, int type, const HapTestBytes & section) {
+	out.push_back(0);
+	out.push_back(0);
+	out.push_back(0);
+	out.push_back((unsigned char)type);
+	appendLE32(out, section.size());
+	out.insert(out.end(), section.begin(), section.end());
+}
+
+static void appendLiteral(HapTestBytes & out, const unsigned char * src, size_t size) {
+	for (size_t i = 0; i < size; i += 60) {
+		size_t literal = std::min<size_t>(60, size - i);
+		out.push_back((unsigned char)((literal - 1) << 2));
+		out.insert(out.end(), src + i, src + i + literal);
+	}
+}
+
+// copies of what repeats REPEAT_DISTANCE back, literals in between
+static HapTestBytes snappyCompress(const unsigned char * src, size_t size) {
+	HapTestBytes out;
+	size_t length = size;
+	while (length >= 128) {
+		out.push_back((unsigned char)(length | 0x80));
+		length >>= 7;
+	}
+	out.push_back((unsigned char)length);
+
+	size_t i = 0, literalStart = 0;
+	while (i < size) {
+		size_t copy = 0;
+		while (i >= REPEAT_DISTANCE && i + copy < size && copy < 64 && src[i + copy] == src[i + copy - REPEAT_DISTANCE]) copy++;
+		if (copy < 4) {
+			i++;
+			continue;
+		}
+		appendLiteral(out, src + literalStart, i - literalStart);
+		out.push_back((unsigned char)(2 | ((copy - 1) << 2)));
+		out.push_back(REPEAT_DISTANCE);
+		out.push_back(0);
+		i += copy;
+		literalStart = i;
+	}
+	appendLiteral(out, src + literalStart, size - literalStart);
+	return out;
+}
+
+HapTestBytes makeTestHapFrame(const HapTestBytes & data, HapTestFormat format, int numChunks) {
+	HapTestBytes frame;
+	if (numChunks <= 1) {
+		appendSection(frame, HAP_COMPRESSOR_SNAPPY | format, snappyCompress(data.data(), data.size()));
+		return frame;
+	}
+
+	HapTestBytes compressors, sizes, chunks;
+	size_t chunkSize = (data.size() + numChunks - 1) / numChunks;
+	for (size_t offset = 0; offset < data.size(); offset += chunkSize) {
+		HapTestBytes chunk = snappyCompress(data.data() + offset, std::min(chunkSize, data.size() - offset));
+		compressors.push_back(HAP_CHUNK_SNAPPY);
+		appendLE32(sizes, chunk.size());
+		chunks.insert(chunks.end(), chunk.begin(), chunk.end());
+	}
+
+	HapTestBytes instructions, container;
+	appendSection(instructions, 0x02, compressors);
+	appendSection(instructions, 0x03, sizes);
+	appendSection(container, 0x01, instructions);
+	container.insert(container.end(), chunks.begin(), chunks.end());
+	appendSection(frame, HAP_COMPRESSOR_COMPLEX | format, container);
+	return frame;
+}
@@ -0,0 +1,26 @@
+// HapTestFrames - HAP frames made up for the tests and benchmarks
+//
+// The texture data is random bytes with repeats, Snappy gets it to about the size real DXT data
+// compresses to. Frames of more than one chunk are "complex" frames like the encoders write for
+// large sizes, each chunk compressed on its own.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+typedef std::vector<unsigned char> HapTestBytes;
+
+// the low nibble of a HAP section type
+enum HapTestFormat {
+	HapTestFormat_DXT1 = 0x0B,
+	HapTestFormat_DXT5 = 0x0E,
+	HapTestFormat_YCoCg = 0x0F
+};
+
+// the same seed gives the same bytes
+HapTestBytes makeTestTextureData(size_t size, uint32_t seed);
+
+// data Snappy compressed in numChunks chunks of about equal size, 1 = a simple frame
+HapTestBytes makeTestHapFrame(const HapTestBytes & data, HapTestFormat format, int numChunks);
@@ -0,0 +1,31 @@
+// TestUtil - checks and timing shared by the tests and benchmarks
+//
+// A failed CHECK prints where and exits with 1, which is what ctest looks at. Benchmarks run a
+// short workload when started with --quick, that's how ctest runs them.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+typedef std::chrono::steady_clock TestClock;
+
+inline double elapsedMicros(TestClock::time_point start, TestClock::time_point stop = TestClock::now()) {
+	return std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+inline bool isQuick(int argc, char ** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) return true;
+	}
+	return false;
+}